@@ -322,29 +322,29 @@ MyApp::RecvOnion (Ptr<Socket> socket)
   p->CopyData (cipher, cipherLen);
 
   //decrypt onion layer
-  orLayer * onionLayer = m_onionManager.PeelOnion (cipher,cipherLen,m_onionManager.GetEncryptionKey (),m_onionManager.GetEncryptionKey ());
+  orLayer onionLayer = m_onionManager.PeelOnionInPlace (cipher,cipherLen,m_onionManager.GetEncryptionKey (),m_onionManager.GetEncryptionKey ());
 
 
-  if (ConstructIpv4 (onionLayer->nextHopIP).Get () == 0) //execute if onion mode -- -- was selected
+  if (ConstructIpv4 (onionLayer.nextHopIP).Get () == 0) //execute if onion mode -- -- was selected
     {//Onion totally decrypted
-      NS_LOG_INFO ("Onion reveal--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, containing the end content:" << UcharToString (onionLayer->innerLayer,onionLayer->innerLayerLen));
+      NS_LOG_INFO ("Onion reveal--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, containing the end content:" << UcharToString (onionLayer.innerLayer,onionLayer.innerLayerLen));
     }
   else
     {//Onion routing step
       if (m_onionMode == ONION_LAYERCONTENT || m_onionMode == ONION_LAYERCONTENT_ENDCONTENT) //execute if onion mode -- ONION_LAYERCONTENT,ONION_LAYERCONTENT_ENDCONTENT -- was selected
         {
-          uint8_t const * buff = &onionLayer->innerLayer[m_layerContentLen];
-          Ptr<Packet> np = Create<Packet> (buff,onionLayer->innerLayerLen - m_layerContentLen);
-          m_socket->SendTo (np, 0, InetSocketAddress (ConstructIpv4 (onionLayer->nextHopIP),m_port));
-          NS_LOG_INFO ("Onion routing--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, containing the layer content: " << UcharToString (onionLayer->innerLayer,m_layerContentLen) << ", sent to: " << ConstructIpv4 (onionLayer->nextHopIP));
+          uint8_t const * buff = &onionLayer.innerLayer[m_layerContentLen];
+          Ptr<Packet> np = Create<Packet> (buff,onionLayer.innerLayerLen - m_layerContentLen);
+          m_socket->SendTo (np, 0, InetSocketAddress (ConstructIpv4 (onionLayer.nextHopIP),m_port));
+          NS_LOG_INFO ("Onion routing--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, containing the layer content: " << UcharToString (onionLayer.innerLayer,m_layerContentLen) << ", sent to: " << ConstructIpv4 (onionLayer.nextHopIP));
 
         }
       else //execute if onion mode -- ONION_NO_CONTENT, ONION_ENDCONTENT, -- was selected
         {
-          uint8_t const * buff = onionLayer->innerLayer;
-          Ptr<Packet> np = Create<Packet> (buff,onionLayer->innerLayerLen);
-          m_socket->SendTo (np, 0, InetSocketAddress (ConstructIpv4 (onionLayer->nextHopIP),m_port));
-          NS_LOG_INFO ("Onion routing--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, sent to: " << ConstructIpv4 (onionLayer->nextHopIP));
+          uint8_t const * buff = onionLayer.innerLayer;
+          Ptr<Packet> np = Create<Packet> (buff,onionLayer.innerLayerLen);
+          m_socket->SendTo (np, 0, InetSocketAddress (ConstructIpv4 (onionLayer.nextHopIP),m_port));
+          NS_LOG_INFO ("Onion routing--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, sent to: " << ConstructIpv4 (onionLayer.nextHopIP));
         }
     }
 
@@ -155,9 +155,9 @@ public:
   uint8_t * GetSecretKey ();
 
   //implement encryption
-  virtual void EncryptLayer (uint8_t * ciphertext, uint8_t* message, int len, uint8_t * key) const;
+  virtual bool EncryptLayer (uint8_t * ciphertext, uint8_t* message, int len, uint8_t * key) const;
   //implement decryption
-  virtual void DecryptLayer (uint8_t * innerLayer, uint8_t* onion, uint16_t onionLen, uint8_t * pk, uint8_t * sk) const;
+  virtual bool DecryptLayer (uint8_t * innerLayer, uint8_t* onion, uint16_t onionLen, uint8_t * pk, uint8_t * sk) const;
 
   //the publickey
   uint8_t m_publickey[crypto_box_PUBLICKEYBYTES];
@@ -181,7 +181,12 @@ OnionManager::GetTypeId (void)
 
 OnionManager::OnionManager ()
   : OnionRouting (crypto_box_SEALBYTES,Ipv4L3Protocol::PROT_NUMBER)
-{}
+{
+  if (sodium_init () < 0)
+    {
+      NS_FATAL_ERROR ("Unable to initialize libsodium");
+    }
+}
 
 
 
@@ -205,24 +210,26 @@ uint8_t * OnionManager::GetSecretKey ()
 }
 
 
-void OnionManager::EncryptLayer (uint8_t * ciphertext, uint8_t* message, int len, uint8_t * key) const
+bool OnionManager::EncryptLayer (uint8_t * ciphertext, uint8_t* message, int len, uint8_t * key) const
 {
   if (crypto_box_seal (ciphertext, message, len, key) != 0)
     {
       NS_LOG_WARN ("Error during encryption");
-      m_errno = ERROR_ENCRYPTION;
+      return false;
     }
+  return true;
 }
 
 
 
-void OnionManager::DecryptLayer (uint8_t * innerLayer, uint8_t* onion, uint16_t onionLen, uint8_t * pk, uint8_t * sk) const
+bool OnionManager::DecryptLayer (uint8_t * innerLayer, uint8_t* onion, uint16_t onionLen, uint8_t * pk, uint8_t * sk) const
 {
   if (crypto_box_seal_open (innerLayer, onion, onionLen, pk, sk) != 0)
     {
       NS_LOG_WARN ("Messge corrupted or not for this node");
-      m_errno = ERROR_DECRYPTION;
+      return false;
     }
+  return true;
 }
 
 
@@ -419,29 +426,29 @@ MyApp::RecvOnion (Ptr<Socket> socket)
   p->CopyData (cipher, cipherLen);
 
   //decrypt onion layer
-  orLayer * onionLayer = m_onionManager.PeelOnion (cipher,cipherLen,m_onionManager.GetPublicKey (),m_onionManager.GetSecretKey ());
+  orLayer onionLayer = m_onionManager.PeelOnionInPlace (cipher,cipherLen,m_onionManager.GetPublicKey (),m_onionManager.GetSecretKey ());
 
 
-  if (ConstructIpv4 (onionLayer->nextHopIP).Get () == 0) //execute if onion mode -- -- was selected
+  if (ConstructIpv4 (onionLayer.nextHopIP).Get () == 0) //execute if onion mode -- -- was selected
     {//Onion totally decrypted
-      NS_LOG_INFO ("Onion reveal--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, containing the end content:" << UcharToString (onionLayer->innerLayer,onionLayer->innerLayerLen));
+      NS_LOG_INFO ("Onion reveal--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, containing the end content:" << UcharToString (onionLayer.innerLayer,onionLayer.innerLayerLen));
     }
   else
     {//Onion routing step
       if (m_onionMode == ONION_LAYERCONTENT || m_onionMode == ONION_LAYERCONTENT_ENDCONTENT) //execute if onion mode -- ONION_LAYERCONTENT,ONION_LAYERCONTENT_ENDCONTENT -- was selected
         {
-          uint8_t const * buff = &onionLayer->innerLayer[m_layerContentLen];
-          Ptr<Packet> np = Create<Packet> (buff,onionLayer->innerLayerLen - m_layerContentLen);
-          m_socket->SendTo (np, 0, InetSocketAddress (ConstructIpv4 (onionLayer->nextHopIP),m_port));
-          NS_LOG_INFO ("Onion routing--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, containing the layer content: " << UcharToString (onionLayer->innerLayer,m_layerContentLen) << ", sent to: " << ConstructIpv4 (onionLayer->nextHopIP));
+          uint8_t const * buff = &onionLayer.innerLayer[m_layerContentLen];
+          Ptr<Packet> np = Create<Packet> (buff,onionLayer.innerLayerLen - m_layerContentLen);
+          m_socket->SendTo (np, 0, InetSocketAddress (ConstructIpv4 (onionLayer.nextHopIP),m_port));
+          NS_LOG_INFO ("Onion routing--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, containing the layer content: " << UcharToString (onionLayer.innerLayer,m_layerContentLen) << ", sent to: " << ConstructIpv4 (onionLayer.nextHopIP));
  
         }
       else //execute if onion mode -- ONION_NO_CONTENT, ONION_ENDCONTENT, -- was selected
         {
-          uint8_t const * buff = onionLayer->innerLayer;
-          Ptr<Packet> np = Create<Packet> (buff,onionLayer->innerLayerLen);
-          m_socket->SendTo (np, 0, InetSocketAddress (ConstructIpv4 (onionLayer->nextHopIP),m_port));
-          NS_LOG_INFO ("Onion routing--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, sent to: " << ConstructIpv4 (onionLayer->nextHopIP));
+          uint8_t const * buff = onionLayer.innerLayer;
+          Ptr<Packet> np = Create<Packet> (buff,onionLayer.innerLayerLen);
+          m_socket->SendTo (np, 0, InetSocketAddress (ConstructIpv4 (onionLayer.nextHopIP),m_port));
+          NS_LOG_INFO ("Onion routing--Onion sent from: " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " received at: " << m_address <<  " of size: " << p->GetSize () << " bytes, sent to: " << ConstructIpv4 (onionLayer.nextHopIP));
         }
     }
 
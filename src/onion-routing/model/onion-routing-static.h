@@ -0,0 +1,503 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+#ifndef ONION_ROUTING_STATIC_H
+#define ONION_ROUTING_STATIC_H
+
+#include "ns3/onion-routing.h"
+
+#include <string.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup onion-routing
+ * \class OnionLayout
+ * \brief Compile-time layer-size math of onion messages of a given address family and seal padding
+ *
+ * Same layout as ns3::OnionRouting, the layer i of the onion message is stored at offset i * Stride ().
+ */
+
+template <OnionAddressFamily Family, uint16_t SealPadding>
+class OnionLayout
+{
+public:
+  static constexpr uint16_t ADDRESS_SIZE = Family; //!< size in bytes of the serialized address
+  static constexpr uint16_t SEAL_PADDING = SealPadding; //!< size increase of the ciphertext in bytes
+
+  /**
+  * \brief Distance in bytes between two consecutive layers of the onion message
+  * \param [in] layerContentLen length in bytes of the data stored in each layer
+  * \return the stride in bytes
+  */
+  static constexpr uint16_t
+  Stride (uint16_t layerContentLen)
+  {
+    return SealPadding + Family + layerContentLen;
+  }
+
+  /**
+  * \brief Number of encryption layers of the onion message
+  * \param [in] routeLen the length of the route that the onion message will travel
+  * \param [in] layerContentLen length in bytes of the data stored in each layer
+  * \param [in] endContentLen length in bytes of the data delivered to the last hop
+  * \return the number of layers
+  */
+  static constexpr uint16_t
+  Layers (uint16_t routeLen, uint16_t layerContentLen, uint16_t endContentLen)
+  {
+    return (layerContentLen == 0 && endContentLen == 0) ? routeLen - 1 : routeLen;
+  }
+
+  /**
+  * \brief Length in bytes of the onion message, equal to ns3::OnionRouting::OnionLength()
+  * \param [in] routeLen the length of the route that the onion message will travel
+  * \param [in] layerContentLen length in bytes of the data stored in each layer
+  * \param [in] endContentLen length in bytes of the data delivered to the last hop
+  * \return the length in bytes of the onion message
+  */
+  static constexpr uint16_t
+  OnionLength (uint16_t routeLen, uint16_t layerContentLen, uint16_t endContentLen)
+  {
+    return (layerContentLen == 0 && endContentLen == 0)
+               ? (routeLen - 1) * Stride (0)
+               : (routeLen - 1) * Stride (layerContentLen) + SealPadding + Family +
+                     (endContentLen != 0 ? endContentLen : layerContentLen);
+  }
+
+  /**
+  * \brief Length in bytes of the plaintext encrypted in layer \p layer
+  * \param [in] onionLen the length in bytes of the onion message
+  * \param [in] layer index of the layer, 0 is the outer layer
+  * \param [in] layerContentLen length in bytes of the data stored in each layer
+  * \return the plaintext length in bytes
+  */
+  static constexpr uint16_t
+  PlainLength (uint16_t onionLen, uint16_t layer, uint16_t layerContentLen)
+  {
+    return onionLen - layer * Stride (layerContentLen) - SealPadding;
+  }
+};
+
+/**
+ * \ingroup onion-routing
+ * \class OnionRoutingStatic
+ * \brief OnionRouting specialized at compile time on the address family, the seal padding and the cipher
+ *
+ * Offsets and layer lengths are computed by ns3::OnionLayout, so the construction loop is compiled
+ * against constant strides and encryption is called directly on the \p Cipher policy, without the virtual dispatch.
+ * Onion messages are byte-identical to the ones built by ns3::OnionRouting with the same parameters.
+ *
+ * The \p Cipher policy provides the static methods<br>
+ *   bool Encrypt (uint8_t *ciphertext, uint8_t *plaintext, int len, uint8_t *key)<br>
+ *   bool Decrypt (uint8_t *plaintext, uint8_t *ciphertext, uint16_t len, uint8_t *publicKey, uint8_t *secretKey)<br>
+ * returning false on failure. EncryptLayer & DecryptLayer are implemented as thin adapters to the policy,
+ * so the object can still be used through the ns3::OnionRouting interface.
+ *
+ * The route descriptor, the suffix cache and the reentrant request overloads of BuildOnion() are
+ * specialized too, ns3::OnionRouting::BuildOnions() dispatches to the reentrant overload.
+ * The overloads of BuildOnion() hide the ones of ns3::OnionRouting. Through an ns3::OnionRouting
+ * reference the suffix cache and the reentrant request overloads are dispatched virtually, the other
+ * overloads check the route, LOG and capture the trace in the base class and encrypt through the
+ * overridden CreateOnion(). Called on the specialization, every overload rejects routes shorter
+ * than 4 hops, but does not LOG and does not capture the construction trace.
+ */
+
+template <OnionAddressFamily Family, uint16_t SealPadding, class Cipher>
+class OnionRoutingStatic : public OnionRouting
+{
+public:
+  typedef OnionLayout<Family, SealPadding> Layout; //!< layer-size math of the onion message
+
+  /**
+  * \brief Constructor -- Setup parameters for the creation of onions from the template arguments
+  */
+  OnionRoutingStatic ()
+    : OnionRouting (SealPadding, Family)
+  {
+    NS_ASSERT_MSG (m_addressSize == Layout::ADDRESS_SIZE, "The base layout differs from the template");
+  }
+
+  using OnionRouting::BuildOnion;
+  using OnionRouting::PeelOnion;
+
+  /**
+  * \brief Construction of the onion ONION_NO_CONTENT, see ns3::OnionRouting::BuildOnion()
+  */
+  void
+  BuildOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys, uint16_t routeLen)
+  {
+    if (CheckRoute (routeLen))
+      {
+        OnionRoutingStatic::CreateOnion (cipher, route, keys, routeLen, nullptr, 0, nullptr, 0);
+      }
+  }
+
+  /**
+  * \brief Construction of the onion ONION_ENDCONTENT, see ns3::OnionRouting::BuildOnion()
+  */
+  void
+  BuildOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys, uint16_t routeLen,
+              uint8_t *endContent, uint16_t endContentLen)
+  {
+    if (CheckRoute (routeLen))
+      {
+        OnionRoutingStatic::CreateOnion (cipher, route, keys, routeLen, nullptr, 0, endContent,
+                                         endContentLen);
+      }
+  }
+
+  /**
+  * \brief Construction of the onion ONION_LAYERCONTENT, see ns3::OnionRouting::BuildOnion()
+  */
+  void
+  BuildOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys, uint8_t **layerContent,
+              uint16_t layerContentLen, uint16_t routeLen)
+  {
+    if (CheckRoute (routeLen))
+      {
+        OnionRoutingStatic::CreateOnion (cipher, route, keys, routeLen, layerContent,
+                                         layerContentLen, nullptr, 0);
+      }
+  }
+
+  /**
+  * \brief Construction of the onion ONION_LAYERCONTENT_ENDCONTENT, see ns3::OnionRouting::BuildOnion()
+  */
+  void
+  BuildOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys, uint8_t **layerContent,
+              uint16_t layerContentLen, uint16_t routeLen, uint8_t *endContent,
+              uint16_t endContentLen)
+  {
+    if (CheckRoute (routeLen))
+      {
+        OnionRoutingStatic::CreateOnion (cipher, route, keys, routeLen, layerContent,
+                                         layerContentLen, endContent, endContentLen);
+      }
+  }
+
+  /**
+  * \brief Construction of the onion ONION_NO_CONTENT from a route descriptor, see ns3::OnionRouting::BuildOnion()
+  */
+  void
+  BuildOnion (uint8_t *cipher, OnionRouteDescriptor &route)
+  {
+    OnionRoutingStatic::BuildOnion (cipher, route.GetRoute (), route.GetKeys (),
+                                    route.GetRouteLen ());
+  }
+
+  /**
+  * \brief Construction of the onion ONION_NO_CONTENT reusing the inner layers of \p cache, see ns3::OnionRouting::BuildOnion()
+  */
+  virtual void
+  BuildOnion (uint8_t *cipher, OnionRouteDescriptor &route, OnionSuffixCache &cache)
+  {
+    uint16_t routeLen = route.GetRouteLen ();
+    if (!CheckRoute (routeLen))
+      {
+        return;
+      }
+
+    const uint16_t stride = Layout::Stride (0);
+    const uint16_t layers = routeLen - 1;
+    const uint16_t onionLen = Layout::OnionLength (routeLen, 0, 0);
+
+    //layer i is addressed to the hops i to routeLen - 1, whose address slots are contiguous
+    uint16_t encrypted = layers;
+    for (uint16_t i = 0; i < layers; ++i)
+      {
+        const std::string *suffix = cache.Find (route.GetAddress (i), (routeLen - i) * Family);
+        if (suffix != nullptr)
+          {
+            memcpy (&cipher[i * stride], suffix->data (), suffix->size ());
+            encrypted = i;
+            break;
+          }
+      }
+
+    for (int i = encrypted - 1; i >= 0; --i)
+      {
+        uint8_t *layer = &cipher[i * stride];
+        memcpy (&layer[SealPadding], route.GetAddress (i + 1), Family);
+        if (!EncryptStatic (layer, Layout::PlainLength (onionLen, i, 0), route.GetKey (i)))
+          {
+            m_errno = ERROR_ENCRYPTION;
+            return;
+          }
+        cache.Insert (route.GetAddress (i), (routeLen - i) * Family, layer, onionLen - i * stride);
+      }
+    cache.Record (layers - encrypted, encrypted);
+  }
+
+  /**
+  * \brief Reentrant construction of the onion message described by \p request, see ns3::OnionRouting::BuildOnion()
+  */
+  virtual enum OnionErrno
+  BuildOnion (const orOnionRequest &request) const
+  {
+    if (request.routeLen < 4)
+      {
+        return ERROR_ROUTE_TO_SHORT;
+      }
+    return EncryptOnion (request.cipher, request.route, request.keys, request.routeLen,
+                         request.layerContent, request.layerContentLen, request.endContent,
+                         request.endContentLen);
+  }
+
+  /**
+  * \brief Construction of the onion ONION_NO_CONTENT over a route of length known at compile time
+  *
+  * The route length is a template argument, the construction loop has a constant trip count and constant offsets.
+  *
+  *   \param [in,out] cipher memory of Layout::OnionLength (RouteLen, 0, 0) bytes on which the onion message will be stored
+  *   \param [in] route array of RouteLen ip addresses in the serialized form
+  *   \param [in] keys array of encryption keys, keys are stored in the serialized form
+  */
+  template <uint16_t RouteLen>
+  void
+  BuildOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys)
+  {
+    static_assert (RouteLen >= 4, "Route is too short, need at least 3 intermediate hops.");
+    m_errno = ERROR_NOTERROR;
+
+    constexpr uint16_t stride = Layout::Stride (0);
+    constexpr uint16_t onionLen = Layout::OnionLength (RouteLen, 0, 0);
+
+    for (int i = RouteLen - 2; i >= 0; --i)
+      {
+        uint8_t *layer = &cipher[i * stride];
+        memcpy (&layer[SealPadding], route[i + 1], Family);
+        if (!Cipher::Encrypt (layer, &layer[SealPadding], Layout::PlainLength (onionLen, i, 0),
+                              keys[i]))
+          {
+            m_errno = ERROR_ENCRYPTION;
+          }
+      }
+  }
+
+  /**
+  * \brief Constructs the onion message, see ns3::OnionRouting::CreateOnion()
+  *
+  * Offsets are derived from Layout, no layer table is computed.
+  */
+  void
+  CreateOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys, uint16_t routeLen,
+               uint8_t **layerContent, uint16_t layerContentLen, uint8_t *endContent,
+               uint16_t endContentLen)
+  {
+    enum OnionErrno status = EncryptOnion (cipher, route, keys, routeLen, layerContent,
+                                           layerContentLen, endContent, endContentLen);
+    if (status != ERROR_NOTERROR)
+      {
+        m_errno = status;
+      }
+  }
+
+  /**
+  * \brief Decipher the outer layer of the onion into \p buffer, see ns3::OnionRouting::PeelOnion()
+  */
+  orLayer
+  PeelOnion (uint8_t *onion, uint16_t onionLen, uint8_t *publicKey, uint8_t *secretKey,
+             uint8_t *buffer)
+  {
+    orLayer layer;
+    layer.nextHopIP = buffer;
+    layer.innerLayer = &buffer[Family];
+    layer.innerLayerLen = 0;
+
+    m_errno = ERROR_NOTERROR;
+    if (onionLen < SealPadding + Family ||
+        !Cipher::Decrypt (buffer, onion, onionLen, publicKey, secretKey))
+      {
+        m_errno = ERROR_DECRYPTION;
+        return layer;
+      }
+
+    layer.innerLayerLen = onionLen - SealPadding - Family;
+    return layer;
+  }
+
+  /**
+  * \brief Decipher the outer layer of the onion in place, see ns3::OnionRouting::PeelOnionInPlace()
+  */
+  orLayer
+  PeelOnionInPlace (uint8_t *onion, uint16_t onionLen, uint8_t *publicKey, uint8_t *secretKey)
+  {
+    return OnionRoutingStatic::PeelOnion (onion, onionLen, publicKey, secretKey,
+                                          &onion[SealPadding]);
+  }
+
+  /**
+  * \brief Length in bytes of the onion message, see ns3::OnionLayout::OnionLength()
+  */
+  uint16_t
+  OnionLength (uint16_t routeLen, uint16_t layerContentLen, uint16_t endContentLen)
+  {
+    return Layout::OnionLength (routeLen, layerContentLen, endContentLen);
+  }
+
+  /**
+  * \brief Adapter of the virtual encryption to \p Cipher
+  */
+  virtual bool
+  EncryptLayer (uint8_t *ciphertext, uint8_t *plaintext, int len, uint8_t *key) const
+  {
+    return Cipher::Encrypt (ciphertext, plaintext, len, key);
+  }
+
+  /**
+  * \brief Adapter of the virtual decryption to \p Cipher
+  */
+  virtual bool
+  DecryptLayer (uint8_t *plaintext, uint8_t *ciphertext, uint16_t len, uint8_t *publicKey,
+                uint8_t *secretKey) const
+  {
+    return Cipher::Decrypt (plaintext, ciphertext, len, publicKey, secretKey);
+  }
+
+private:
+  /**
+  * \brief Reset the error status and check the length of the route
+  * \param [in] routeLen the length of the route
+  * \return true if the onion can be built
+  */
+  bool
+  CheckRoute (uint16_t routeLen)
+  {
+    m_errno = ERROR_NOTERROR;
+    if (routeLen < 4)
+      {
+        m_errno = ERROR_ROUTE_TO_SHORT;
+        return false;
+      }
+    return true;
+  }
+
+  /**
+  * \brief Encrypt in place the layer at \p layer, the plaintext is stored at \p layer + SealPadding
+  * \param [in,out] layer memory of the layer
+  * \param [in] plainLen length in bytes of the plaintext
+  * \param [in] key encryption key
+  * \return true on success
+  */
+  static bool
+  EncryptStatic (uint8_t *layer, uint16_t plainLen, uint8_t *key)
+  {
+    return Cipher::Encrypt (layer, &layer[SealPadding], plainLen, key);
+  }
+
+  /**
+  * \brief Encrypt the layers of the onion message, offsets are derived from Layout
+  *
+  * Does not touch the object state, shared by CreateOnion() and the reentrant BuildOnion().
+  *
+  * \return ERROR_NOTERROR on success, ERROR_ENCRYPTION if a layer failed to encrypt
+  */
+  static enum OnionErrno
+  EncryptOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys, uint16_t routeLen,
+                uint8_t **layerContent, uint16_t layerContentLen, uint8_t *endContent,
+                uint16_t endContentLen)
+  {
+    const uint16_t stride = Layout::Stride (layerContentLen);
+    const uint16_t layers = Layout::Layers (routeLen, layerContentLen, endContentLen);
+    const uint16_t onionLen = Layout::OnionLength (routeLen, layerContentLen, endContentLen);
+    int i = layers - 1;
+
+    //inner layer -- zero address followed by the end content or by the layer content
+    if (layers == routeLen)
+      {
+        uint8_t *layer = &cipher[i * stride];
+        memset (&layer[SealPadding], 0, Family);
+        if (endContentLen != 0)
+          {
+            memcpy (&layer[SealPadding + Family], endContent, endContentLen);
+          }
+        else
+          {
+            memcpy (&layer[SealPadding + Family], layerContent[i], layerContentLen);
+          }
+        if (!EncryptStatic (layer, Layout::PlainLength (onionLen, i, layerContentLen), keys[i]))
+          {
+            return ERROR_ENCRYPTION;
+          }
+        --i;
+      }
+
+    for (; i >= 0; --i)
+      {
+        uint8_t *layer = &cipher[i * stride];
+        memcpy (&layer[SealPadding], route[i + 1], Family);
+        if (layerContentLen != 0)
+          {
+            memcpy (&layer[SealPadding + Family], layerContent[i], layerContentLen);
+          }
+        if (!EncryptStatic (layer, Layout::PlainLength (onionLen, i, layerContentLen), keys[i]))
+          {
+            return ERROR_ENCRYPTION;
+          }
+      }
+    return ERROR_NOTERROR;
+  }
+};
+
+/**
+ * \ingroup onion-routing
+ * \class OnionDummyCipher
+ * \brief Cipher policy of ns3::OnionRoutingStatic with the dummy encryption of ns3::OnionRoutingDummyEncryption
+ */
+
+template <uint16_t SealPadding>
+class OnionDummyCipher
+{
+public:
+  static_assert (SealPadding >= 4, "Seal padding must be at least 4-Bytes");
+
+  /**
+  * \brief Include the 4-Bytes dummy key in front of the plaintext
+  */
+  static bool
+  Encrypt (uint8_t *ciphertext, uint8_t *plaintext, int len, uint8_t *key)
+  {
+    memmove (&ciphertext[SealPadding], plaintext, len);
+    memset (ciphertext, 0, SealPadding);
+    memcpy (ciphertext, key, 4);
+    return true;
+  }
+
+  /**
+  * \brief Compare the 4-Bytes dummy key with the \p publicKey and strip the seal padding
+  */
+  static bool
+  Decrypt (uint8_t *plaintext, uint8_t *ciphertext, uint16_t len, uint8_t *publicKey,
+           uint8_t *secretKey)
+  {
+    if (memcmp (ciphertext, publicKey, 4) != 0)
+      {
+        return false;
+      }
+    memmove (plaintext, &ciphertext[SealPadding], len - SealPadding);
+    return true;
+  }
+};
+
+} // namespace ns3
+
+#endif /* ONION_ROUTING_STATIC_H */
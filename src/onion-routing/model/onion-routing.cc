@@ -51,6 +51,9 @@ OnionRouting::GetTypeId (void)
 OnionRouting::OnionRouting (uint16_t sealPadding, const uint16_t protocolNumber)
 { 
   m_errno = ERROR_NOTERROR;
+  m_traceEnabled = false;
+  m_traceLen = 0;
+  m_traceRouteLen = 0;
   //set seal bytes
   m_sealPadding = sealPadding;
   //set address bytes of the used IP protocol
@@ -71,6 +74,34 @@ OnionRouting::OnionRouting (uint16_t sealPadding, const uint16_t protocolNumber)
 
 
 
+OnionRouting::OnionRouting (uint16_t sealPadding, enum OnionAddressFamily family)
+{
+  m_errno = ERROR_NOTERROR;
+  m_traceEnabled = false;
+  m_traceLen = 0;
+  m_traceRouteLen = 0;
+  m_sealPadding = sealPadding;
+  m_addressSize = family;
+}
+
+
+
+void
+OnionRouting::SetAddressFamily (enum OnionAddressFamily family)
+{
+  m_addressSize = family;
+}
+
+
+
+uint16_t
+OnionRouting::GetAddressSize (void) const
+{
+  return m_addressSize;
+}
+
+
+
 
 
 void
@@ -89,13 +120,13 @@ OnionRouting::BuildOnion (uint8_t * cipher, uint8_t ** route, uint8_t ** keys,ui
     {
       NS_LOG_INFO ("Start creation of the onion");
 
-      m_onionStream.str ("");
+      CreateOnion (cipher,route,keys, routeLen, nullptr, 0, nullptr, 0);
 
-      CreateOnion (cipher,route,keys, routeLen, routeLen, nullptr, 0, nullptr, 0);
-
-      AddressToStream (route[0]);
-
-      NS_LOG_INFO (m_onionStream.str () << "\nOnion ready");
+#if ONION_ROUTING_TRACE
+      NS_LOG_INFO (TraceToString () << "\nOnion ready");
+#else
+      NS_LOG_INFO ("Onion ready");
+#endif
     }
 }
 
@@ -117,13 +148,13 @@ OnionRouting::BuildOnion (uint8_t * cipher, uint8_t ** route, uint8_t ** keys, u
     {
       NS_LOG_INFO ("Start creation of the onion");
 
-      m_onionStream.str ("");
-
-      CreateOnion (cipher,route,keys, routeLen, routeLen, nullptr, 0, endContent, endContentLen);
+      CreateOnion (cipher,route,keys, routeLen, nullptr, 0, endContent, endContentLen);
 
-      AddressToStream (route[0]);
-
-      NS_LOG_INFO (m_onionStream.str () << "\nOnion ready");
+#if ONION_ROUTING_TRACE
+      NS_LOG_INFO (TraceToString () << "\nOnion ready");
+#else
+      NS_LOG_INFO ("Onion ready");
+#endif
     }
 }
 
@@ -145,13 +176,13 @@ OnionRouting::BuildOnion (uint8_t * cipher, uint8_t ** route, uint8_t ** keys, u
     {
       NS_LOG_INFO ("Start creation of the onion");
 
-      m_onionStream.str ("");
-
-      CreateOnion (cipher,route,keys, routeLen, routeLen, layerContent, layerContentLen, nullptr, 0);
+      CreateOnion (cipher,route,keys, routeLen, layerContent, layerContentLen, nullptr, 0);
 
-      AddressToStream (route[0]);
-
-      NS_LOG_INFO (m_onionStream.str () << "\nOnion ready");
+#if ONION_ROUTING_TRACE
+      NS_LOG_INFO (TraceToString () << "\nOnion ready");
+#else
+      NS_LOG_INFO ("Onion ready");
+#endif
     }
 }
 
@@ -171,70 +202,247 @@ OnionRouting::BuildOnion (uint8_t * cipher, uint8_t ** route, uint8_t ** keys, u
     {
       NS_LOG_INFO ("Start creation of the onion");
 
-      m_onionStream.str ("");
+      CreateOnion (cipher,route,keys, routeLen, layerContent, layerContentLen, endContent, endContentLen);
 
-      CreateOnion (cipher,route,keys, routeLen, routeLen, layerContent, layerContentLen, endContent, endContentLen);
+#if ONION_ROUTING_TRACE
+      NS_LOG_INFO (TraceToString () << "\nOnion ready");
+#else
+      NS_LOG_INFO ("Onion ready");
+#endif
+    }
+}
 
-      AddressToStream (route[0]);
+void
+OnionRouting::LayerTable (std::vector<orLayerOffset> & table, uint8_t ** route, uint8_t ** keys, uint16_t routeLen, uint8_t ** layerContent, uint16_t layerContentLen, uint8_t * endContent, uint16_t endContentLen) const
+{
+  //an additional inner layer holding the zero address is encrypted if content is set
+  bool innerLayer = (endContentLen != 0 || layerContentLen != 0);
+  uint16_t layers = innerLayer ? routeLen : routeLen - 1;
+  uint16_t stride = m_sealPadding + m_addressSize + layerContentLen;
+
+  table.resize (layers);
+
+  //layers wrapping the next hop address and the layer content
+  for (uint16_t i = 0; i < routeLen - 1; ++i)
+    {
+      table[i].offset = i * stride;
+      table[i].nextHopIP = route[i + 1];
+      table[i].content = (layerContentLen != 0) ? layerContent[i] : nullptr;
+      table[i].contentLen = layerContentLen;
+      table[i].key = keys[i];
+    }
+
+  //inner layer -- zero address followed by the end content or by the layer content
+  if (innerLayer)
+    {
+      table[layers - 1].offset = (layers - 1) * stride;
+      table[layers - 1].nextHopIP = nullptr;
+      table[layers - 1].content = (endContentLen != 0) ? endContent : layerContent[routeLen - 1];
+      table[layers - 1].contentLen = (endContentLen != 0) ? endContentLen : layerContentLen;
+      table[layers - 1].key = keys[routeLen - 1];
+    }
 
-      NS_LOG_INFO (m_onionStream.str () << "\nOnion ready");
+  //plaintext of a layer is the address, the content and the ciphertext of the following layer
+  uint16_t innerCipherLen = 0;
+  for (int i = layers - 1; i >= 0; --i)
+    {
+      table[i].plainLen = m_addressSize + table[i].contentLen + innerCipherLen;
+      innerCipherLen = table[i].plainLen + m_sealPadding;
     }
 }
 
 void
-OnionRouting::CreateOnion (uint8_t * cipher, uint8_t ** route, uint8_t ** keys, uint16_t index, uint16_t routeLen, uint8_t ** layerContent, uint16_t layerContentLen, uint8_t * endContent, uint16_t endContentLen)
+OnionRouting::CreateOnion (uint8_t * cipher, uint8_t ** route, uint8_t ** keys, uint16_t routeLen, uint8_t ** layerContent, uint16_t layerContentLen, uint8_t * endContent, uint16_t endContentLen)
 {
-  //number of bytes to be encrypted in this layer
-  int plainLayerLen = m_addressSize + layerContentLen + OnionLength (index - 1,layerContentLen,endContentLen);
-
-  m_onionStream << "(";       //fancy output
- 
-  if (index <= 2 && (endContentLen != 0 || layerContentLen != 0))       //stop recursion
+  std::vector<orLayerOffset> table;
+  LayerTable (table, route, keys, routeLen, layerContent, layerContentLen, endContent, endContentLen);
 
+#if ONION_ROUTING_TRACE
+  if (IsTraceEnabled ())
     {
-      for (int i = 0; i < m_addressSize; ++i) //Insert the zero address -- 0.0.0.0 (ipv4)
+      //record hops of the route, routes longer than the trace are marked as truncated
+      m_traceRouteLen = routeLen;
+      m_traceLen = std::min<uint16_t> (routeLen, ONION_TRACE_SIZE);
+      for (uint16_t i = 0; i < m_traceLen; ++i)
         {
-          cipher[m_addressSize + layerContentLen + m_sealPadding + m_sealPadding + i] = 0;
+          m_trace[i].hop = i;
+          memcpy (m_trace[i].address, route[i], m_addressSize);
+          m_trace[i].layerLen = (i < table.size ()) ? table[i].plainLen + m_sealPadding : 0;
         }
+    }
+  else
+    {
+      //do not report the trace of a previous onion
+      m_traceRouteLen = 0;
+      m_traceLen = 0;
+    }
+#endif
+
+  enum OnionErrno status = EncryptLayers (cipher, table);
+  if (status != ERROR_NOTERROR)
+    {
+      NS_LOG_LOGIC ("Encryption of a layer failed.");
+      m_errno = status;
+    }
+} //create the onion
+
+
+
+
 
-      if (endContentLen != 0)
+enum OnionRouting::OnionErrno
+OnionRouting::EncryptLayers (uint8_t * cipher, const std::vector<orLayerOffset> & table) const
+{
+  enum OnionErrno status = ERROR_NOTERROR;
+
+  //encrypt from the inner layer outward, each layer wraps the ciphertext of the following one
+  for (int i = table.size () - 1; i >= 0; --i)
+    {
+      if (!EncryptTableLayer (cipher, table[i]))
         {
-          //If end content is set include it & encrypt
-          memcpy (&cipher[m_addressSize + layerContentLen + m_sealPadding + m_sealPadding + m_addressSize], endContent, endContentLen);
-          EncryptLayer (&cipher[m_addressSize + layerContentLen + m_sealPadding],&cipher[m_addressSize + layerContentLen + m_sealPadding + m_sealPadding],m_addressSize + endContentLen,keys[routeLen - index + 1]);
+          status = ERROR_ENCRYPTION;
         }
-      else
+    }
+
+  return status;
+}
+
+
+
+bool
+OnionRouting::EncryptTableLayer (uint8_t * cipher, const orLayerOffset & layer) const
+{
+  uint8_t * plaintext = &cipher[layer.offset + m_sealPadding];
+
+  if (layer.nextHopIP != nullptr)
+    {
+      //Insert next hop address
+      memcpy (plaintext, layer.nextHopIP, m_addressSize);
+    }
+  else
+    {
+      //Insert the zero address -- 0.0.0.0 (ipv4)
+      memset (plaintext, 0, m_addressSize);
+    }
+
+  if (layer.contentLen != 0)
+    {
+      //Include the content in the current encryption layer
+      memcpy (&plaintext[m_addressSize], layer.content, layer.contentLen);
+    }
+
+  return EncryptLayer (&cipher[layer.offset], plaintext, layer.plainLen, layer.key);       //encrypt
+}
+
+
+
+enum OnionRouting::OnionErrno
+OnionRouting::BuildOnion (const orOnionRequest & request) const
+{
+  if (request.routeLen < 4)
+    {
+      return ERROR_ROUTE_TO_SHORT;
+    }
+
+  std::vector<orLayerOffset> table;
+  LayerTable (table, request.route, request.keys, request.routeLen, request.layerContent, request.layerContentLen, request.endContent, request.endContentLen);
+
+  return EncryptLayers (request.cipher, table);
+}
+
+
+
+void
+OnionRouting::BuildOnions (const orOnionRequest * requests, enum OnionErrno * status, uint32_t count, uint16_t threads) const
+{
+  NS_LOG_FUNCTION (this << count << threads);
+
+  if (threads == 0)
+    {
+      threads = std::max (1u, std::thread::hardware_concurrency ());
+    }
+  threads = std::min<uint32_t> (threads, count);
+
+  //workers take the next request from the shared counter
+  std::atomic<uint32_t> next (0);
+  auto worker = [this, requests, status, count, &next] ()
+    {
+      for (uint32_t i = next++; i < count; i = next++)
         {
-          //Include layer content & encrypt
-          memcpy (&cipher[m_addressSize + layerContentLen + m_sealPadding + m_sealPadding + m_addressSize], layerContent[routeLen - index + 1], layerContentLen);
-          EncryptLayer (&cipher[m_addressSize + layerContentLen + m_sealPadding],&cipher[m_addressSize + layerContentLen + m_sealPadding + m_sealPadding],m_addressSize + layerContentLen,keys[routeLen - index + 1]);
+          status[i] = BuildOnion (requests[i]);
         }
+    };
 
+  std::vector<std::thread> pool;
+  for (uint16_t t = 1; t < threads; ++t)
+    {
+      pool.emplace_back (worker);
     }
-  else if (index > 2)        //recursion
 
+  worker ();       //the calling thread is a worker too
+
+  for (std::thread & t : pool)
     {
-      CreateOnion (&cipher[ m_sealPadding + m_addressSize + layerContentLen],route, keys, index - 1,routeLen,layerContent, layerContentLen, endContent,endContentLen);
+      t.join ();
     }
+}
 
 
-  //Insert next hop address
-  memcpy (&cipher[m_sealPadding], route[routeLen - index + 1], m_addressSize);
-  AddressToStream (route[routeLen - index + 1]);      //fancy output
 
-  if (layerContentLen != 0)
+void
+OnionRouting::BuildOnion (uint8_t * cipher, OnionRouteDescriptor & route)
+{
+  BuildOnion (cipher, route.GetRoute (), route.GetKeys (), route.GetRouteLen ());
+}
+
+
+
+void
+OnionRouting::BuildOnion (uint8_t * cipher, OnionRouteDescriptor & route, OnionSuffixCache & cache)
+{
+  m_errno = ERROR_NOTERROR;
+  uint16_t routeLen = route.GetRouteLen ();
+
+  if (routeLen < 4)
     {
-      //Include layer content in the current encryption layer
-      memcpy (&cipher[m_sealPadding + m_addressSize], layerContent[routeLen - index], layerContentLen);
+      NS_LOG_LOGIC ("Route is too short, need at least 3 intermediate hops.");
+      m_errno = ERROR_ROUTE_TO_SHORT;
+      return;
     }
 
-  EncryptLayer (cipher,&cipher[m_sealPadding],plainLayerLen,keys[routeLen - index]);       //encrypt
-
-  m_onionStream << ") ";       //fancy output
+  std::vector<orLayerOffset> table;
+  LayerTable (table, route.GetRoute (), route.GetKeys (), routeLen, nullptr, 0, nullptr, 0);
+  uint16_t layers = table.size ();
+  uint16_t onionLen = table[0].plainLen + m_sealPadding;
 
-} //create the onion
+  //layer i is addressed to the hops i to routeLen - 1, whose address slots are contiguous
+  uint16_t encrypted = layers;
+  for (uint16_t i = 0; i < layers; ++i)
+    {
+      const std::string * suffix = cache.Find (route.GetAddress (i), (routeLen - i) * m_addressSize);
+      if (suffix != nullptr)
+        {
+          memcpy (&cipher[table[i].offset], suffix->data (), suffix->size ());
+          encrypted = i;
+          break;
+        }
+    }
 
+  //the encryption of a layer overwrites the following one, cache each layer once encrypted
+  for (int i = encrypted - 1; i >= 0; --i)
+    {
+      if (!EncryptTableLayer (cipher, table[i]))
+        {
+          NS_LOG_LOGIC ("Encryption of a layer failed.");
+          m_errno = ERROR_ENCRYPTION;
+          return;
+        }
+      cache.Insert (route.GetAddress (i), (routeLen - i) * m_addressSize, &cipher[table[i].offset], onionLen - table[i].offset);
+    }
+  cache.Record (layers - encrypted, encrypted);
 
+  NS_LOG_INFO ("Onion ready, " << layers - encrypted << " of " << layers << " layers from the cache");
+}
 
 
 
@@ -242,18 +450,45 @@ orLayer * OnionRouting::PeelOnion (uint8_t * onion, uint16_t onionLen, uint8_t *
 {
   uint8_t * innerLayer = new uint8_t[onionLen - (m_sealPadding)];
 
-  DecryptLayer (innerLayer,onion,onionLen,publicKey,secretKey);
-
   orLayer * layer = new orLayer;
-  layer->nextHopIP = innerLayer;
-  layer->innerLayer = &innerLayer[m_addressSize];
-  layer->innerLayerLen = onionLen - m_sealPadding - m_addressSize;
+  *layer = PeelOnion (onion,onionLen,publicKey,secretKey,innerLayer);
+
+  return layer;
+}
+
+
+
+orLayer OnionRouting::PeelOnion (uint8_t * onion, uint16_t onionLen, uint8_t * publicKey, uint8_t * secretKey, uint8_t * buffer)
+{
+  orLayer layer;
+  layer.nextHopIP = buffer;
+  layer.innerLayer = &buffer[m_addressSize];
+  layer.innerLayerLen = 0;
+
+  //a truncated onion is rejected before the decryption
+  m_errno = ERROR_NOTERROR;
+  if (onionLen < m_sealPadding + m_addressSize
+      || !DecryptLayer (buffer,onion,onionLen,publicKey,secretKey))
+    {
+      NS_LOG_LOGIC ("Messge corrupted or not for this node");
+      m_errno = ERROR_DECRYPTION;
+      return layer;
+    }
+
+  layer.innerLayerLen = onionLen - m_sealPadding - m_addressSize;
 
   return layer;
 }
 
 
 
+orLayer OnionRouting::PeelOnionInPlace (uint8_t * onion, uint16_t onionLen, uint8_t * publicKey, uint8_t * secretKey)
+{
+  return PeelOnion (onion,onionLen,publicKey,secretKey,&onion[m_sealPadding]);
+}
+
+
+
 
 
 uint16_t OnionRouting::OnionLength (uint16_t routeLen,uint16_t layerContentLen,uint16_t endContentLen)
@@ -276,17 +511,96 @@ uint16_t OnionRouting::OnionLength (uint16_t routeLen,uint16_t layerContentLen,u
 
 
 
-void OnionRouting::AddressToStream (uint8_t* ip)
+void OnionRouting::AddressToStream (std::ostream & os, const uint8_t* ip) const
 {
-  m_onionStream << (int) ip[0];
+  if (m_addressSize < ONION_IPV4)
+    {
+      //compact node id, big-endian
+      uint32_t id = 0;
+      for (int i = 0; i < m_addressSize; ++i)
+        {
+          id = (id << 8) | ip[i];
+        }
+      os << "#" << id;
+      return;
+    }
+
+  os << (int) ip[0];
   for (int i = 1; i < m_addressSize; ++i)
     {
-      m_onionStream << "."  << (int) ip[i];
+      os << "."  << (int) ip[i];
     }
 }
 
 
 
+void OnionRouting::EnableTrace (bool enable)
+{
+  m_traceEnabled = enable;
+}
+
+
+
+bool OnionRouting::IsTraceEnabled (void) const
+{
+  return m_traceEnabled || g_log.IsEnabled (LOG_INFO);
+}
+
+
+
+const orTraceEntry * OnionRouting::GetTrace (void) const
+{
+  return m_trace;
+}
+
+
+
+uint16_t OnionRouting::GetTraceLength (void) const
+{
+  return m_traceLen;
+}
+
+
+
+bool OnionRouting::IsTraceTruncated (void) const
+{
+  return m_traceRouteLen > m_traceLen;
+}
+
+
+
+std::string OnionRouting::TraceToString (void) const
+{
+  std::stringstream os;
+
+  if (m_traceLen == 0)
+    {
+      return os.str ();
+    }
+
+  for (uint16_t i = 1; i < m_traceLen; ++i)
+    {
+      os << "(";       //fancy output
+    }
+
+  if (IsTraceTruncated ())
+    {
+      os << "(... " << m_traceRouteLen - m_traceLen << " hops) ";
+    }
+
+  for (uint16_t i = m_traceLen - 1; i > 0; --i)
+    {
+      AddressToStream (os, m_trace[i].address);
+      os << ") ";
+    }
+
+  AddressToStream (os, m_trace[0].address);
+
+  return os.str ();
+}
+
+
+
 
 enum OnionRouting::OnionErrno
 OnionRouting::GetErrno (void)
@@ -335,36 +649,220 @@ uint8_t * OnionRoutingDummyEncryption::GetEncryptionKey (void)
 
 
 
-void OnionRoutingDummyEncryption::EncryptLayer (uint8_t * ciphertext, uint8_t* message, int len, uint8_t * key) const
+bool OnionRoutingDummyEncryption::EncryptLayer (uint8_t * ciphertext, uint8_t* message, int len, uint8_t * key) const
 {
   memcpy (ciphertext, &key[0], 4); //include the key
   for (int i = 0; i < m_sealPadding - 4; ++i) //insert seal padding, all zeros
     {
       ciphertext[4 + i] = 0;
     }
+  return true;
 }
 
 
 
-void OnionRoutingDummyEncryption::DecryptLayer (uint8_t * innerLayer, uint8_t* onion, uint16_t onionLen, uint8_t * pk, uint8_t * sk) const
+bool OnionRoutingDummyEncryption::DecryptLayer (uint8_t * innerLayer, uint8_t* onion, uint16_t onionLen, uint8_t * pk, uint8_t * sk) const
 {
   for (int i = 0; i < 4; ++i)
     {
       if (onion[i] != pk[i])
         {
           NS_LOG_INFO ("Messge corrupted or not for this node");
-          m_errno = ERROR_DECRYPTION;
-          return;
+          return false;
         }
     }
-  memcpy (innerLayer,&onion[m_sealPadding],onionLen - m_sealPadding);
+  memmove (innerLayer,&onion[m_sealPadding],onionLen - m_sealPadding);
+  return true;
+}
+
+
+
+
+
+
+
+OnionRouteDescriptor::OnionRouteDescriptor (uint16_t addressSize, uint16_t keySize)
+{
+  m_addressSize = addressSize;
+  m_keySize = keySize;
+  m_routeLen = 0;
+}
+
+void
+OnionRouteDescriptor::Clear (void)
+{
+  m_routeLen = 0;
+}
+
+void
+OnionRouteDescriptor::AddHop (const uint8_t * address, const uint8_t * key)
+{
+  //grow the slots only for a route longer than any before
+  if (m_routeLen == m_routeView.size ())
+    {
+      m_addresses.resize ((m_routeLen + 1) * m_addressSize);
+      m_keys.resize ((m_routeLen + 1) * m_keySize);
+      m_routeView.resize (m_routeLen + 1);
+      m_keyView.resize (m_routeLen + 1);
+    }
+
+  memcpy (&m_addresses[m_routeLen * m_addressSize], address, m_addressSize);
+  memcpy (&m_keys[m_routeLen * m_keySize], key, m_keySize);
+  m_routeLen++;
+}
+
+uint16_t
+OnionRouteDescriptor::GetRouteLen (void) const
+{
+  return m_routeLen;
+}
+
+uint8_t *
+OnionRouteDescriptor::GetAddress (uint16_t hop)
+{
+  return &m_addresses[hop * m_addressSize];
+}
+
+uint8_t *
+OnionRouteDescriptor::GetKey (uint16_t hop)
+{
+  return &m_keys[hop * m_keySize];
+}
+
+uint8_t **
+OnionRouteDescriptor::GetRoute (void)
+{
+  //the slots may have moved since the last call
+  for (uint16_t i = 0; i < m_routeLen; ++i)
+    {
+      m_routeView[i] = GetAddress (i);
+    }
+  return m_routeView.data ();
 }
 
+uint8_t **
+OnionRouteDescriptor::GetKeys (void)
+{
+  for (uint16_t i = 0; i < m_routeLen; ++i)
+    {
+      m_keyView[i] = GetKey (i);
+    }
+  return m_keyView.data ();
+}
 
 
 
+OnionSuffixCache::OnionSuffixCache (uint32_t capacity)
+{
+  m_capacity = capacity;
+  m_size = 0;
+  m_hits = 0;
+  m_misses = 0;
+  m_reusedLayers = 0;
+  m_encryptedLayers = 0;
+}
 
+void
+OnionSuffixCache::SetCapacity (uint32_t capacity)
+{
+  m_capacity = capacity;
+  Evict ();
+}
 
+const std::string *
+OnionSuffixCache::Find (const uint8_t * hops, uint16_t hopsLen)
+{
+  std::unordered_map<std::string, EntryList::iterator>::iterator it = m_index.find (std::string ((const char *) hops, hopsLen));
+  if (it == m_index.end ())
+    {
+      return nullptr;
+    }
 
+  //move the entry to the front, the iterators stay valid
+  m_entries.splice (m_entries.begin (), m_entries, it->second);
+  return &it->second->second;
 }
 
+void
+OnionSuffixCache::Insert (const uint8_t * hops, uint16_t hopsLen, const uint8_t * cipher, uint16_t cipherLen)
+{
+  std::string key ((const char *) hops, hopsLen);
+  if (cipherLen > m_capacity || m_index.count (key) != 0)
+    {
+      return;
+    }
+
+  m_entries.emplace_front (key, std::string ((const char *) cipher, cipherLen));
+  m_index[key] = m_entries.begin ();
+  m_size += cipherLen;
+  Evict ();
+}
+
+void
+OnionSuffixCache::Record (uint16_t reused, uint16_t encrypted)
+{
+  if (reused > 0)
+    {
+      m_hits++;
+    }
+  else
+    {
+      m_misses++;
+    }
+  m_reusedLayers += reused;
+  m_encryptedLayers += encrypted;
+}
+
+void
+OnionSuffixCache::Clear (void)
+{
+  m_entries.clear ();
+  m_index.clear ();
+  m_size = 0;
+}
+
+uint64_t
+OnionSuffixCache::GetHits (void) const
+{
+  return m_hits;
+}
+
+uint64_t
+OnionSuffixCache::GetMisses (void) const
+{
+  return m_misses;
+}
+
+double
+OnionSuffixCache::GetLayerHitRate (void) const
+{
+  uint64_t layers = m_reusedLayers + m_encryptedLayers;
+  return (layers == 0) ? 0 : (double) m_reusedLayers / layers;
+}
+
+uint64_t
+OnionSuffixCache::GetEncryptedLayers (void) const
+{
+  return m_encryptedLayers;
+}
+
+uint32_t
+OnionSuffixCache::GetSize (void) const
+{
+  return m_size;
+}
+
+void
+OnionSuffixCache::Evict (void)
+{
+  while (m_size > m_capacity)
+    {
+      m_size -= m_entries.back ().second.size ();
+      m_index.erase (m_entries.back ().first);
+      m_entries.pop_back ();
+    }
+}
+
+
+
+}
@@ -26,6 +26,26 @@
 #include "ns3/ipv4-l3-protocol.h"
 #include "ns3/ipv6-l3-protocol.h"
 
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Compile-time switch of the onion construction trace. The trace is compiled only in builds
+ * with logging enabled, define ONION_ROUTING_TRACE as 0 or 1 to override the default.
+ */
+#ifndef ONION_ROUTING_TRACE
+#ifdef NS3_LOG_ENABLE
+#define ONION_ROUTING_TRACE 1
+#else
+#define ONION_ROUTING_TRACE 0
+#endif
+#endif
+
 namespace ns3 {
 
 /**
@@ -38,6 +58,21 @@ namespace ns3 {
  *  Be sure to read the manual BEFORE going down to the API.
  */
 
+/**
+ * \ingroup onion-routing
+ * \enum OnionAddressFamily
+ * \brief Encoding of next hop addresses in onion layers, the value is the size in bytes of the encoded address
+ *
+ * Compact node ids are resolved to addresses by the user of the module, the id 0 is reserved for the zero address.
+ */
+
+enum OnionAddressFamily {
+  ONION_NODEID8 = 1,
+  ONION_NODEID16 = 2,
+  ONION_IPV4 = 4,
+  ONION_IPV6 = 16
+};
+
 /**
  * \ingroup onion-routing
  * \struct orLayer
@@ -53,6 +88,295 @@ struct orLayer
   uint16_t innerLayerLen; //!< length of the inner content of the onion message
 };
 
+/**
+ * \ingroup onion-routing
+ * \struct orLayerOffset
+ * \brief entry of the layer table, describing where and how a single layer of the onion message is encrypted
+ *
+ * The table is computed once before the construction of the onion message, entry 0 describes the outer layer.
+ */
+
+struct orLayerOffset
+{
+  uint16_t offset; //!< position of the layer ciphertext in the onion message
+  uint16_t plainLen; //!< length in bytes of the plaintext encrypted in the layer
+  uint8_t *nextHopIP; //!< next hop ip address in the serialized form, nullptr for the zero address
+  uint8_t *content; //!< content stored in the layer after the next hop address
+  uint16_t contentLen; //!< length in bytes of \p content
+  uint8_t *key; //!< encryption key of the layer
+};
+
+/**
+ * \ingroup onion-routing
+ * \struct orOnionRequest
+ * \brief parameters of an onion message to build with the reentrant ns3::OnionRouting::BuildOnion() or with ns3::OnionRouting::BuildOnions()
+ *
+ * Set \p layerContentLen and \p endContentLen to 0 to build onions without content.
+ */
+
+struct orOnionRequest
+{
+  uint8_t *cipher; //!< memory on which the onion message will be stored, at least OnionLength() bytes
+  uint8_t **route; //!< array of ip addresses defining the route of the onion message, in the serialized form
+  uint8_t **keys; //!< array of encryption keys, in the serialized form
+  uint16_t routeLen; //!< the length of the route that the onion message will travel
+  uint8_t **layerContent; //!< array of pointers to the data stored in each layer, nullptr if \p layerContentLen is 0
+  uint16_t layerContentLen; //!< length in bytes of the data stored in each layer
+  uint8_t *endContent; //!< content to forward to the last node in the onion message path, nullptr if \p endContentLen is 0
+  uint16_t endContentLen; //!< length in bytes of \p endContent
+};
+
+/**
+ * \ingroup onion-routing
+ * \struct orTraceEntry
+ * \brief structure holding details of a hop captured while tracing the construction of an onion message
+ *
+ */
+
+struct orTraceEntry
+{
+  uint16_t hop; //!< index of the hop in the route of the onion message
+  uint8_t address[16]; //!< ip address of the hop given in the serialized form
+  uint16_t layerLen; //!< length in bytes of the layer the hop deciphers, 0 if the hop receives no layer
+};
+
+/**
+ * \ingroup onion-routing
+ * \class OnionRouteDescriptor
+ * \brief route of an onion message and the keys of its hops, in contiguous storage
+ *
+ * Structure of arrays with fixed-width slots: the addresses of the hops are stored in one array
+ * of addressSize-byte slots and the keys in one array of keySize-byte slots. The storage is kept
+ * across Clear(), so a descriptor reused for each onion does not allocate memory once it holds
+ * the longest route.
+ */
+
+class OnionRouteDescriptor
+{
+public:
+  /**
+  *
+  * \brief Constructor
+  *
+  *   \param [in] addressSize size in bytes of an address slot, 4-Ipv4, 16-Ipv6
+  *   \param [in] keySize size in bytes of a key slot
+  *
+  */
+  OnionRouteDescriptor (uint16_t addressSize, uint16_t keySize);
+
+  /**
+  *
+  * \brief Remove all hops, the storage is kept
+  *
+  */
+  void Clear (void);
+
+  /**
+  *
+  * \brief Append a hop to the route, copy its address and key into the next slots
+  *
+  *   \param [in] address serialized address of addressSize bytes
+  *   \param [in] key key of keySize bytes
+  *
+  */
+  void AddHop (const uint8_t *address, const uint8_t *key);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the number of hops in the route
+  *
+  */
+  uint16_t GetRouteLen (void) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the address slot of hop \p hop
+  *
+  */
+  uint8_t *GetAddress (uint16_t hop);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the key slot of hop \p hop
+  *
+  */
+  uint8_t *GetKey (uint16_t hop);
+
+  /**
+  *
+  * \brief Pointers to the address slots, the route argument of ns3::OnionRouting::BuildOnion()
+  *
+  * \return array of GetRouteLen() pointers, valid until the next AddHop()
+  *
+  */
+  uint8_t **GetRoute (void);
+
+  /**
+  *
+  * \brief Pointers to the key slots, the keys argument of ns3::OnionRouting::BuildOnion()
+  *
+  * \return array of GetRouteLen() pointers, valid until the next AddHop()
+  *
+  */
+  uint8_t **GetKeys (void);
+
+private:
+  uint16_t m_addressSize; //!< size in bytes of an address slot
+  uint16_t m_keySize; //!< size in bytes of a key slot
+  uint16_t m_routeLen; //!< number of hops in the route
+  std::vector<uint8_t> m_addresses; //!< address slots
+  std::vector<uint8_t> m_keys; //!< key slots
+  std::vector<uint8_t *> m_routeView; //!< pointers to the address slots
+  std::vector<uint8_t *> m_keyView; //!< pointers to the key slots
+};
+
+/**
+ * \ingroup onion-routing
+ * \class OnionSuffixCache
+ * \brief cache of the encrypted inner layers of onion messages, keyed by the hops they are addressed to
+ *
+ * In the ONION_NO_CONTENT layout the layer i of an onion message is a self-contained ciphertext
+ * determined by the hops i to routeLen - 1 of the route, so onion messages whose routes share a tail
+ * can reuse it, see ns3::OnionRouting::BuildOnion (cipher, route, cache). Onion messages sharing a
+ * cached suffix carry identical inner layers, so they are linkable by the hops of the shared tail.
+ *
+ * Entries are evicted in least recently used order to keep the cached ciphertext under the capacity.
+ * The cache does not know the keys, clear it when the key of a hop changes.
+ */
+
+class OnionSuffixCache
+{
+public:
+  /**
+  *
+  * \brief Constructor
+  *
+  *   \param [in] capacity maximum number of bytes of cached ciphertext, 0 disables the cache
+  *
+  */
+  OnionSuffixCache (uint32_t capacity);
+
+  /**
+  *
+  * \brief Set the maximum number of bytes of cached ciphertext, evict entries above it
+  *
+  *   \param [in] capacity the capacity in bytes
+  *
+  */
+  void SetCapacity (uint32_t capacity);
+
+  /**
+  *
+  * \brief Find the ciphertext of the layers addressed to the sequence of hops \p hops
+  *
+  *   \param [in] hops the serialized addresses of the hops, concatenated
+  *   \param [in] hopsLen length in bytes of \p hops
+  *  <br>
+  *   \return the ciphertext, nullptr if it is not cached
+  *
+  */
+  const std::string *Find (const uint8_t *hops, uint16_t hopsLen);
+
+  /**
+  *
+  * \brief Cache the ciphertext of the layers addressed to the sequence of hops \p hops
+  *
+  *   \param [in] hops the serialized addresses of the hops, concatenated
+  *   \param [in] hopsLen length in bytes of \p hops
+  *   \param [in] cipher the ciphertext of the layers
+  *   \param [in] cipherLen length in bytes of \p cipher
+  *
+  */
+  void Insert (const uint8_t *hops, uint16_t hopsLen, const uint8_t *cipher, uint16_t cipherLen);
+
+  /**
+  *
+  * \brief Record the layers of an onion message taken from the cache and the encrypted ones
+  *
+  *   \param [in] reused number of layers taken from the cache
+  *   \param [in] encrypted number of encrypted layers
+  *
+  */
+  void Record (uint16_t reused, uint16_t encrypted);
+
+  /**
+  *
+  * \brief Remove all entries, the statistics are kept
+  *
+  */
+  void Clear (void);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the number of onion messages that reused at least one cached layer
+  *
+  */
+  uint64_t GetHits (void) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the number of onion messages built without cached layers
+  *
+  */
+  uint64_t GetMisses (void) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the fraction of layers taken from the cache, over all the layers of onion messages
+  *
+  */
+  double GetLayerHitRate (void) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the number of layers encrypted, over all the onion messages recorded
+  *
+  */
+  uint64_t GetEncryptedLayers (void) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the number of bytes of cached ciphertext
+  *
+  */
+  uint32_t GetSize (void) const;
+
+private:
+  typedef std::list<std::pair<std::string, std::string>> EntryList; //!< pairs <hops,ciphertext>, most recently used first
+
+  /**
+  *
+  * \brief Evict the least recently used entries until the size is within the capacity
+  *
+  */
+  void Evict (void);
+
+  uint32_t m_capacity; //!< maximum number of bytes of cached ciphertext
+  uint32_t m_size; //!< number of bytes of cached ciphertext
+  EntryList m_entries; //!< entries in the order of use
+  std::unordered_map<std::string, EntryList::iterator> m_index; //!< entries by the sequence of hops
+  uint64_t m_hits; //!< onion messages that reused cached layers
+  uint64_t m_misses; //!< onion messages built without cached layers
+  uint64_t m_reusedLayers; //!< layers taken from the cache
+  uint64_t m_encryptedLayers; //!< layers encrypted
+};
+
 /**
  * \ingroup onion-routing
  * \class OnionRouting
@@ -106,7 +430,8 @@ public:
     ERROR_PROT_NUMBER,
     ERROR_ROUTE_TO_SHORT,
     ERROR_ENCRYPTION,
-    ERROR_DECRYPTION
+    ERROR_DECRYPTION,
+    ERROR_NOT_SUPPORTED
   };
 
   /**
@@ -122,6 +447,37 @@ public:
 
   /**
 *
+* \brief Constructor -- Setup parameters for the creation of onions with next hops encoded as \p family
+* 
+*   \param [in] sealPadding size increase of the ciphertext in bytes, intorduced by the encryption method 
+*   \param [in] family encoding of next hop addresses in onion layers
+*
+*/
+
+  OnionRouting (uint16_t sealPadding, enum OnionAddressFamily family);
+
+  /**
+*
+* \brief Set the encoding of next hop addresses, followed by the construction, the peeling and the length of onions
+* 
+*   \param [in] family encoding of next hop addresses in onion layers
+*
+*/
+
+  void SetAddressFamily (enum OnionAddressFamily family);
+
+  /**
+*
+* \brief accessor
+* 
+* \return size in bytes of a next hop address in onion layers
+*
+*/
+
+  uint16_t GetAddressSize (void) const;
+
+  /**
+*
 * \brief Manage construction of the onion ONION_NO_CONTENT
 * 
 * The resulting onion message include only routing information and the last hop in the onion path will not recieve content
@@ -215,23 +571,139 @@ public:
 
   /**
 *
-* \brief Constructs the onion message * 
+* \brief Reentrant construction of the onion message described by \p request
 * 
-*   \param [in,out] cipher memory on which the onion message will be stored
+* The method does not modify the object, so it can be called concurrently from multiple threads
+* as long as EncryptLayer is thread-safe. The errno of the object is not set, the construction trace is not captured
+* and there is no LOG output. Virtual so that ns3::OnionRoutingStatic builds the onions of ns3::OnionRouting::BuildOnions().
+* 
+*   \param [in] request parameters of the onion message
+*  <br>
+*   \return ERROR_NOTERROR on success, otherwise the error of the construction
+*
+*/
+
+  virtual enum OnionErrno BuildOnion (const orOnionRequest &request) const;
+
+  /**
+*
+* \brief Manage construction of the onion ONION_NO_CONTENT from a route descriptor
+* 
+* Same as BuildOnion (cipher, route, keys, routeLen), with the addresses and keys of the hops
+* taken from the slots of \p route.
+* 
+*   \param [in,out] cipher memory locations on which the onion message will be stored
+*   \param [in] route the route of the onion message and the keys of its hops
+*
+*/
+
+  void BuildOnion (uint8_t *cipher, OnionRouteDescriptor &route);
+
+  /**
+*
+* \brief Manage construction of the onion ONION_NO_CONTENT reusing inner layers from \p cache
+* 
+* The longest tail of the route with its layers in the cache is copied, only the outer layers
+* are encrypted, then the encrypted layers are added to the cache.
+* The construction follows the layout of ns3::OnionRouting::CreateOnion(), subclasses overriding it
+* with a different onion format must override this overload too.
+* 
+*   \param [in,out] cipher memory locations on which the onion message will be stored
+*   \param [in] route the route of the onion message and the keys of its hops
+*   \param [in,out] cache the cache of inner layers
+*
+*/
+
+  virtual void BuildOnion (uint8_t *cipher, OnionRouteDescriptor &route, OnionSuffixCache &cache);
+
+  /**
+*
+* \brief Build a batch of onion messages over a pool of worker threads
+* 
+* Each onion is built by the reentrant ns3::OnionRouting::BuildOnion(), the workers take requests 
+* from a shared counter until the batch is done. The call returns when all onions are built.
+* The errno of the object is not set, the result of each onion is reported in \p status.
+* 
+*   \param [in] requests array of \p count onion messages to build, cipher buffers must not overlap
+*   \param [out] status array of \p count status codes, status[i] is the result of requests[i]
+*   \param [in] count number of onion messages to build
+*   \param [in] threads number of worker threads, 0 to use all hardware threads, 1 to build on the calling thread
+*
+*/
+
+  void BuildOnions (const orOnionRequest *requests, enum OnionErrno *status, uint32_t count,
+                    uint16_t threads = 0) const;
+
+  /**
+*
+* \brief Compute the layer table of the onion message at given parameters
+*
+* The offset and plaintext length of each layer are computed once,
+* entry 0 of the table describes the outer layer and the last entry the inner layer.
+* 
+*   \param [in,out] table the layer table, resized to the number of encryption layers
 *   \param [in] route array of ip addresses defining the route of the onion message, ip addresses are stored in the serialized form
 *   \param [in] keys array of encryption keys, keys are stored in the serialized form 
+*   \param [in] routeLen the length of the route that the onion message will travel (equal to the number of ip addresses stored in the \p route)
 *   \param [in] layerContent array of of pointers, pointing to data to be stored in a layer of the onion message the data is of fixed length in bytes
 *   \param [in] layerContentLen length in bytes of the data to be stored in each layer of the onion message 
-*   \param [in] index additional parameter used for the construction of the onion message
+*   \param [in] endContent location of the content to forward to the last node in the onion message path
+*   \param [in] endContentLen length in bytes of the data stored at \p endContent
+*
+*/
+
+  void LayerTable (std::vector<orLayerOffset> &table, uint8_t **route, uint8_t **keys,
+                   uint16_t routeLen, uint8_t **layerContent, uint16_t layerContentLen,
+                   uint8_t *endContent, uint16_t endContentLen) const;
+
+  /**
+*
+* \brief Encrypt the layers described by \p table, from the inner layer outward on the \p cipher buffer
+* 
+*   \param [in,out] cipher memory on which the onion message will be stored
+*   \param [in] table the layer table computed by ns3::OnionRouting::LayerTable()
+*  <br>
+*   \return ERROR_NOTERROR on success, ERROR_ENCRYPTION if the encryption of a layer failed
+*
+*/
+
+  enum OnionErrno EncryptLayers (uint8_t *cipher, const std::vector<orLayerOffset> &table) const;
+
+  /**
+*
+* \brief Encrypt one layer of the table in place, the following layer must be already encrypted
+*
+*   \param [in,out] cipher memory locations of the onion message
+*   \param [in] layer the entry of the layer table
+*  <br>
+*   \return true on success, false if the encryption failed
+*
+*/
+
+  bool EncryptTableLayer (uint8_t *cipher, const orLayerOffset &layer) const;
+
+  /**
+*
+* \brief Constructs the onion message
+* 
+* The layer table is computed by ns3::OnionRouting::LayerTable(), then layers are encrypted
+* in a single pass from the inner layer outward on the \p cipher buffer.
+* Subclasses with a different onion format override CreateOnion, PeelOnion, PeelOnionInPlace and OnionLength.
+* 
+*   \param [in,out] cipher memory on which the onion message will be stored
+*   \param [in] route array of ip addresses defining the route of the onion message, ip addresses are stored in the serialized form
+*   \param [in] keys array of encryption keys, keys are stored in the serialized form 
 *   \param [in] routeLen the length of the route that the onion message will travel (equal to the number of ip addresses stored in the \p route)
+*   \param [in] layerContent array of of pointers, pointing to data to be stored in a layer of the onion message the data is of fixed length in bytes
+*   \param [in] layerContentLen length in bytes of the data to be stored in each layer of the onion message 
 *   \param [in] endContent location of the content to forward to the last node in the onion message path
 *   \param [in] endContentLen length in bytes of the data stored at \p endContent
 *
 */
 
-  void CreateOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys, uint16_t index,
-                    uint16_t routeLen, uint8_t **layerContent, uint16_t layerContentLen,
-                    uint8_t *endContent, uint16_t endContentLen); //create the onion
+  virtual void CreateOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys, uint16_t routeLen,
+                            uint8_t **layerContent, uint16_t layerContentLen, uint8_t *endContent,
+                            uint16_t endContentLen); //create the onion
 
   /**
 *
@@ -242,7 +714,7 @@ public:
 *   \param [in] publicKey encryption key 
 *   \param [in] secretKey encryption key 
 *  <br>
-*   \return orLayer * struct holding onion layer details
+*   \return orLayer * struct holding onion layer details, valid only if GetErrno() returns ERROR_NOTERROR
 *
 */
 
@@ -251,31 +723,72 @@ public:
 
   /**
 *
+* \brief Decipher the outer layer of the onion into \p buffer, without allocating memory
+* 
+* The returned orLayer does not own memory, its pointers refer to locations in \p buffer.
+* 
+*   \param [in] onion the onion message
+*   \param [in] onionLen the length in bytes of the onion message
+*   \param [in] publicKey encryption key 
+*   \param [in] secretKey encryption key 
+*   \param [in,out] buffer memory of at least \p onionLen - \p m_sealPadding bytes on which the deciphered layer is stored
+*  <br>
+*   \return orLayer struct holding onion layer details, valid only if GetErrno() returns ERROR_NOTERROR,
+*           ERROR_DECRYPTION if the layer is corrupted or not addressed to the node
+*
+*/
+
+  virtual orLayer PeelOnion (uint8_t *onion, uint16_t onionLen, uint8_t *publicKey,
+                             uint8_t *secretKey, uint8_t *buffer);
+
+  /**
+*
+* \brief Decipher the outer layer of the onion in place, the deciphered layer overwrites the onion after the first \p m_sealPadding bytes
+* 
+* The returned orLayer does not own memory, its pointers refer to locations in \p onion.
+* 
+*   \param [in,out] onion the onion message
+*   \param [in] onionLen the length in bytes of the onion message
+*   \param [in] publicKey encryption key 
+*   \param [in] secretKey encryption key 
+*  <br>
+*   \return orLayer struct holding onion layer details, valid only if GetErrno() returns ERROR_NOTERROR,
+*           ERROR_DECRYPTION if the layer is corrupted or not addressed to the node
+*
+*/
+
+  virtual orLayer PeelOnionInPlace (uint8_t *onion, uint16_t onionLen, uint8_t *publicKey,
+                                    uint8_t *secretKey);
+
+  /**
+*
 * \brief virtual method, implement encryption
 * 
 *   \param [in,out] ciphertext memory on which the ciphertext will be stored
 *   \param [in] plaintext memory locations containing the data to be encrypted
 *   \param [in] len length in bytes of the \p plaintext 
 *   \param [in] key encryption key 
-*
+*  <br>
+*   \return true on success, false if the encryption failed
 *
 */
-  virtual void EncryptLayer (uint8_t *ciphertext, uint8_t *plaintext, int len,
+  virtual bool EncryptLayer (uint8_t *ciphertext, uint8_t *plaintext, int len,
                              uint8_t *key) const = 0;
 
   /**
 *
 * \brief virtual method, implement decryption
 * 
-*   \param [in,out] plaintext memory locations containing the decrypted data
+*   \param [in,out] plaintext memory locations containing the decrypted data, may overlap \p ciphertext at \p ciphertext + \p m_sealPadding
 *   \param [in] ciphertext memory locations containing the encrypted data
 *   \param [in] len length in bytes of the \p ciphertext
 *   \param [in] publicKey encryption key 
 *   \param [in] secretKey encryption key 
 *
-* 
+*   \return true on success, false if the layer is corrupted or not addressed to the node
+*
 */
-  virtual void DecryptLayer (uint8_t *plaintext, uint8_t *ciphertext, uint16_t len,
+  virtual bool DecryptLayer (uint8_t *plaintext, uint8_t *ciphertext, uint16_t len,
                              uint8_t *publicKey, uint8_t *secretKey) const = 0;
 
   /**
@@ -290,18 +803,87 @@ public:
 *   \return an integer detailing the length in bytes of the onion message at given parameters
 *
 */
-  uint16_t OnionLength (uint16_t routeLen, uint16_t layerContentLen, uint16_t endContentLen);
+  virtual uint16_t OnionLength (uint16_t routeLen, uint16_t layerContentLen,
+                                uint16_t endContentLen);
 
   /**
 *
-* \brief Output an ip address to a stream variable, used to LOG the onion message
+* \brief Output an ip address or a node id to a stream variable, used to LOG the onion message
 * 
-*   \param [in] ip serialized ip address
+*   \param [in,out] os the output stream
+*   \param [in] ip serialized ip address or node id
+* 
+*
+*/
+
+  void AddressToStream (std::ostream &os, const uint8_t *ip) const;
+
+  /**
+*
+* \brief Enable or disable the capture of the onion construction trace
+*
+* The trace is captured also when the LOG_INFO level of the onionrouting log component is enabled.
+* The trace is not captured if the module is compiled with ONION_ROUTING_TRACE set to 0.
 * 
+*   \param [in] enable true to capture the trace of subsequently built onions
 *
 */
 
-  void AddressToStream (uint8_t *ip);
+  void EnableTrace (bool enable);
+
+  /**
+*
+* \brief Check if the trace of the onion construction is captured
+*
+* \return true if the trace is captured
+*
+*/
+
+  bool IsTraceEnabled (void) const;
+
+  /**
+*
+* \brief Return the trace of the last onion built, one entry for each hop in the route
+*
+* \return pointer to the first entry of the trace
+*
+*/
+
+  const orTraceEntry *GetTrace (void) const;
+
+  /**
+*
+* \brief Return the number of entries in the trace of the last onion built
+*
+* \return the number of entries, at most ONION_TRACE_SIZE
+*
+*/
+
+  uint16_t GetTraceLength (void) const;
+
+  /**
+*
+* \brief Check if the trace of the last onion built is truncated
+*
+* Only the first ONION_TRACE_SIZE hops of longer routes are captured.
+*
+* \return true if the route of the last onion built is longer than the trace
+*
+*/
+
+  bool IsTraceTruncated (void) const;
+
+  /**
+*
+* \brief Format the trace of the last onion built
+*   example: (((10.1.1.2) 10.1.1.1) 10.1.1.5) 10.1.1.3
+*   hops missing from a truncated trace are summarized as the inner term: ((... 3 hops) 10.1.1.7) ...
+*
+* \return the onion message represented as a string
+*
+*/
+
+  std::string TraceToString (void) const;
 
   /**
 *
@@ -315,9 +897,15 @@ public:
 
   uint16_t
       m_sealPadding; //!< size increase of the ciphertext in bytes, intorduced by the encryption method
-  uint16_t m_addressSize; //!< size in bytes of the used address type (4-Ipv4, 16-Ipv6)
-  std::stringstream m_onionStream; //!< stringstream used to LOG onion construction
-  mutable enum OnionErrno m_errno; //!< error status while using the onion class
+  uint16_t m_addressSize; //!< size in bytes of the used address type (1,2-node id, 4-Ipv4, 16-Ipv6)
+
+  static constexpr uint16_t ONION_TRACE_SIZE = 64; //!< maximum number of hops captured by the trace
+
+  bool m_traceEnabled; //!< capture the trace of the onion construction
+  orTraceEntry m_trace[ONION_TRACE_SIZE]; //!< trace of the last onion built
+  uint16_t m_traceLen; //!< number of entries in \p m_trace
+  uint16_t m_traceRouteLen; //!< length of the route of the last onion traced, larger than \p m_traceLen if truncated
+  enum OnionErrno m_errno; //!< error status of the last non-const call, not written by the reentrant construction
 };
 
 /**
@@ -374,8 +962,8 @@ public:
 */
   uint8_t *GetEncryptionKey (void);
 
-  virtual void EncryptLayer (uint8_t *ciphertext, uint8_t *message, int len, uint8_t *key) const;
-  virtual void DecryptLayer (uint8_t *innerLayer, uint8_t *onion, uint16_t onionLen, uint8_t *pk,
+  virtual bool EncryptLayer (uint8_t *ciphertext, uint8_t *message, int len, uint8_t *key) const;
+  virtual bool DecryptLayer (uint8_t *innerLayer, uint8_t *onion, uint16_t onionLen, uint8_t *pk,
                              uint8_t *sk) const;
 
   uint8_t m_encryptionkey[4]; //!< the current encryption key
@@ -1,55 +1,633 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
-// Include a header file from your module to test.
 #include "ns3/onion-routing.h"
-
-// An essential include is test.h
+#include "ns3/onion-routing-static.h"
 #include "ns3/test.h"
 
+#include <string.h>
+#include <vector>
+
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
 using namespace ns3;
 
-// This is an example TestCase.
-class OnionRoutingTestCase1 : public TestCase
+/**
+ * \brief Keyed encryption of the tests, the layer is XORed with a stream derived from the 4-Bytes key
+ *
+ * Unlike ns3::OnionRoutingDummyEncryption the plaintext is transformed, so a wrong offset or
+ * a wrong length of a layer changes the onion message. Keys starting with a zero byte are rejected.
+ */
+static bool
+TestEncrypt (uint16_t sealPadding, uint8_t *ciphertext, uint8_t *plaintext, int len, uint8_t *key)
+{
+  //a zero key fails, to test the error paths
+  if (key[0] == 0)
+    {
+      return false;
+    }
+  memmove (&ciphertext[sealPadding], plaintext, len);
+  for (int i = 0; i < len; ++i)
+    {
+      ciphertext[sealPadding + i] ^= key[i % 4] + i;
+    }
+  memset (ciphertext, 0, sealPadding);
+  memcpy (ciphertext, key, 4);
+  return true;
+}
+
+/**
+ * \brief Decryption of TestEncrypt(), fails if the layer was encrypted with another key
+ */
+static bool
+TestDecrypt (uint16_t sealPadding, uint8_t *plaintext, uint8_t *ciphertext, uint16_t len,
+             uint8_t *publicKey)
+{
+  if (memcmp (ciphertext, publicKey, 4) != 0)
+    {
+      return false;
+    }
+  //forward copy, plaintext may overlap ciphertext at ciphertext + sealPadding
+  for (int i = 0; i < len - sealPadding; ++i)
+    {
+      plaintext[i] = ciphertext[sealPadding + i] ^ (uint8_t) (publicKey[i % 4] + i);
+    }
+  return true;
+}
+
+/**
+ * \ingroup onion-routing
+ * \brief OnionRouting encrypting layers with TestEncrypt()
+ */
+class OnionRoutingTestCipher : public OnionRouting
+{
+public:
+  /**
+   * \brief Constructor
+   * \param [in] sealPadding size increase of the ciphertext, at least 4 Bytes
+   * \param [in] family encoding of next hop addresses
+   */
+  OnionRoutingTestCipher (uint16_t sealPadding, enum OnionAddressFamily family)
+    : OnionRouting (sealPadding, family)
+  {
+  }
+
+  virtual bool
+  EncryptLayer (uint8_t *ciphertext, uint8_t *plaintext, int len, uint8_t *key) const
+  {
+    return TestEncrypt (m_sealPadding, ciphertext, plaintext, len, key);
+  }
+
+  virtual bool
+  DecryptLayer (uint8_t *plaintext, uint8_t *ciphertext, uint16_t len, uint8_t *publicKey,
+                uint8_t *secretKey) const
+  {
+    return TestDecrypt (m_sealPadding, plaintext, ciphertext, len, publicKey);
+  }
+};
+
+/**
+ * \ingroup onion-routing
+ * \brief Cipher policy of ns3::OnionRoutingStatic encrypting layers with TestEncrypt()
+ */
+template <uint16_t SealPadding>
+class OnionTestCipher
+{
+public:
+  static bool
+  Encrypt (uint8_t *ciphertext, uint8_t *plaintext, int len, uint8_t *key)
+  {
+    return TestEncrypt (SealPadding, ciphertext, plaintext, len, key);
+  }
+
+  static bool
+  Decrypt (uint8_t *plaintext, uint8_t *ciphertext, uint16_t len, uint8_t *publicKey,
+           uint8_t *secretKey)
+  {
+    return TestDecrypt (SealPadding, plaintext, ciphertext, len, publicKey);
+  }
+};
+
+/**
+ * \brief Route, keys and contents of the onions of the tests
+ */
+class OnionRoutingTestRoute
+{
+public:
+  /**
+   * \brief Fill addresses, keys and contents with distinct values
+   * \param [in] routeLen number of hops
+   * \param [in] addressSize size in bytes of an address
+   * \param [in] layerContentLen bytes of content of each layer
+   * \param [in] endContentLen bytes of the end content
+   */
+  OnionRoutingTestRoute (uint16_t routeLen, uint16_t addressSize, uint16_t layerContentLen,
+                         uint16_t endContentLen)
+    : addresses (routeLen * addressSize),
+      keys (routeLen * 4),
+      contents (routeLen * layerContentLen),
+      endContent (endContentLen),
+      route (routeLen),
+      keyView (routeLen),
+      contentView (routeLen)
+  {
+    for (uint16_t i = 0; i < routeLen; ++i)
+      {
+        for (uint16_t j = 0; j < addressSize; ++j)
+          {
+            addresses[i * addressSize + j] = 10 * (i + 1) + j;
+          }
+        for (uint16_t j = 0; j < 4; ++j)
+          {
+            keys[i * 4 + j] = 0xa0 + 4 * i + j;
+          }
+        for (uint16_t j = 0; j < layerContentLen; ++j)
+          {
+            contents[i * layerContentLen + j] = 0x40 + i + 3 * j;
+          }
+        route[i] = &addresses[i * addressSize];
+        keyView[i] = &keys[i * 4];
+        contentView[i] = &contents[i * layerContentLen];
+      }
+    for (uint16_t j = 0; j < endContentLen; ++j)
+      {
+        endContent[j] = 0xe0 ^ j;
+      }
+  }
+
+  std::vector<uint8_t> addresses; //!< serialized addresses of the hops
+  std::vector<uint8_t> keys; //!< 4-Bytes keys of the hops
+  std::vector<uint8_t> contents; //!< content of each layer
+  std::vector<uint8_t> endContent; //!< content delivered to the last hop
+  std::vector<uint8_t *> route; //!< pointers to the addresses
+  std::vector<uint8_t *> keyView; //!< pointers to the keys
+  std::vector<uint8_t *> contentView; //!< pointers to the contents
+};
+
+/**
+ * \brief Recursive construction of the onion message of the original module, the reference of
+ *        the construction from the layer table
+ */
+static void
+RecursiveOnion (OnionRouting &onion, uint8_t *cipher, uint8_t **route, uint8_t **keys,
+                uint16_t index, uint16_t routeLen, uint8_t **layerContent,
+                uint16_t layerContentLen, uint8_t *endContent, uint16_t endContentLen)
+{
+  uint16_t seal = onion.m_sealPadding;
+  uint16_t addr = onion.GetAddressSize ();
+  int plainLayerLen =
+      addr + layerContentLen + onion.OnionLength (index - 1, layerContentLen, endContentLen);
+
+  if (index <= 2 && (endContentLen != 0 || layerContentLen != 0))
+    {
+      uint8_t *inner = &cipher[addr + layerContentLen + seal];
+      memset (&inner[seal], 0, addr);
+      if (endContentLen != 0)
+        {
+          memcpy (&inner[seal + addr], endContent, endContentLen);
+          onion.EncryptLayer (inner, &inner[seal], addr + endContentLen,
+                              keys[routeLen - index + 1]);
+        }
+      else
+        {
+          memcpy (&inner[seal + addr], layerContent[routeLen - index + 1], layerContentLen);
+          onion.EncryptLayer (inner, &inner[seal], addr + layerContentLen,
+                              keys[routeLen - index + 1]);
+        }
+    }
+  else if (index > 2)
+    {
+      RecursiveOnion (onion, &cipher[seal + addr + layerContentLen], route, keys, index - 1,
+                      routeLen, layerContent, layerContentLen, endContent, endContentLen);
+    }
+
+  memcpy (&cipher[seal], route[routeLen - index + 1], addr);
+  if (layerContentLen != 0)
+    {
+      memcpy (&cipher[seal + addr], layerContent[routeLen - index], layerContentLen);
+    }
+  onion.EncryptLayer (cipher, &cipher[seal], plainLayerLen, keys[routeLen - index]);
+}
+
+/**
+ * \ingroup onion-routing
+ * \brief The construction from the layer table is byte-identical to the recursive construction
+ */
+class OnionRoutingLayerTableTestCase : public TestCase
 {
 public:
-  OnionRoutingTestCase1 ();
-  virtual ~OnionRoutingTestCase1 ();
+  OnionRoutingLayerTableTestCase ();
 
 private:
   virtual void DoRun (void);
 };
 
-// Add some help text to this case to describe what it is intended to test
-OnionRoutingTestCase1::OnionRoutingTestCase1 ()
-  : TestCase ("OnionRouting test case (does nothing)")
+OnionRoutingLayerTableTestCase::OnionRoutingLayerTableTestCase ()
+  : TestCase ("Onions built from the layer table equal the recursive construction")
 {
 }
 
-// This destructor does nothing but we include it as a reminder that
-// the test case should clean up after itself
-OnionRoutingTestCase1::~OnionRoutingTestCase1 ()
+void
+OnionRoutingLayerTableTestCase::DoRun (void)
+{
+  const enum OnionAddressFamily families[] = {ONION_NODEID16, ONION_IPV4, ONION_IPV6};
+  //no content, end content, layer content, layer and end content
+  const uint16_t contents[4][2] = {{0, 0}, {0, 11}, {5, 0}, {5, 11}};
+
+  for (enum OnionAddressFamily family : families)
+    {
+      OnionRoutingTestCipher onion (8, family);
+      for (uint16_t routeLen = 4; routeLen <= 7; routeLen += 3)
+        {
+          for (const uint16_t *content : contents)
+            {
+              OnionRoutingTestRoute r (routeLen, family, content[0], content[1]);
+              uint16_t len = onion.OnionLength (routeLen, content[0], content[1]);
+              std::vector<uint8_t> expected (len, 0);
+              std::vector<uint8_t> cipher (len, 0);
+
+              RecursiveOnion (onion, &expected[0], &r.route[0], &r.keyView[0], routeLen,
+                              routeLen, &r.contentView[0], content[0], &r.endContent[0],
+                              content[1]);
+              onion.BuildOnion (&cipher[0], &r.route[0], &r.keyView[0], &r.contentView[0],
+                                content[0], routeLen, &r.endContent[0], content[1]);
+
+              NS_TEST_ASSERT_MSG_EQ (onion.GetErrno (), OnionRouting::ERROR_NOTERROR,
+                                     "construction failed");
+              NS_TEST_ASSERT_MSG_EQ ((cipher == expected), true,
+                                     "onion differs from the recursive construction, family "
+                                         << family << " route " << routeLen << " content "
+                                         << content[0] << "/" << content[1]);
+            }
+        }
+    }
+}
+
+/**
+ * \ingroup onion-routing
+ * \brief Every hop peels its layer, into a buffer and in place, and finds the next hop and the content
+ */
+class OnionRoutingPeelTestCase : public TestCase
+{
+public:
+  OnionRoutingPeelTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+OnionRoutingPeelTestCase::OnionRoutingPeelTestCase ()
+  : TestCase ("Onions are peeled hop by hop, into a buffer and in place")
 {
 }
 
-//
-// This method is the pure virtual method from class TestCase that every
-// TestCase must implement
-//
 void
-OnionRoutingTestCase1::DoRun (void)
+OnionRoutingPeelTestCase::DoRun (void)
 {
-  // A wide variety of test macros are available in src/core/test.h
-  NS_TEST_ASSERT_MSG_EQ (true, true, "true doesn't equal true for some reason");
-  // Use this one for floating point comparisons
-  NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
+  const uint16_t routeLen = 5;
+  const uint16_t layerContentLen = 3;
+  const uint16_t endContentLen = 9;
+  OnionRoutingTestCipher onion (8, ONION_IPV4);
+  OnionRoutingTestRoute r (routeLen, ONION_IPV4, layerContentLen, endContentLen);
+  uint16_t len = onion.OnionLength (routeLen, layerContentLen, endContentLen);
+  std::vector<uint8_t> cipher (len);
+  onion.BuildOnion (&cipher[0], &r.route[0], &r.keyView[0], &r.contentView[0], layerContentLen,
+                    routeLen, &r.endContent[0], endContentLen);
+
+  std::vector<uint8_t> layerOnion (cipher);
+  std::vector<uint8_t> buffer (len);
+  uint8_t *current = &layerOnion[0];
+  uint16_t currentLen = len;
+  uint8_t *inPlace = &cipher[0];
+  uint16_t inPlaceLen = len;
+  uint8_t zero[4] = {0, 0, 0, 0};
+
+  for (uint16_t hop = 0; hop < routeLen; ++hop)
+    {
+      orLayer copy = onion.PeelOnion (current, currentLen, r.keyView[hop], nullptr, &buffer[0]);
+      NS_TEST_ASSERT_MSG_EQ (onion.GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "hop " << hop << " can not peel its layer");
+      orLayer layer = onion.PeelOnionInPlace (inPlace, inPlaceLen, r.keyView[hop], nullptr);
+      NS_TEST_ASSERT_MSG_EQ (onion.GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "hop " << hop << " can not peel its layer in place");
+
+      NS_TEST_ASSERT_MSG_EQ (layer.innerLayerLen, copy.innerLayerLen, "peels differ in length");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (layer.nextHopIP, copy.nextHopIP, 4 + copy.innerLayerLen), 0,
+                             "peels differ");
+      NS_TEST_ASSERT_MSG_EQ (layer.nextHopIP, inPlace + onion.m_sealPadding,
+                             "the layer is not peeled in place");
+
+      uint8_t *next = (hop + 1 < routeLen) ? r.route[hop + 1] : zero;
+      NS_TEST_ASSERT_MSG_EQ (memcmp (layer.nextHopIP, next, 4), 0,
+                             "wrong next hop at hop " << hop);
+      if (hop + 1 < routeLen)
+        {
+          NS_TEST_ASSERT_MSG_EQ (memcmp (layer.innerLayer, r.contentView[hop], layerContentLen), 0,
+                                 "wrong layer content at hop " << hop);
+          //the inner onion follows the layer content
+          memcpy (&layerOnion[0], copy.innerLayer + layerContentLen,
+                  copy.innerLayerLen - layerContentLen);
+          current = &layerOnion[0];
+          currentLen = copy.innerLayerLen - layerContentLen;
+          inPlace = layer.innerLayer + layerContentLen;
+          inPlaceLen = layer.innerLayerLen - layerContentLen;
+        }
+      else
+        {
+          NS_TEST_ASSERT_MSG_EQ (layer.innerLayerLen, endContentLen, "wrong end content length");
+          NS_TEST_ASSERT_MSG_EQ (memcmp (layer.innerLayer, &r.endContent[0], endContentLen), 0,
+                                 "wrong end content");
+        }
+    }
+
+  //a layer not addressed to the node and a truncated layer are rejected
+  onion.BuildOnion (&cipher[0], &r.route[0], &r.keyView[0], &r.contentView[0], layerContentLen,
+                    routeLen, &r.endContent[0], endContentLen);
+  onion.PeelOnion (&cipher[0], len, r.keyView[1], nullptr, &buffer[0]);
+  NS_TEST_ASSERT_MSG_EQ (onion.GetErrno (), OnionRouting::ERROR_DECRYPTION,
+                         "layer peeled with the wrong key");
+  onion.PeelOnionInPlace (&cipher[0], onion.m_sealPadding + 3, r.keyView[0], nullptr);
+  NS_TEST_ASSERT_MSG_EQ (onion.GetErrno (), OnionRouting::ERROR_DECRYPTION,
+                         "truncated layer peeled");
 }
 
-// The TestSuite class names the TestSuite, identifies what type of TestSuite,
-// and enables the TestCases to be run.  Typically, only the constructor for
-// this class must be defined
-//
+/**
+ * \ingroup onion-routing
+ * \brief Onions are built from a route descriptor and reuse the suffixes of the cache
+ */
+class OnionRoutingSuffixCacheTestCase : public TestCase
+{
+public:
+  OnionRoutingSuffixCacheTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+OnionRoutingSuffixCacheTestCase::OnionRoutingSuffixCacheTestCase ()
+  : TestCase ("Onions built with the suffix cache equal onions built without")
+{
+}
+
+void
+OnionRoutingSuffixCacheTestCase::DoRun (void)
+{
+  const uint16_t routeLen = 6;
+  OnionRoutingTestCipher onion (8, ONION_IPV4);
+  OnionRoutingTestRoute r (routeLen, ONION_IPV4, 0, 0);
+  OnionSuffixCache cache (4096);
+  uint16_t len = onion.OnionLength (routeLen, 0, 0);
+
+  OnionRouteDescriptor descriptor (4, 4);
+  for (uint16_t i = 0; i < routeLen; ++i)
+    {
+      descriptor.AddHop (r.route[i], r.keyView[i]);
+    }
+
+  std::vector<uint8_t> expected (len);
+  onion.BuildOnion (&expected[0], &r.route[0], &r.keyView[0], routeLen);
+
+  //the second onion reuses the suffix of the first one
+  for (int i = 0; i < 2; ++i)
+    {
+      std::vector<uint8_t> cipher (len);
+      onion.BuildOnion (&cipher[0], descriptor, cache);
+      NS_TEST_ASSERT_MSG_EQ (onion.GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "construction failed");
+      NS_TEST_ASSERT_MSG_EQ ((cipher == expected), true, "onion " << i << " differs");
+    }
+  NS_TEST_ASSERT_MSG_EQ (cache.GetHits (), 1, "the suffix was not reused");
+}
+
+/**
+ * \ingroup onion-routing
+ * \brief Onions of the compile-time specialization equal the onions of the runtime class, both
+ *        peel the onions of the other
+ */
+class OnionRoutingStaticTestCase : public TestCase
+{
+public:
+  OnionRoutingStaticTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+OnionRoutingStaticTestCase::OnionRoutingStaticTestCase ()
+  : TestCase ("OnionRoutingStatic builds the onions of OnionRouting")
+{
+}
+
+void
+OnionRoutingStaticTestCase::DoRun (void)
+{
+  //no content, end content, layer content, layer and end content
+  const uint16_t contents[4][2] = {{0, 0}, {0, 11}, {5, 0}, {5, 11}};
+  const uint16_t routeLen = 6;
+  OnionRoutingStatic<ONION_IPV4, 8, OnionTestCipher<8>> specialized;
+  OnionRoutingTestCipher runtime (8, ONION_IPV4);
+
+  NS_TEST_ASSERT_MSG_EQ (specialized.GetErrno (), OnionRouting::ERROR_NOTERROR,
+                         "construction of the specialization failed");
+  NS_TEST_ASSERT_MSG_EQ (specialized.GetAddressSize (), 4, "wrong address size");
+
+  for (const uint16_t *content : contents)
+    {
+      OnionRoutingTestRoute r (routeLen, ONION_IPV4, content[0], content[1]);
+      uint16_t len = runtime.OnionLength (routeLen, content[0], content[1]);
+      NS_TEST_ASSERT_MSG_EQ (specialized.OnionLength (routeLen, content[0], content[1]), len,
+                             "lengths differ");
+      std::vector<uint8_t> expected (len);
+      std::vector<uint8_t> cipher (len);
+      runtime.BuildOnion (&expected[0], &r.route[0], &r.keyView[0], &r.contentView[0],
+                          content[0], routeLen, &r.endContent[0], content[1]);
+      specialized.BuildOnion (&cipher[0], &r.route[0], &r.keyView[0], &r.contentView[0],
+                              content[0], routeLen, &r.endContent[0], content[1]);
+      NS_TEST_ASSERT_MSG_EQ (specialized.GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "construction failed");
+      NS_TEST_ASSERT_MSG_EQ ((cipher == expected), true,
+                             "onions differ, content " << content[0] << "/" << content[1]);
+    }
+
+  OnionRoutingTestRoute r (routeLen, ONION_IPV4, 0, 0);
+  uint16_t len = runtime.OnionLength (routeLen, 0, 0);
+  std::vector<uint8_t> cipher (len);
+  std::vector<uint8_t> other (len);
+
+  //route descriptor, suffix cache and reentrant request overloads of the specialization
+  OnionRouteDescriptor descriptor (4, 4);
+  for (uint16_t i = 0; i < routeLen; ++i)
+    {
+      descriptor.AddHop (r.route[i], r.keyView[i]);
+    }
+  runtime.BuildOnion (&other[0], descriptor);
+  specialized.BuildOnion (&cipher[0], descriptor);
+  NS_TEST_ASSERT_MSG_EQ ((cipher == other), true, "onions of the route descriptor differ");
+
+  OnionSuffixCache cache (4096);
+  for (int i = 0; i < 2; ++i)
+    {
+      std::fill (cipher.begin (), cipher.end (), 0);
+      specialized.BuildOnion (&cipher[0], descriptor, cache);
+      NS_TEST_ASSERT_MSG_EQ (specialized.GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "construction from the cache failed");
+      NS_TEST_ASSERT_MSG_EQ ((cipher == other), true, "onion " << i << " of the cache differs");
+    }
+  NS_TEST_ASSERT_MSG_EQ (cache.GetHits (), 1, "the suffix was not reused");
+
+  std::fill (cipher.begin (), cipher.end (), 0);
+  orOnionRequest request = {&cipher[0], &r.route[0], &r.keyView[0], routeLen, nullptr, 0,
+                            nullptr, 0};
+  const OnionRouting &base = specialized;
+  NS_TEST_ASSERT_MSG_EQ (base.BuildOnion (request), OnionRouting::ERROR_NOTERROR,
+                         "reentrant construction failed");
+  NS_TEST_ASSERT_MSG_EQ ((cipher == other), true, "onions of the request differ");
+  request.routeLen = 3;
+  NS_TEST_ASSERT_MSG_EQ (base.BuildOnion (request), OnionRouting::ERROR_ROUTE_TO_SHORT,
+                         "short route not reported");
+
+  //the cache overload is dispatched to the specialization through the base class
+  OnionSuffixCache baseCache (4096);
+  std::fill (cipher.begin (), cipher.end (), 0);
+  OnionRouting &view = specialized;
+  view.BuildOnion (&cipher[0], descriptor, baseCache);
+  NS_TEST_ASSERT_MSG_EQ ((cipher == other), true, "onions of the base reference differ");
+
+  //the overloads of the specialization reject short routes too
+  specialized.BuildOnion (&cipher[0], &r.route[0], &r.keyView[0], 3);
+  NS_TEST_ASSERT_MSG_EQ (specialized.GetErrno (), OnionRouting::ERROR_ROUTE_TO_SHORT,
+                         "short route of the specialization not reported");
+
+  //the runtime class peels the onion of the specialization, and the other way around
+  specialized.BuildOnion<routeLen> (&cipher[0], &r.route[0], &r.keyView[0]);
+  runtime.BuildOnion (&other[0], &r.route[0], &r.keyView[0], routeLen);
+  NS_TEST_ASSERT_MSG_EQ ((cipher == other), true, "onions of fixed route length differ");
+
+  uint8_t *onion = &cipher[0];
+  uint8_t *onionOther = &other[0];
+  for (uint16_t hop = 0; hop + 1 < routeLen; ++hop)
+    {
+      orLayer layer = runtime.PeelOnionInPlace (onion, len, r.keyView[hop], nullptr);
+      NS_TEST_ASSERT_MSG_EQ (runtime.GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "hop " << hop << " can not peel the onion of the specialization");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (layer.nextHopIP, r.route[hop + 1], 4), 0,
+                             "wrong next hop at hop " << hop);
+      orLayer layerOther = specialized.PeelOnionInPlace (onionOther, len, r.keyView[hop], nullptr);
+      NS_TEST_ASSERT_MSG_EQ (specialized.GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "hop " << hop << " can not peel the onion of the runtime class");
+      NS_TEST_ASSERT_MSG_EQ (layerOther.innerLayerLen, layer.innerLayerLen, "peels differ");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (layerOther.nextHopIP, layer.nextHopIP,
+                                     4 + layer.innerLayerLen),
+                             0, "peels differ at hop " << hop);
+      onion = layer.innerLayer;
+      onionOther = layerOther.innerLayer;
+      len = layer.innerLayerLen;
+    }
+  NS_TEST_ASSERT_MSG_EQ (len, 0, "the last layer is not empty");
+}
+
+/**
+ * \ingroup onion-routing
+ * \brief The parallel batch builds the onions of the sequential construction and reports failures
+ */
+class OnionRoutingBatchTestCase : public TestCase
+{
+public:
+  OnionRoutingBatchTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+OnionRoutingBatchTestCase::OnionRoutingBatchTestCase ()
+  : TestCase ("BuildOnions builds a batch of onions in parallel")
+{
+}
+
+void
+OnionRoutingBatchTestCase::DoRun (void)
+{
+  const uint32_t count = 24;
+  OnionRoutingTestCipher onion (8, ONION_IPV4);
+  std::vector<OnionRoutingTestRoute *> routes;
+  std::vector<std::vector<uint8_t>> ciphers (count);
+  std::vector<orOnionRequest> requests (count);
+  std::vector<enum OnionRouting::OnionErrno> status (count, OnionRouting::ERROR_NOT_SUPPORTED);
+
+  //route lengths 3 to 9, onions 0, 7, 14 and 21 are too short, the onion 8 has a failing key
+  for (uint32_t i = 0; i < count; ++i)
+    {
+      uint16_t routeLen = 3 + i % 7;
+      uint16_t layerContentLen = (i % 2) * 3;
+      routes.push_back (new OnionRoutingTestRoute (routeLen, ONION_IPV4, layerContentLen, 0));
+      if (i == 8)
+        {
+          routes[i]->keys[4 * 2] = 0;
+        }
+      ciphers[i].resize (onion.OnionLength (routeLen, layerContentLen, 0));
+
+      orOnionRequest &request = requests[i];
+      request.cipher = &ciphers[i][0];
+      request.route = &routes[i]->route[0];
+      request.keys = &routes[i]->keyView[0];
+      request.routeLen = routeLen;
+      request.layerContent = layerContentLen != 0 ? &routes[i]->contentView[0] : nullptr;
+      request.layerContentLen = layerContentLen;
+      request.endContent = nullptr;
+      request.endContentLen = 0;
+    }
+
+  onion.BuildOnions (&requests[0], &status[0], count, 4);
+
+  for (uint32_t i = 0; i < count; ++i)
+    {
+      OnionRoutingTestRoute &r = *routes[i];
+      const orOnionRequest &request = requests[i];
+      if (request.routeLen < 4)
+        {
+          NS_TEST_ASSERT_MSG_EQ (status[i], OnionRouting::ERROR_ROUTE_TO_SHORT,
+                                 "short route of onion " << i << " not reported");
+          continue;
+        }
+      if (i == 8)
+        {
+          NS_TEST_ASSERT_MSG_EQ (status[i], OnionRouting::ERROR_ENCRYPTION,
+                                 "failed encryption of onion " << i << " not reported");
+          continue;
+        }
+      NS_TEST_ASSERT_MSG_EQ (status[i], OnionRouting::ERROR_NOTERROR, "onion " << i << " failed");
+
+      std::vector<uint8_t> expected (ciphers[i].size ());
+      if (request.layerContentLen != 0)
+        {
+          onion.BuildOnion (&expected[0], request.route, request.keys, request.layerContent,
+                            request.layerContentLen, request.routeLen);
+        }
+      else
+        {
+          onion.BuildOnion (&expected[0], request.route, request.keys, request.routeLen);
+        }
+      NS_TEST_ASSERT_MSG_EQ ((ciphers[i] == expected), true,
+                             "onion " << i << " differs from the sequential construction");
+
+      //the first hop peels the onion
+      orLayer layer = onion.PeelOnionInPlace (&ciphers[i][0], ciphers[i].size (), r.keyView[0],
+                                              nullptr);
+      NS_TEST_ASSERT_MSG_EQ (onion.GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "onion " << i << " can not be peeled");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (layer.nextHopIP, r.route[1], 4), 0,
+                             "wrong next hop of onion " << i);
+    }
+
+  for (OnionRoutingTestRoute *r : routes)
+    {
+      delete r;
+    }
+}
+
+/**
+ * \ingroup onion-routing
+ * \brief Tests of the construction and of the decryption of onion messages
+ */
 class OnionRoutingTestSuite : public TestSuite
 {
 public:
@@ -59,10 +637,12 @@ public:
 OnionRoutingTestSuite::OnionRoutingTestSuite ()
   : TestSuite ("onion-routing", UNIT)
 {
-  // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
-  AddTestCase (new OnionRoutingTestCase1, TestCase::QUICK);
+  AddTestCase (new OnionRoutingLayerTableTestCase, TestCase::QUICK);
+  AddTestCase (new OnionRoutingPeelTestCase, TestCase::QUICK);
+  AddTestCase (new OnionRoutingSuffixCacheTestCase, TestCase::QUICK);
+  AddTestCase (new OnionRoutingStaticTestCase, TestCase::QUICK);
+  AddTestCase (new OnionRoutingBatchTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
 static OnionRoutingTestSuite sonionRoutingTestSuite;
-
@@ -0,0 +1,477 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include "ns3/enums.h"
+#include "ns3/onionmanager.h"
+#include "ns3/sharedkeyonionmanager.h"
+#include "ns3/sphinxonionmanager.h"
+#include "ns3/costmodelonionmanager.h"
+#include "ns3/aeadonionmanager.h"
+#include "ns3/onionstream.h"
+#include "ns3/serializationwrapper.h"
+#include "ns3/binarywrapper.h"
+#include "ns3/segmentnum.h"
+#include "ns3/wsn_node.h"
+
+/*
+ * Microbenchmarks of the hot paths of the simulator, outside of the simulation:
+ *
+ *  - BuildOnion and PeelOnion of each ns3::OnionMode, and of the compile-time specialized
+ *    sealed box, sweeping the route length and the layer content size
+ *  - streaming of a large end content chunk by chunk through all hops, sweeping the route length
+ *  - round trips of the protobuf and binary wire formats of ns3::Wsn_node::EncodePacket(),
+ *    sweeping the body size
+ *  - reassembly by ns3::Wsn_node::RecvSeg() of a packet split into MSS segments,
+ *    sweeping the body size
+ *
+ * Each case reports the time, the bytes and the number of allocations per operation
+ * and the throughput.
+ *
+ *  ./waf --run "onion-routing-wsn-benchmark --suite=onion --minTime=0.5"
+ */
+
+using namespace ns3;
+
+namespace {
+
+uint64_t g_allocBytes = 0; //!< bytes requested from operator new, the benchmark is single threaded
+uint64_t g_allocCount = 0; //!< calls of operator new
+volatile uint8_t g_sink = 0; //!< results are stored here so the measured work is not optimized away
+
+} // namespace
+
+//count the allocations, array forms forward to these
+void *
+operator new (std::size_t size)
+{
+  g_allocBytes += size;
+  ++g_allocCount;
+  void *p = std::malloc (size == 0 ? 1 : size);
+  if (p == nullptr)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void *
+operator new (std::size_t size, const std::nothrow_t &) noexcept
+{
+  g_allocBytes += size;
+  ++g_allocCount;
+  return std::malloc (size == 0 ? 1 : size);
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, const std::nothrow_t &) noexcept
+{
+  std::free (p);
+}
+
+namespace {
+
+/**
+ * \brief result of a benchmark case
+ */
+struct BenchResult
+{
+  uint64_t iterations; //!< number of measured operations
+  double nsPerOp; //!< wall clock time per operation
+  double bytesPerOp; //!< bytes allocated per operation
+  double allocsPerOp; //!< allocations per operation
+};
+
+/**
+ * \brief Run \p op in batches of doubling size until \p minTime seconds elapsed
+ *        The first call is a warm up and is not measured
+ */
+template <class Op>
+BenchResult
+Measure (Op op, double minTime)
+{
+  op ();
+
+  uint64_t iterations = 0;
+  uint64_t batch = 1;
+  uint64_t allocBytes = g_allocBytes;
+  uint64_t allocCount = g_allocCount;
+  double elapsed = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  while (elapsed < minTime)
+    {
+      for (uint64_t i = 0; i < batch; ++i)
+        {
+          op ();
+        }
+      iterations += batch;
+      batch *= 2;
+      elapsed =
+          std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+    }
+
+  BenchResult result;
+  result.iterations = iterations;
+  result.nsPerOp = elapsed * 1e9 / iterations;
+  result.bytesPerOp = double (g_allocBytes - allocBytes) / iterations;
+  result.allocsPerOp = double (g_allocCount - allocCount) / iterations;
+  return result;
+}
+
+//print a row, processedBytes is the size of the data handled by one operation
+void
+Report (const std::string &name, const std::string &params, const BenchResult &result,
+        uint32_t processedBytes)
+{
+  std::printf ("%-30s %-26s %12.1f ns/op %10.1f B/op %8.2f allocs/op %10.2f MB/s\n",
+               name.c_str (), params.c_str (), result.nsPerOp, result.bytesPerOp,
+               result.allocsPerOp, processedBytes * 1e3 / result.nsPerOp);
+}
+
+//same switch as Wsn_node::Configure ()
+Ptr<OnionManager>
+CreateManager (enum OnionMode mode)
+{
+  switch (mode)
+    {
+    case OnionMode::SharedKey:
+      return CreateObject<SharedKeyOnionManager> ();
+    case OnionMode::Sphinx:
+      return CreateObject<SphinxOnionManager> ();
+    case OnionMode::CostModel:
+      return CreateObject<CostModelOnionManager> ();
+    case OnionMode::Aead:
+      return CreateObject<AeadOnionManager> ();
+    case OnionMode::SealedBox:
+    default:
+      return CreateObject<OnionManager> ();
+    }
+}
+
+/**
+ * \brief onion backend under benchmark
+ */
+struct OnionBackend
+{
+  const char *name; //!< name in the report
+  enum OnionMode mode; //!< mode of the ns3::OnionManager creating the keys
+  bool compileTime; //!< build and peel with ns3::SealedBoxOnionRouting instead of the manager
+  const char *cipher; //!< value of ns3::AeadOnionManager::Cipher, only for the aead mode
+};
+
+void
+BenchOnion (const OnionBackend &backend, uint16_t routeLen, uint16_t contentLen, double minTime)
+{
+  if (backend.cipher != nullptr)
+    {
+      Config::SetDefault ("ns3::AeadOnionManager::Cipher", StringValue (backend.cipher));
+    }
+
+  //the sink and the nodes on the route exchange keys as in the handshake
+  Ptr<OnionManager> sink = CreateManager (backend.mode);
+  sink->GenerateNewKeyPair ();
+
+  std::vector<Ptr<OnionManager>> nodes (routeLen);
+  std::vector<std::string> layerKeys (routeLen);
+  std::vector<uint8_t> addresses (routeLen * 4);
+  std::vector<uint8_t> contents (routeLen * contentLen + 1, 0xab);
+  std::vector<uint8_t *> route (routeLen);
+  std::vector<uint8_t *> keys (routeLen);
+  std::vector<uint8_t *> content (routeLen);
+  for (uint16_t i = 0; i < routeLen; ++i)
+    {
+      nodes[i] = CreateManager (backend.mode);
+      nodes[i]->GenerateNewKeyPair ();
+      nodes[i]->SetPeerPublicKey (sink->GetPKtoString ());
+      layerKeys[i] = sink->LayerKey (nodes[i]->GetPKtoString ());
+      keys[i] = (uint8_t *) &layerKeys[i][0];
+      Ipv4Address (0x0a010102 + i).Serialize (&addresses[i * 4]);
+      route[i] = &addresses[i * 4];
+      content[i] = &contents[i * contentLen];
+    }
+
+  SealedBoxOnionRouting builder;
+  OnionRouting *onionRouting = backend.compileTime ? (OnionRouting *) &builder : PeekPointer (sink);
+  OnionRouting *peeler =
+      backend.compileTime ? (OnionRouting *) &builder : PeekPointer (nodes[0]);
+
+  uint16_t onionLen = onionRouting->OnionLength (routeLen, contentLen, 0);
+  std::vector<uint8_t> onion (onionLen);
+  std::vector<uint8_t> buffer (onionLen);
+
+  auto build = [&] () {
+    if (contentLen == 0)
+      {
+        onionRouting->BuildOnion (onion.data (), route.data (), keys.data (), routeLen);
+      }
+    else
+      {
+        onionRouting->BuildOnion (onion.data (), route.data (), keys.data (), content.data (),
+                                  contentLen, routeLen);
+      }
+    g_sink = onion[0];
+  };
+
+  //call the specialization directly so the peeling of the compile time backend is statically
+  //dispatched and its Cipher policy inlined, like BuildOnion of the builder
+  auto peel = [&] () {
+    orLayer layer =
+        backend.compileTime
+            ? builder.PeelOnion (onion.data (), onionLen, nodes[0]->GetPK (),
+                                 nodes[0]->GetDecryptionKey (), buffer.data ())
+            : peeler->PeelOnion (onion.data (), onionLen, nodes[0]->GetPK (),
+                                 nodes[0]->GetDecryptionKey (), buffer.data ());
+    g_sink = layer.nextHopIP[0];
+  };
+
+  std::string params = "route=" + std::to_string (routeLen) +
+                       " content=" + std::to_string (contentLen);
+
+  //check once that the onion is built and the first hop recovers the next hop
+  build ();
+  if (onionRouting->GetErrno () != OnionRouting::ERROR_NOTERROR)
+    {
+      std::printf ("%-30s %-26s building failed with errno %d\n",
+                   (std::string ("BuildOnion/") + backend.name).c_str (), params.c_str (),
+                   (int) onionRouting->GetErrno ());
+      return;
+    }
+  Report (std::string ("BuildOnion/") + backend.name, params, Measure (build, minTime), onionLen);
+
+  orLayer layer = peeler->PeelOnion (onion.data (), onionLen, nodes[0]->GetPK (),
+                                     nodes[0]->GetDecryptionKey (), buffer.data ());
+  if (memcmp (layer.nextHopIP, route[1], 4) != 0)
+    {
+      std::printf ("%-30s %-26s peeling failed\n",
+                   (std::string ("PeelOnion/") + backend.name).c_str (), params.c_str ());
+      return;
+    }
+  Report (std::string ("PeelOnion/") + backend.name, params, Measure (peel, minTime), onionLen);
+}
+
+//encrypt a chunk with ns3::OnionStreamSender and remove the layer of every hop
+void
+BenchStream (uint16_t routeLen, uint32_t chunkLen, double minTime)
+{
+  OnionStreamSender sender;
+  sender.Init (routeLen);
+  std::vector<OnionStreamReceiver> receivers (routeLen);
+  for (uint16_t i = 0; i < routeLen; ++i)
+    {
+      receivers[i].Init (sender.GetLayerContent ()[i]);
+    }
+
+  std::vector<uint8_t> chunk (chunkLen, 0xab);
+  std::vector<uint8_t> in (sender.EncryptedChunkLength (chunkLen));
+  std::vector<uint8_t> out (sender.EncryptedChunkLength (chunkLen));
+
+  auto relay = [&] () {
+    sender.EncryptChunk (in.data (), chunk.data (), chunkLen, false);
+    uint32_t len = sender.EncryptedChunkLength (chunkLen);
+    bool last;
+    for (uint16_t i = 0; i < routeLen; ++i)
+      {
+        receivers[i].DecryptChunk (out.data (), in.data (), len, &last);
+        len -= OnionStreamSender::CHUNK_OVERHEAD;
+        in.swap (out);
+      }
+    g_sink = in[0];
+  };
+
+  std::string params =
+      "route=" + std::to_string (routeLen) + " chunk=" + std::to_string (chunkLen);
+  Report ("OnionStream/chunk", params, Measure (relay, minTime), chunkLen);
+}
+
+//EncodePacket and DecodePacket of a node in the wire format \p format, as in sending and receiving
+//an onion, the body is padding
+void
+BenchSerialization (Ptr<Wsn_node> node, const std::string &format, uint16_t headSize,
+                    uint32_t bodySize, double minTime)
+{
+  node->SetAttribute ("WireFormat", StringValue (format));
+  google::protobuf::Arena arena;
+  protomessage::ProtoPacket &message =
+      *google::protobuf::Arena::CreateMessage<protomessage::ProtoPacket> (&arena);
+  protomessage::ProtoPacket &received =
+      *google::protobuf::Arena::CreateMessage<protomessage::ProtoPacket> (&arena);
+  message.mutable_o_head ()->set_onionid (1);
+  message.mutable_o_head ()->set_onion_message (std::string (headSize, 'h'));
+  OnionPadding padding;
+  padding.body = bodySize > 0;
+  padding.bodyLen = bodySize;
+  uint32_t serializedSize = node->EncodePacket (&message, padding)->GetSize ();
+
+  auto roundTrip = [&] () {
+    Ptr<Packet> p = node->EncodePacket (&message, padding);
+    node->DecodePacket (p, &received);
+    g_sink = received.o_head ().onionid ();
+  };
+
+  std::string params = "format=" + format + " head=" + std::to_string (headSize) +
+                       " body=" + std::to_string (bodySize);
+  Report ("Wsn_node/EncodeDecode", params, Measure (roundTrip, minTime), serializedSize);
+}
+
+//merge the segments of a packet tagged as in Wsn_node::SendSegment ()
+void
+BenchReassembly (Ptr<Wsn_node> node, Ptr<Socket> socket, uint32_t packetSize, uint16_t mss,
+                 double minTime)
+{
+  Ptr<Packet> packet = Create<Packet> (packetSize);
+  if (packetSize / mss > 0)
+    {
+      SegmentNum s_num (packetSize);
+      packet->AddByteTag (s_num);
+    }
+
+  std::vector<Ptr<Packet>> segments;
+  for (uint32_t offset = 0; offset < packetSize; offset += mss)
+    {
+      uint32_t size = std::min<uint32_t> (mss, packetSize - offset);
+      segments.push_back (packet->CreateFragment (offset, size));
+    }
+
+  Address from = InetSocketAddress (Ipv4Address ("10.1.1.2"), 9);
+
+  auto reassemble = [&] () {
+    Ptr<Packet> whole;
+    for (uint32_t i = 0; i < segments.size (); ++i)
+      {
+        whole = node->RecvSeg (socket, segments[i], from);
+      }
+    g_sink = whole->GetSize ();
+  };
+
+  std::string params = "packet=" + std::to_string (packetSize) + " mss=" + std::to_string (mss) +
+                       " segs=" + std::to_string (segments.size ());
+  Report ("Wsn_node/RecvSeg", params, Measure (reassemble, minTime), packetSize);
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  double minTime = 0.2;
+  std::string suite = "all";
+  uint16_t mss = 536;
+
+  CommandLine cmd (__FILE__);
+  cmd.AddValue ("minTime", "Minimum measured time in seconds of each case", minTime);
+  cmd.AddValue ("suite", "Cases to run (all OR onion OR stream OR serialization OR reassembly)",
+                suite);
+  cmd.AddValue ("mss", "Maximum segment size used to split packets for the reassembly", mss);
+  cmd.Parse (argc, argv);
+
+  const uint16_t routeLengths[] = {4, 5, 10, 20, 40};
+  const uint16_t contentLengths[] = {0, 16, 64};
+  const uint32_t bodySizes[] = {0, 256, 1024, 4096, 16384};
+
+  const OnionBackend backends[] = {
+      {"sealed", OnionMode::SealedBox, false},   {"sealed-static", OnionMode::SealedBox, true},
+      {"shared", OnionMode::SharedKey, false},   {"sphinx", OnionMode::Sphinx, false},
+      {"costmodel", OnionMode::CostModel, false},
+      {"aead-aesgcm", OnionMode::Aead, false, "aesgcm"},
+      {"aead-chachapoly", OnionMode::Aead, false, "chachapoly"},
+      {"aead-null", OnionMode::Aead, false, "null"}};
+
+  if (suite == "all" || suite == "onion")
+    {
+      for (const OnionBackend &backend : backends)
+        {
+          for (uint16_t contentLen : contentLengths)
+            {
+              //the Sphinx onion head carries only routing information
+              if (backend.mode == OnionMode::Sphinx && contentLen > 0)
+                {
+                  continue;
+                }
+              for (uint16_t routeLen : routeLengths)
+                {
+                  BenchOnion (backend, routeLen, contentLen, minTime);
+                }
+            }
+        }
+    }
+
+  if (suite == "all" || suite == "stream")
+    {
+      for (uint16_t routeLen : routeLengths)
+        {
+          BenchStream (routeLen, 4096, minTime);
+        }
+    }
+
+  if (suite == "all" || suite == "serialization")
+    {
+      Ptr<Wsn_node> node = CreateObject<Wsn_node> ();
+      for (uint32_t bodySize : bodySizes)
+        {
+          //onion head of a sealed box onion of route length 10
+          BenchSerialization (node, "protobuf", 468, bodySize, minTime);
+          BenchSerialization (node, "binary", 468, bodySize, minTime);
+        }
+    }
+
+  if (suite == "all" || suite == "reassembly")
+    {
+      Ptr<Node> n = CreateObject<Node> ();
+      InternetStackHelper stack;
+      stack.Install (n);
+      Ptr<Socket> socket = Socket::CreateSocket (n, UdpSocketFactory::GetTypeId ());
+      Ptr<Wsn_node> node = CreateObject<Wsn_node> ();
+
+      for (uint32_t bodySize : bodySizes)
+        {
+          BenchReassembly (node, socket, bodySize + 512, mss, minTime);
+        }
+    }
+
+  Simulator::Destroy ();
+  return 0;
+}
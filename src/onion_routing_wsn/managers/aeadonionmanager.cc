@@ -0,0 +1,173 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include "aeadonionmanager.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("aeadonionmanager");
+
+NS_OBJECT_ENSURE_REGISTERED (AeadOnionManager);
+
+static const unsigned char AEAD_NONCE[crypto_aead_chacha20poly1305_ietf_NPUBBYTES] = {0}; //!< keys are never reused, zero nonce
+
+TypeId
+AeadOnionManager::GetTypeId (void)
+{
+  static TypeId tid =
+      TypeId ("ns3::AeadOnionManager")
+          .SetParent<OnionManager> ()
+          .SetGroupName ("OnionRouting")
+          .AddAttribute ("Cipher", "AEAD encrypting the layers",
+                         EnumValue (LayerCipher::AesGcm),
+                         MakeEnumAccessor (&AeadOnionManager::m_cipher),
+                         MakeEnumChecker (LayerCipher::AesGcm, "aesgcm", LayerCipher::ChaChaPoly,
+                                          "chachapoly", LayerCipher::NullCipher, "null"));
+  return tid;
+}
+
+AeadOnionManager::AeadOnionManager () : OnionManager (LAYER_OVERHEAD)
+{
+}
+
+AeadOnionManager::~AeadOnionManager ()
+{
+}
+
+void
+AeadOnionManager::NotifyConstructionCompleted ()
+{
+  OnionManager::NotifyConstructionCompleted ();
+
+  if (m_cipher == LayerCipher::AesGcm && crypto_aead_aes256gcm_is_available () == 0)
+    {
+      NS_LOG_WARN ("AES-256-GCM is not supported by the CPU, layers are encrypted with "
+                   "ChaCha20-Poly1305");
+      m_cipher = LayerCipher::ChaChaPoly;
+    }
+
+  m_sealPadding = (m_cipher == LayerCipher::NullCipher) ? 0 : LAYER_OVERHEAD;
+}
+
+enum LayerCipher
+AeadOnionManager::GetCipher () const
+{
+  return m_cipher;
+}
+
+void
+AeadOnionManager::LayerSecret (unsigned char *key, const unsigned char *shared,
+                               const unsigned char *ephemeral, const unsigned char *recipient)
+{
+  crypto_generichash_state state;
+  crypto_generichash_init (&state, nullptr, 0, crypto_aead_chacha20poly1305_ietf_KEYBYTES);
+  crypto_generichash_update (&state, shared, crypto_scalarmult_BYTES);
+  crypto_generichash_update (&state, ephemeral, EPHEMERAL_BYTES);
+  crypto_generichash_update (&state, recipient, crypto_box_PUBLICKEYBYTES);
+  crypto_generichash_final (&state, key, crypto_aead_chacha20poly1305_ietf_KEYBYTES);
+}
+
+//the message is stored after the ephemeral key and the MAC, the ciphertext overwrites it in place
+bool
+AeadOnionManager::EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
+                                unsigned char *key) const
+{
+  if (m_cipher == LayerCipher::NullCipher)
+    {
+      memmove (ciphertext, message, len);
+      return true;
+    }
+
+  unsigned char ephemeralSk[crypto_box_SECRETKEYBYTES];
+  unsigned char shared[crypto_scalarmult_BYTES];
+  unsigned char layerKey[crypto_aead_chacha20poly1305_ietf_KEYBYTES];
+  unsigned char *mac = &ciphertext[EPHEMERAL_BYTES];
+  unsigned char *body = &ciphertext[LAYER_OVERHEAD];
+
+  crypto_box_keypair (ciphertext, ephemeralSk);
+  bool ok = crypto_scalarmult (shared, ephemeralSk, key) == 0;
+  LayerSecret (layerKey, shared, ciphertext, key);
+
+  memmove (body, message, len);
+  if (ok && m_cipher == LayerCipher::AesGcm)
+    {
+      ok = crypto_aead_aes256gcm_encrypt_detached (body, mac, nullptr, body, len, nullptr, 0,
+                                                   nullptr, AEAD_NONCE, layerKey) == 0;
+    }
+  else if (ok)
+    {
+      ok = crypto_aead_chacha20poly1305_ietf_encrypt_detached (body, mac, nullptr, body, len,
+                                                               nullptr, 0, nullptr, AEAD_NONCE,
+                                                               layerKey) == 0;
+    }
+
+  sodium_memzero (ephemeralSk, sizeof (ephemeralSk));
+  sodium_memzero (shared, sizeof (shared));
+  sodium_memzero (layerKey, sizeof (layerKey));
+
+  if (!ok)
+    {
+      NS_LOG_ERROR ("Error during encryption");
+    }
+  return ok;
+}
+
+bool
+AeadOnionManager::DecryptLayer (unsigned char *innerLayer, unsigned char *onion, uint16_t onionLen,
+                                unsigned char *pk, unsigned char *sk) const
+{
+  if (m_cipher == LayerCipher::NullCipher)
+    {
+      memmove (innerLayer, onion, onionLen);
+      return true;
+    }
+
+  unsigned char shared[crypto_scalarmult_BYTES];
+  unsigned char layerKey[crypto_aead_chacha20poly1305_ietf_KEYBYTES];
+  const unsigned char *mac = &onion[EPHEMERAL_BYTES];
+  const unsigned char *body = &onion[LAYER_OVERHEAD];
+  uint16_t bodyLen = onionLen - LAYER_OVERHEAD;
+
+  bool ok = onionLen >= LAYER_OVERHEAD && crypto_scalarmult (shared, sk, onion) == 0;
+  if (ok)
+    {
+      LayerSecret (layerKey, shared, onion, pk);
+      if (m_cipher == LayerCipher::AesGcm)
+        {
+          ok = crypto_aead_aes256gcm_decrypt_detached (innerLayer, nullptr, body, bodyLen, mac,
+                                                       nullptr, 0, AEAD_NONCE, layerKey) == 0;
+        }
+      else
+        {
+          ok = crypto_aead_chacha20poly1305_ietf_decrypt_detached (
+                   innerLayer, nullptr, body, bodyLen, mac, nullptr, 0, AEAD_NONCE, layerKey) == 0;
+        }
+    }
+
+  sodium_memzero (shared, sizeof (shared));
+  sodium_memzero (layerKey, sizeof (layerKey));
+
+  return ok;
+}
+
+} // namespace ns3
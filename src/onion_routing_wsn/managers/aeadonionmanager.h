@@ -0,0 +1,142 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef AEADONIONMANAGER_H
+#define AEADONIONMANAGER_H
+
+#include "ns3/onionmanager.h"
+#include "ns3/enums.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup managers
+ * \class AeadOnionManager
+ * \brief Onion manager encrypting layers with an X25519 key agreement and the AEAD of the ns3::LayerCipher attribute
+ *
+ * Each layer is encrypted under a fresh ephemeral X25519 keypair, as a sealed box. The key of the layer is
+ * the BLAKE2b hash of the shared secret, the ephemeral public key and the public key of the recipient,
+ * so the nonce is fixed to zero. AES-256-GCM is used only if the CPU supports it
+ * (crypto_aead_aes256gcm_is_available), otherwise the manager falls back to ChaCha20-Poly1305.
+ * The null cipher copies the layer, it has no overhead and no protection.
+ *
+ * Wire format of a layer: [ephemeral public key (EPHEMERAL_BYTES)][MAC (MAC_BYTES)][encrypted plaintext],
+ * the ciphertext overwrites the plaintext in place. The seal overhead of the cipher is reported to
+ * ns3::OnionRouting once the attributes are set.
+ */
+
+class AeadOnionManager : public OnionManager
+{
+public:
+  static const uint16_t EPHEMERAL_BYTES = crypto_box_PUBLICKEYBYTES; //!< size of the ephemeral public key in front of each layer
+  static const uint16_t MAC_BYTES = crypto_aead_chacha20poly1305_ietf_ABYTES; //!< size of the authentication tag, same for both AEADs
+  static const uint16_t LAYER_OVERHEAD = EPHEMERAL_BYTES + MAC_BYTES; //!< size increase of each layer in bytes
+
+  /**
+ *  Register this type.
+ *  \return The object TypeId.
+ */
+  static TypeId GetTypeId (void);
+
+  /**
+  *
+  * \brief Default constructor
+  *
+  */
+  AeadOnionManager ();
+
+  /**
+  *
+  * \brief Default destructor
+  *
+  */
+  ~AeadOnionManager ();
+
+  /**
+*
+* \brief Encrypt the layer with the configured cipher under a key agreed with an ephemeral keypair
+* 
+*   \param [in,out] ciphertext memory on which the ciphertext will be stored
+*   \param [in] message memory locations containing the data to be encrypted
+*   \param [in] len length in bytes of the \p message 
+*   \param [in] key pointer to the public key of the recipient
+*   \return true on success
+*
+*/
+
+  virtual bool EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
+                             unsigned char *key) const;
+
+  /**
+*
+* \brief Decrypt the layer with the configured cipher
+* 
+*   \param [in,out] innerLayer memory on which the inner onion layer will be stored
+*   \param [in] onion memory locations containing the data to be decrypted
+*   \param [in] onionLen length in bytes of the \p onion 
+*   \param [in] pk pointer to the public key of the node
+*   \param [in] sk pointer to the secret key of the node
+*   \return true on success, false if the layer is corrupted or not addressed to the node
+*
+*/
+
+  virtual bool DecryptLayer (unsigned char *innerLayer, unsigned char *onion, uint16_t onionLen,
+                             unsigned char *pk, unsigned char *sk) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the cipher in use, after the fallback from LayerCipher::AesGcm
+  *
+  */
+  enum LayerCipher GetCipher (void) const;
+
+protected:
+  /**
+  *
+  * \brief Select the cipher available on the CPU and set the seal overhead
+  *
+  */
+  virtual void NotifyConstructionCompleted (void);
+
+private:
+  /**
+  *
+  * \brief Derive the key of a layer
+  *
+  * \param [out] key the key of the layer
+  * \param [in] shared the X25519 shared secret
+  * \param [in] ephemeral the ephemeral public key
+  * \param [in] recipient the public key of the recipient
+  *
+  */
+  static void LayerSecret (unsigned char *key, const unsigned char *shared,
+                           const unsigned char *ephemeral, const unsigned char *recipient);
+
+  enum LayerCipher m_cipher; //!< cipher encrypting the layers
+};
+
+} // namespace ns3
+
+#endif /* AEADONIONMANAGER_H */
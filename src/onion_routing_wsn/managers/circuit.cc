@@ -0,0 +1,245 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include "circuit.h"
+
+#include <string.h>
+
+namespace ns3 {
+
+Circuit::Circuit ()
+    : m_firstHop (0), m_uses (0), m_nonce (0), m_created (Seconds (0)), m_established (false)
+{
+}
+
+void
+Circuit::Create (uint16_t hops, uint32_t firstHop, Time now, Ptr<UniformRandomVariable> rng)
+{
+  m_ids.resize (hops);
+  m_keys.resize (hops * KEY_BYTES);
+  for (uint16_t i = 0; i < hops; ++i)
+    {
+      //ids are never SETUP_ID
+      m_ids[i] = rng->GetInteger (1, UINT32_MAX);
+      for (uint16_t j = 0; j < KEY_BYTES; ++j)
+        {
+          m_keys[i * KEY_BYTES + j] = rng->GetInteger (0, UINT8_MAX);
+        }
+    }
+  //the keys are new, the nonces restart
+  m_nonce = 0;
+  m_firstHop = firstHop;
+  m_uses = 1;
+  m_created = now;
+  m_established = false;
+}
+
+void
+Circuit::FillSetupContent (uint8_t *content) const
+{
+  for (uint16_t i = 0; i < m_ids.size (); ++i)
+    {
+      uint8_t *layer = content + i * SETUP_CONTENT_BYTES;
+      WriteId (layer, m_ids[i]);
+      //the sink is the last hop, it does not forward cells
+      WriteId (layer + ID_BYTES, (i + 1u < m_ids.size ()) ? m_ids[i + 1] : SETUP_ID);
+      memcpy (layer + 2 * ID_BYTES, &m_keys[i * KEY_BYTES], KEY_BYTES);
+    }
+}
+
+uint16_t
+Circuit::GetCellLength () const
+{
+  return ID_BYTES + m_ids.size () * LAYER_OVERHEAD;
+}
+
+bool
+Circuit::BuildCell (uint8_t *cell)
+{
+  //the layer of hop i wraps the layers of the following hops, the layer of the sink is empty
+  uint16_t hops = m_ids.size ();
+  for (int i = hops - 1; i >= 0; --i)
+    {
+      if (!SealLayer (cell + ID_BYTES + i * LAYER_OVERHEAD, (hops - 1 - i) * LAYER_OVERHEAD,
+                      &m_keys[i * KEY_BYTES], m_ids[i], m_nonce))
+        {
+          return false;
+        }
+    }
+  WriteId (cell, m_ids[0]);
+  m_nonce++;
+  m_uses++;
+  return true;
+}
+
+bool
+Circuit::OpenCell (uint8_t *cell, uint16_t cellLen) const
+{
+  uint16_t last = m_ids.size () - 1;
+  if (m_ids.empty () || cellLen != ID_BYTES + LAYER_OVERHEAD || ReadId (cell) != m_ids[last])
+    {
+      return false;
+    }
+  return OpenLayer (cell + ID_BYTES, LAYER_OVERHEAD, &m_keys[last * KEY_BYTES], m_ids[last]);
+}
+
+uint16_t
+Circuit::GetHops () const
+{
+  return m_ids.size ();
+}
+
+uint32_t
+Circuit::GetFirstHop () const
+{
+  return m_firstHop;
+}
+
+uint32_t
+Circuit::GetUses () const
+{
+  return m_uses;
+}
+
+Time
+Circuit::GetCreationTime () const
+{
+  return m_created;
+}
+
+bool
+Circuit::IsEstablished () const
+{
+  return m_established;
+}
+
+void
+Circuit::SetEstablished (bool established)
+{
+  m_established = established;
+}
+
+void
+Circuit::WriteId (uint8_t *dest, uint32_t id)
+{
+  dest[0] = id >> 24;
+  dest[1] = id >> 16;
+  dest[2] = id >> 8;
+  dest[3] = id;
+}
+
+uint32_t
+Circuit::ReadId (const uint8_t *src)
+{
+  return ((uint32_t) src[0] << 24) | ((uint32_t) src[1] << 16) | ((uint32_t) src[2] << 8) | src[3];
+}
+
+void
+Circuit::ReadSetupContent (const uint8_t *content, uint32_t &id, CircuitHop &hop)
+{
+  id = ReadId (content);
+  hop.nextId = ReadId (content + ID_BYTES);
+  memcpy (hop.key, content + 2 * ID_BYTES, KEY_BYTES);
+}
+
+bool
+Circuit::SealLayer (uint8_t *layer, uint16_t innerLen, const uint8_t *key, uint32_t id,
+                    uint64_t nonce)
+{
+  uint8_t ad[ID_BYTES];
+  WriteId (ad, id);
+  //a counter nonce in big endian, keys are reused by all the cells of the circuit
+  memset (layer, 0, NONCE_BYTES);
+  for (uint16_t i = 0; i < 8; ++i)
+    {
+      layer[NONCE_BYTES - 1 - i] = nonce >> (8 * i);
+    }
+  return crypto_aead_chacha20poly1305_ietf_encrypt_detached (
+             layer + LAYER_OVERHEAD, layer + NONCE_BYTES, NULL, layer + LAYER_OVERHEAD, innerLen,
+             ad, ID_BYTES, NULL, layer, key) == 0;
+}
+
+bool
+Circuit::OpenLayer (uint8_t *layer, uint16_t layerLen, const uint8_t *key, uint32_t id)
+{
+  if (layerLen < LAYER_OVERHEAD)
+    {
+      return false;
+    }
+  uint8_t ad[ID_BYTES];
+  WriteId (ad, id);
+  return crypto_aead_chacha20poly1305_ietf_decrypt_detached (
+             layer + LAYER_OVERHEAD, NULL, layer + LAYER_OVERHEAD, layerLen - LAYER_OVERHEAD,
+             layer + NONCE_BYTES, ad, ID_BYTES, layer, key) == 0;
+}
+
+CircuitTable::CircuitTable (uint16_t capacity) : m_capacity (capacity)
+{
+}
+
+void
+CircuitTable::SetCapacity (uint16_t capacity)
+{
+  m_capacity = capacity;
+  Evict ();
+}
+
+void
+CircuitTable::Add (uint32_t id, const CircuitHop &hop)
+{
+  if (m_hops.find (id) == m_hops.end ())
+    {
+      m_order.push_back (id);
+    }
+  m_hops[id] = hop;
+  Evict ();
+}
+
+const CircuitHop *
+CircuitTable::Find (uint32_t id) const
+{
+  std::map<uint32_t, CircuitHop>::const_iterator it = m_hops.find (id);
+  if (it == m_hops.end ())
+    {
+      return nullptr;
+    }
+  return &it->second;
+}
+
+uint32_t
+CircuitTable::GetSize () const
+{
+  return m_hops.size ();
+}
+
+void
+CircuitTable::Evict ()
+{
+  while (m_hops.size () > m_capacity)
+    {
+      m_hops.erase (m_order.front ());
+      m_order.pop_front ();
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,345 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef CIRCUIT_H
+#define CIRCUIT_H
+
+#include <sodium.h>
+
+#include <deque>
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+#include "ns3/nstime.h"
+#include "ns3/random-variable-stream.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup managers
+ * \struct CircuitHop
+ * \brief state of a circuit held by a sensor node, installed by the setup onion of the circuit
+ */
+
+struct CircuitHop
+{
+  uint32_t nextId; //!< circuit id of the next hop, written on the forwarded cells
+  uint32_t nextHop; //!< ipv4 address of the next hop
+  uint8_t key[crypto_aead_chacha20poly1305_ietf_KEYBYTES]; //!< key of the layers of this node
+};
+
+/**
+ * \ingroup managers
+ * \class Circuit
+ * \brief Circuit of the sink, a route of onions whose hops hold symmetric layer keys
+ *
+ * The sink builds the circuit with a public-key setup onion, each layer carries the circuit id of
+ * the hop, the circuit id of the next hop and the symmetric key of the hop. Later onions along the
+ * circuit are cells: the circuit id of the first hop followed by one ChaCha20-Poly1305 layer per
+ * hop, authenticated together with the circuit id of the hop. Each hop replaces the circuit id and
+ * removes its layer, so consecutive links of a cell carry unrelated ids.
+ *
+ * Ids and keys are drawn from a random variable of the simulation and nonces count the cells of
+ * the circuit, so circuits and cells are reproducible under the simulation seed.
+ *
+ * Cell of the setup onion: [SETUP_ID][onion head]
+ * Cell: [circuit id][nonce][mac][ciphertext of the inner layer]
+ */
+
+class Circuit
+{
+public:
+  static const uint16_t ID_BYTES = 4; //!< size in bytes of a circuit id, big endian
+  static const uint32_t SETUP_ID = 0; //!< circuit id of the cell carrying the setup onion
+  static const uint16_t KEY_BYTES =
+      crypto_aead_chacha20poly1305_ietf_KEYBYTES; //!< size in bytes of a layer key
+  static const uint16_t NONCE_BYTES =
+      crypto_aead_chacha20poly1305_ietf_NPUBBYTES; //!< size in bytes of a nonce
+  static const uint16_t LAYER_OVERHEAD =
+      NONCE_BYTES + crypto_aead_chacha20poly1305_ietf_ABYTES; //!< bytes added by each layer of a cell
+  static const uint16_t SETUP_CONTENT_BYTES =
+      2 * ID_BYTES + KEY_BYTES; //!< layer content of the setup onion: id, next id and key
+
+  /**
+  *
+  * \brief Default constructor, the circuit is not established
+  *
+  */
+  Circuit ();
+
+  /**
+  *
+  * \brief Draw new circuit ids and keys for each hop, the circuit is not established until
+  *        the setup onion returns to the sink. The setup onion counts as the first use.
+  *
+  * \param [in] hops number of hops of the circuit, sensor nodes and the sink
+  * \param [in] firstHop ipv4 address of the first hop
+  * \param [in] now creation time of the circuit
+  * \param [in] rng random variable drawing the ids and the keys
+  *
+  */
+  void Create (uint16_t hops, uint32_t firstHop, Time now, Ptr<UniformRandomVariable> rng);
+
+  /**
+  *
+  * \brief Write the content of the layers of the setup onion
+  *
+  * \param [out] content hops * SETUP_CONTENT_BYTES bytes, the content of hop i at offset i * SETUP_CONTENT_BYTES
+  *
+  */
+  void FillSetupContent (uint8_t *content) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the length in bytes of a cell of the circuit
+  *
+  */
+  uint16_t GetCellLength (void) const;
+
+  /**
+  *
+  * \brief Encrypt a new cell, from the layer of the sink outward, and count the use of the circuit
+  *
+  * \param [out] cell GetCellLength() bytes
+  *
+  * \return true on success, false if the encryption failed
+  *
+  */
+  bool BuildCell (uint8_t *cell);
+
+  /**
+  *
+  * \brief Authenticate the cell returned to the sink, the last hop of the circuit
+  *
+  * \param [in,out] cell the cell, decrypted in place
+  * \param [in] cellLen length in bytes of the cell
+  *
+  * \return true if the cell carries the circuit id and the layer of the sink
+  *
+  */
+  bool OpenCell (uint8_t *cell, uint16_t cellLen) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the number of hops, 0 if the circuit was never created
+  *
+  */
+  uint16_t GetHops (void) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the ipv4 address of the first hop
+  *
+  */
+  uint32_t GetFirstHop (void) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the number of onions sent along the circuit, the setup onion included
+  *
+  */
+  uint32_t GetUses (void) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the creation time of the circuit
+  *
+  */
+  Time GetCreationTime (void) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return true if the setup onion returned to the sink
+  *
+  */
+  bool IsEstablished (void) const;
+
+  /**
+  *
+  * \brief Set whether cells can be sent along the circuit
+  *
+  * \param [in] established true after the setup onion returned to the sink, false to discard the circuit
+  *
+  */
+  void SetEstablished (bool established);
+
+  /**
+  *
+  * \brief Write a circuit id in big endian
+  *
+  * \param [out] dest ID_BYTES bytes
+  * \param [in] id the circuit id
+  *
+  */
+  static void WriteId (uint8_t *dest, uint32_t id);
+
+  /**
+  *
+  * \brief Read a circuit id written by WriteId()
+  *
+  * \param [in] src ID_BYTES bytes
+  *
+  * \return the circuit id
+  *
+  */
+  static uint32_t ReadId (const uint8_t *src);
+
+  /**
+  *
+  * \brief Read the layer content of a setup onion
+  *
+  * \param [in] content SETUP_CONTENT_BYTES bytes
+  * \param [out] id the circuit id of the hop
+  * \param [out] hop the circuit id of the next hop and the key are set, the address is left untouched
+  *
+  */
+  static void ReadSetupContent (const uint8_t *content, uint32_t &id, CircuitHop &hop);
+
+  /**
+  *
+  * \brief Encrypt a layer in place, the plaintext is at \p layer + LAYER_OVERHEAD
+  *
+  * \param [in,out] layer LAYER_OVERHEAD + innerLen bytes, the nonce and the mac are written in front
+  * \param [in] innerLen length in bytes of the plaintext
+  * \param [in] key KEY_BYTES bytes
+  * \param [in] id the circuit id authenticated with the layer
+  * \param [in] nonce the nonce, never reused with \p key
+  *
+  * \return true on success
+  *
+  */
+  static bool SealLayer (uint8_t *layer, uint16_t innerLen, const uint8_t *key, uint32_t id,
+                         uint64_t nonce);
+
+  /**
+  *
+  * \brief Decrypt a layer in place, the plaintext is left at \p layer + LAYER_OVERHEAD
+  *
+  * \param [in,out] layer the layer
+  * \param [in] layerLen length in bytes of the layer, at least LAYER_OVERHEAD
+  * \param [in] key KEY_BYTES bytes
+  * \param [in] id the circuit id authenticated with the layer
+  *
+  * \return true if the layer is authentic
+  *
+  */
+  static bool OpenLayer (uint8_t *layer, uint16_t layerLen, const uint8_t *key, uint32_t id);
+
+private:
+  std::vector<uint32_t> m_ids; //!< circuit id of each hop, the sink last
+  std::vector<uint8_t> m_keys; //!< layer keys, KEY_BYTES bytes per hop
+  uint32_t m_firstHop; //!< ipv4 address of the first hop
+  uint32_t m_uses; //!< onions sent along the circuit
+  uint64_t m_nonce; //!< nonce of the next cell, each key seals one layer per cell
+  Time m_created; //!< creation time
+  bool m_established; //!< the setup onion returned to the sink
+};
+
+/**
+ * \ingroup managers
+ * \class CircuitTable
+ * \brief Circuits known by a sensor node, indexed by the circuit id of the node
+ *
+ * The oldest circuit is evicted when the capacity is reached, the sink rotates circuits.
+ */
+
+class CircuitTable
+{
+public:
+  /**
+  *
+  * \brief Constructor
+  *
+  * \param [in] capacity maximum number of circuits
+  *
+  */
+  CircuitTable (uint16_t capacity);
+
+  /**
+  *
+  * \brief Set the maximum number of circuits, the oldest circuits are evicted if needed
+  *
+  * \param [in] capacity maximum number of circuits
+  *
+  */
+  void SetCapacity (uint16_t capacity);
+
+  /**
+  *
+  * \brief Insert a circuit or replace the circuit with the same id
+  *
+  * \param [in] id the circuit id of the node
+  * \param [in] hop the state of the circuit
+  *
+  */
+  void Add (uint32_t id, const CircuitHop &hop);
+
+  /**
+  *
+  * \brief Look up a circuit
+  *
+  * \param [in] id the circuit id of the node
+  *
+  * \return the state of the circuit, nullptr if the circuit is unknown
+  *
+  */
+  const CircuitHop *Find (uint32_t id) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the number of circuits
+  *
+  */
+  uint32_t GetSize (void) const;
+
+private:
+  /**
+  *
+  * \brief Evict the oldest circuits until the capacity is respected
+  *
+  */
+  void Evict (void);
+
+  uint16_t m_capacity; //!< maximum number of circuits
+  std::map<uint32_t, CircuitHop> m_hops; //!< circuits by circuit id
+  std::deque<uint32_t> m_order; //!< circuit ids in the order of insertion
+};
+
+} // namespace ns3
+
+#endif /* CIRCUIT_H */
@@ -0,0 +1,130 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include "costmodelonionmanager.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("costmodelonionmanager");
+
+NS_OBJECT_ENSURE_REGISTERED (CostModelOnionManager);
+
+/**
+ * \brief Costs of the sealed box on a CPU profile, in nanoseconds
+ */
+struct CpuCost
+{
+  int64_t encryption; //!< crypto_box_seal, two X25519 scalar multiplications
+  int64_t decryption; //!< crypto_box_seal_open, one X25519 scalar multiplication
+  int64_t byte; //!< XSalsa20-Poly1305 per byte
+};
+
+//indexed by ns3::CpuProfile
+static const CpuCost g_cpuCosts[] = {
+    {1140000000, 570000000, 15600}, //MSP430 16MHz, ~9.1M cycles per X25519, ~250 cycles per byte
+    {28400000, 14200000, 470} //Cortex-M4 64MHz, ~0.9M cycles per X25519, ~30 cycles per byte
+};
+
+typedef OnionDummyCipher<crypto_box_SEALBYTES> CostModelCipher;
+
+TypeId
+CostModelOnionManager::GetTypeId (void)
+{
+  static TypeId tid =
+      TypeId ("ns3::CostModelOnionManager")
+          .SetParent<OnionManager> ()
+          .SetGroupName ("OnionRouting")
+          .AddAttribute ("CpuProfile", "CPU of the node, defines the cost of the encryption",
+                         EnumValue (CpuProfile::CortexM4),
+                         MakeEnumAccessor (&CostModelOnionManager::m_cpuProfile),
+                         MakeEnumChecker (CpuProfile::MSP430, "msp430", CpuProfile::CortexM4,
+                                          "cortexm4", CpuProfile::CustomCpu, "custom"))
+          .AddAttribute ("EncryptionDelay", "Cost of the encryption of a layer, custom CPU profile",
+                         TimeValue (MilliSeconds (28)),
+                         MakeTimeAccessor (&CostModelOnionManager::m_encryptionDelay),
+                         MakeTimeChecker ())
+          .AddAttribute ("DecryptionDelay", "Cost of the decryption of a layer, custom CPU profile",
+                         TimeValue (MilliSeconds (14)),
+                         MakeTimeAccessor (&CostModelOnionManager::m_decryptionDelay),
+                         MakeTimeChecker ())
+          .AddAttribute ("ByteDelay", "Cost of each encrypted or decrypted byte, custom CPU profile",
+                         TimeValue (NanoSeconds (470)),
+                         MakeTimeAccessor (&CostModelOnionManager::m_byteDelay),
+                         MakeTimeChecker ());
+  return tid;
+}
+
+CostModelOnionManager::CostModelOnionManager () : OnionManager ()
+{
+  m_processingDelay = Seconds (0);
+}
+
+CostModelOnionManager::~CostModelOnionManager ()
+{
+}
+
+Time
+CostModelOnionManager::EncryptionCost (uint32_t len) const
+{
+  if (m_cpuProfile == CpuProfile::CustomCpu)
+    {
+      return m_encryptionDelay + NanoSeconds (m_byteDelay.GetNanoSeconds () * len);
+    }
+  return NanoSeconds (g_cpuCosts[m_cpuProfile].encryption + g_cpuCosts[m_cpuProfile].byte * len);
+}
+
+Time
+CostModelOnionManager::DecryptionCost (uint32_t len) const
+{
+  if (m_cpuProfile == CpuProfile::CustomCpu)
+    {
+      return m_decryptionDelay + NanoSeconds (m_byteDelay.GetNanoSeconds () * len);
+    }
+  return NanoSeconds (g_cpuCosts[m_cpuProfile].decryption + g_cpuCosts[m_cpuProfile].byte * len);
+}
+
+bool
+CostModelOnionManager::EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
+                                     unsigned char *key) const
+{
+  m_processingDelay += EncryptionCost (len);
+  return CostModelCipher::Encrypt (ciphertext, message, len, key);
+}
+
+bool
+CostModelOnionManager::DecryptLayer (unsigned char *innerLayer, unsigned char *onion,
+                                     uint16_t onionLen, unsigned char *pk, unsigned char *sk) const
+{
+  m_processingDelay += DecryptionCost (onionLen);
+  return CostModelCipher::Decrypt (innerLayer, onion, onionLen, pk, sk);
+}
+
+Time
+CostModelOnionManager::TakeProcessingDelay ()
+{
+  Time delay = m_processingDelay;
+  m_processingDelay = Seconds (0);
+  return delay;
+}
+
+} // namespace ns3
@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef COSTMODELONIONMANAGER_H
+#define COSTMODELONIONMANAGER_H
+
+#include "ns3/onionmanager.h"
+#include "ns3/enums.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup managers
+ * \class CostModelOnionManager
+ * \brief Onion manager replacing the encryption with a cheap size-preserving transform, charging the processing time in simulated time
+ *
+ * Layers have the size of sealed boxes, the first 4 bytes of the public key of the recipient are stored in front of the layer,
+ * as in ns3::OnionRoutingDummyEncryption, and checked at decryption.
+ * Each encryption and decryption adds to the processing delay a cost per operation and a cost per byte,
+ * given by the ns3::CpuProfile of the node. Nodes defer sending the onion by the delay returned by TakeProcessingDelay().
+ */
+
+class CostModelOnionManager : public OnionManager
+{
+public:
+  /**
+ *  Register this type.
+ *  \return The object TypeId.
+ */
+  static TypeId GetTypeId (void);
+
+  /**
+  *
+  * \brief Default constructor
+  *
+  */
+  CostModelOnionManager ();
+
+  /**
+  *
+  * \brief Default destructor
+  *
+  */
+  ~CostModelOnionManager ();
+
+  /**
+*
+* \brief Size-preserving dummy encryption, charge the cost of the encryption
+* 
+*   \param [in,out] ciphertext memory on which the ciphertext will be stored
+*   \param [in] message memory locations containing the data to be encrypted
+*   \param [in] len length in bytes of the \p message 
+*   \param [in] key pointer to the public key of the recipient
+*   \return true on success
+*
+*/
+
+  virtual bool EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
+                             unsigned char *key) const;
+
+  /**
+*
+* \brief Size-preserving dummy decryption, charge the cost of the decryption
+* 
+*   \param [in,out] innerLayer memory on which the inner onion layer will be stored
+*   \param [in] onion memory locations containing the data to be decrypted
+*   \param [in] onionLen length in bytes of the \p onion 
+*   \param [in] pk pointer to the public key of the node
+*   \param [in] sk not used
+*   \return true on success, false if the layer is not addressed to the node
+*
+*/
+
+  virtual bool DecryptLayer (unsigned char *innerLayer, unsigned char *onion, uint16_t onionLen,
+                             unsigned char *pk, unsigned char *sk) const;
+
+  /**
+  *
+  * \brief Return the processing delay charged since the last call, and reset it
+  *
+  * \return the processing delay
+  *
+  */
+  virtual Time TakeProcessingDelay (void);
+
+  /**
+  *
+  * \brief Cost of the encryption of a layer under the configured ns3::CpuProfile
+  *
+  * \param [in] len length in bytes of the plaintext
+  *
+  * \return the processing time
+  *
+  */
+  Time EncryptionCost (uint32_t len) const;
+
+  /**
+  *
+  * \brief Cost of the decryption of a layer under the configured ns3::CpuProfile
+  *
+  * \param [in] len length in bytes of the ciphertext
+  *
+  * \return the processing time
+  *
+  */
+  Time DecryptionCost (uint32_t len) const;
+
+private:
+  enum CpuProfile m_cpuProfile; //!< CPU of the node
+  Time m_encryptionDelay; //!< cost of an encryption with the CpuProfile::CustomCpu
+  Time m_decryptionDelay; //!< cost of a decryption with the CpuProfile::CustomCpu
+  Time m_byteDelay; //!< cost of each encrypted or decrypted byte with the CpuProfile::CustomCpu
+  mutable Time m_processingDelay; //!< processing delay charged since the last TakeProcessingDelay()
+};
+
+} // namespace ns3
+
+#endif /* COSTMODELONIONMANAGER_H */
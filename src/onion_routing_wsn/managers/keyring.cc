@@ -0,0 +1,82 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include "keyring.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace ns3 {
+
+KeyRing::KeyRing (const NodeIdTable &nodeIds, uint16_t keySize)
+    : m_nodeIds (nodeIds), m_keySize (keySize)
+{
+}
+
+void
+KeyRing::SetKey (Ipv4Address address, const std::string &key)
+{
+  NS_ASSERT_MSG (key.size () == m_keySize, "Layer key of unexpected size");
+
+  uint32_t ip = address.Get ();
+  std::vector<uint32_t>::iterator it = std::lower_bound (m_ips.begin (), m_ips.end (), ip);
+  uint32_t id = it - m_ips.begin ();
+
+  //a new node shifts the slots of nodes with a higher address, only at the handshake
+  if (it == m_ips.end () || *it != ip)
+    {
+      m_ips.insert (it, ip);
+      uint16_t addressSize = m_nodeIds.GetAddressSize ();
+      m_addresses.insert (m_addresses.begin () + id * addressSize, addressSize, 0);
+      m_keys.insert (m_keys.begin () + id * m_keySize, m_keySize, 0);
+      m_nodeIds.Encode (address, &m_addresses[id * addressSize]);
+    }
+
+  memcpy (&m_keys[id * m_keySize], key.data (), m_keySize);
+}
+
+uint32_t
+KeyRing::GetSize () const
+{
+  return m_ips.size ();
+}
+
+Ipv4Address
+KeyRing::GetAddress (uint32_t id) const
+{
+  return Ipv4Address (m_ips[id]);
+}
+
+const uint8_t *
+KeyRing::GetSerializedAddress (uint32_t id) const
+{
+  return &m_addresses[id * m_nodeIds.GetAddressSize ()];
+}
+
+const uint8_t *
+KeyRing::GetKey (uint32_t id) const
+{
+  return &m_keys[id * m_keySize];
+}
+
+} // namespace ns3
@@ -0,0 +1,122 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef KEYRING_H
+#define KEYRING_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ns3/internet-module.h"
+#include "ns3/nodeidtable.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup managers
+ * \class KeyRing
+ * \brief Layer keys of sensor nodes held by the sink, indexed by node id
+ *
+ * Nodes are kept ordered by IP address, so the id of a node is its index in the
+ * std::map of nodes of the sink, as drawn by ns3::Sink::SelectRoute().
+ * Addresses, encoded as carried in onion layers, and keys are stored in contiguous fixed-width
+ * slots, copied into an ns3::OnionRouteDescriptor without allocating memory.
+ */
+
+class KeyRing
+{
+public:
+  /**
+  *
+  * \brief Constructor
+  *
+  * \param [in] nodeIds encoding of the addresses of nodes
+  * \param [in] keySize size in bytes of each layer key
+  *
+  */
+  KeyRing (const NodeIdTable &nodeIds, uint16_t keySize);
+
+  /**
+  *
+  * \brief Insert the node or replace its key, keeping nodes ordered by IP address
+  *
+  * \param [in] address the ipv4 address of the node
+  * \param [in] key the layer key of the node, of keySize bytes
+  *
+  */
+  void SetKey (Ipv4Address address, const std::string &key);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the number of nodes
+  *
+  */
+  uint32_t GetSize (void) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \param [in] id the node id
+  *
+  * \return the ipv4 address of the node
+  *
+  */
+  Ipv4Address GetAddress (uint32_t id) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \param [in] id the node id
+  *
+  * \return the pointer to the encoded address of the node, as carried in onion layers
+  *
+  */
+  const uint8_t *GetSerializedAddress (uint32_t id) const;
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \param [in] id the node id
+  *
+  * \return the pointer to the keySize bytes of the layer key of the node
+  *
+  */
+  const uint8_t *GetKey (uint32_t id) const;
+
+private:
+  NodeIdTable m_nodeIds; //!< encoding of addresses
+  uint16_t m_keySize; //!< size in bytes of a key slot
+  std::vector<uint32_t> m_ips; //!< ipv4 addresses of nodes in ascending order
+  std::vector<uint8_t> m_addresses; //!< encoded addresses, NodeIdTable::GetAddressSize() bytes per node
+  std::vector<uint8_t> m_keys; //!< layer keys, m_keySize bytes per node
+};
+
+} // namespace ns3
+
+#endif /* KEYRING_H */
@@ -0,0 +1,82 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include "nodeidtable.h"
+
+namespace ns3 {
+
+NodeIdTable::NodeIdTable () : m_addressSize (ONION_IPV4), m_network (0), m_hostMask (0xffffffff)
+{
+}
+
+NodeIdTable::NodeIdTable (enum OnionAddressFamily family, Ipv4Address address, Ipv4Mask mask)
+    : m_addressSize (family),
+      m_network (address.CombineMask (mask).Get ()),
+      m_hostMask (~mask.Get ())
+{
+  NS_ASSERT_MSG (family != ONION_IPV6, "IPv6 addresses are not supported by the WSN");
+}
+
+uint16_t
+NodeIdTable::GetAddressSize () const
+{
+  return m_addressSize;
+}
+
+void
+NodeIdTable::Encode (Ipv4Address address, uint8_t *buffer) const
+{
+  if (m_addressSize == ONION_IPV4)
+    {
+      address.Serialize (buffer);
+      return;
+    }
+
+  uint32_t id = address.Get () & m_hostMask;
+  NS_ASSERT_MSG (id >> (8 * m_addressSize) == 0, "Node id of " << address << " does not fit");
+
+  //big-endian, as serialized addresses
+  for (int i = m_addressSize - 1; i >= 0; --i)
+    {
+      buffer[i] = id & 0xff;
+      id >>= 8;
+    }
+}
+
+Ipv4Address
+NodeIdTable::Decode (const uint8_t *buffer) const
+{
+  if (m_addressSize == ONION_IPV4)
+    {
+      return Ipv4Address::Deserialize (buffer);
+    }
+
+  uint32_t id = 0;
+  for (int i = 0; i < m_addressSize; ++i)
+    {
+      id = (id << 8) | buffer[i];
+    }
+  return (id == 0) ? Ipv4Address ((uint32_t) 0) : Ipv4Address (m_network | id);
+}
+
+} // namespace ns3
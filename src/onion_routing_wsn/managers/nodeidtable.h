@@ -0,0 +1,104 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef NODEIDTABLE_H
+#define NODEIDTABLE_H
+
+#include <stdint.h>
+
+#include "ns3/internet-module.h"
+#include "ns3/onion-routing.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup managers
+ * \class NodeIdTable
+ * \brief Encoding of next hop addresses carried in onion layers
+ *
+ * With ONION_IPV4 the address is carried in full. With the compact ONION_NODEID8 and
+ * ONION_NODEID16 encodings the id of a node is the host part of its address in the WSN subnet,
+ * so every node resolves ids from its own interface address without exchanging the table.
+ * The id 0 is the zero address, marking the inner layer of onions with content.
+ */
+
+class NodeIdTable
+{
+public:
+  /**
+  *
+  * \brief Default constructor, addresses are carried in full
+  *
+  */
+  NodeIdTable ();
+
+  /**
+  *
+  * \brief Constructor
+  *
+  * \param [in] family encoding of addresses, ONION_IPV6 is not supported by the WSN
+  * \param [in] address an address of the WSN subnet
+  * \param [in] mask the mask of the WSN subnet
+  *
+  */
+  NodeIdTable (enum OnionAddressFamily family, Ipv4Address address, Ipv4Mask mask);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return size in bytes of an encoded address
+  *
+  */
+  uint16_t GetAddressSize (void) const;
+
+  /**
+  *
+  * \brief Encode the address of a node, the host part must fit in the node id
+  *
+  * \param [in] address the ipv4 address of the node, or the zero address
+  * \param [out] buffer the encoded address, GetAddressSize() bytes
+  *
+  */
+  void Encode (Ipv4Address address, uint8_t *buffer) const;
+
+  /**
+  *
+  * \brief Decode the address of a node
+  *
+  * \param [in] buffer the encoded address, GetAddressSize() bytes
+  *
+  * \return the ipv4 address of the node, or the zero address
+  *
+  */
+  Ipv4Address Decode (const uint8_t *buffer) const;
+
+private:
+  uint16_t m_addressSize; //!< size in bytes of an encoded address
+  uint32_t m_network; //!< network part of the WSN subnet
+  uint32_t m_hostMask; //!< host part of addresses in the WSN subnet
+};
+
+} // namespace ns3
+
+#endif /* NODEIDTABLE_H */
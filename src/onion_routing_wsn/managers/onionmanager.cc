@@ -25,6 +25,8 @@
 
 namespace ns3 {
 
+NS_LOG_COMPONENT_DEFINE ("onionmanager");
+
 /* ... */
 
 //Zagotovi, da se registrira TypeId
@@ -40,6 +42,20 @@ OnionManager::GetTypeId (void)
 
 OnionManager::OnionManager () : OnionRouting (crypto_box_SEALBYTES, Ipv4L3Protocol::PROT_NUMBER)
 {
+  //required before libsodium is used from multiple threads
+  if (sodium_init () < 0)
+    {
+      NS_FATAL_ERROR ("Unable to initialize libsodium");
+    }
+}
+
+OnionManager::OnionManager (uint16_t sealPadding)
+    : OnionRouting (sealPadding, Ipv4L3Protocol::PROT_NUMBER)
+{
+  if (sodium_init () < 0)
+    {
+      NS_FATAL_ERROR ("Unable to initialize libsodium");
+    }
 }
 
 OnionManager::~OnionManager ()
@@ -51,24 +67,23 @@ OnionManager::~OnionManager ()
  * 
  * */
 
-void
+bool
 OnionManager::EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
                             unsigned char *key) const
 {
-  if (crypto_box_seal (ciphertext, message, len, key) != 0)
+  if (!SealedBoxCipher::Encrypt (ciphertext, message, len, key))
     {
-      std::cout << "Error during encryption" << std::endl;
+      NS_LOG_ERROR ("Error during encryption");
+      return false;
     }
+  return true;
 }
 
-void
+bool
 OnionManager::DecryptLayer (unsigned char *innerLayer, unsigned char *onion, uint16_t onionLen,
                             unsigned char *pk, unsigned char *sk) const
 {
-  if (crypto_box_seal_open (innerLayer, onion, onionLen, pk, sk) != 0)
-    {
-      std::cout << "messge corrupted or not for this node" << std::endl;
-    }
+  return SealedBoxCipher::Decrypt (innerLayer, onion, onionLen, pk, sk);
 }
 
 /** handling encryption keys
@@ -83,6 +98,12 @@ OnionManager::GenerateNewKeyPair ()
   crypto_box_keypair (m_publickey, m_secretkey);
 }
 
+void
+OnionManager::GenerateKeyPairFromSeed (const unsigned char *seed)
+{
+  crypto_box_seed_keypair (m_publickey, m_secretkey, seed);
+}
+
 //return public key
 unsigned char *
 OnionManager::GetPK ()
@@ -114,6 +135,44 @@ OnionManager::GetSKtoString ()
   return strForm;
 }
 
+//the sealed box encrypts with the public key of the node
+std::string
+OnionManager::LayerKey (const std::string &publicKey)
+{
+  if (publicKey.size () != crypto_box_PUBLICKEYBYTES)
+    {
+      return std::string ();
+    }
+  return publicKey;
+}
+
+//nothing to precompute for the sealed box
+bool
+OnionManager::SetPeerPublicKey (const std::string &publicKey)
+{
+  return true;
+}
+
+//the sealed box decrypts with the secret key
+unsigned char *
+OnionManager::GetDecryptionKey ()
+{
+  return m_secretkey;
+}
+
+uint16_t
+OnionManager::GetLayerOverhead () const
+{
+  return m_sealPadding;
+}
+
+//real encryption does not advance the simulated time
+Time
+OnionManager::TakeProcessingDelay ()
+{
+  return Seconds (0);
+}
+
 //set public key
 void
 OnionManager::SetPK (unsigned char *pk)
@@ -133,15 +192,6 @@ OnionManager::SetSK (unsigned char *sk)
  * 
  * */
 
-//Convert string to unsigned char *
-unsigned char *
-OnionManager::StringToUchar (std::string in)
-{
-  unsigned char *out = new unsigned char[in.length ()];
-  memcpy (&out[0], &in[0], in.length ());
-  return out;
-}
-
 //convert unsigned char to string
 std::string
 OnionManager::UcharToString (unsigned char *seq, int len)
@@ -150,13 +200,4 @@ OnionManager::UcharToString (unsigned char *seq, int len)
   return strForm;
 }
 
-//Convert ip to unsigned char *
-unsigned char *
-OnionManager::IpToBuff (uint32_t in)
-{
-  unsigned char *out = new unsigned char[4];
-  Ipv4Address (in).Serialize (&out[0]);
-  return out;
-}
-
 } // namespace ns3
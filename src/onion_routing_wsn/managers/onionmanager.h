@@ -31,10 +31,48 @@
 #include <stdio.h>
 
 #include "ns3/onion-routing.h"
+#include "ns3/onion-routing-static.h"
 #include "ns3/internet-module.h"
 
 namespace ns3 {
 
+/**
+ * \ingroup managers
+ * \class SealedBoxCipher
+ * \brief Cipher policy of ns3::OnionRoutingStatic, encryption of layers with libsodium sealed boxes
+ */
+
+class SealedBoxCipher
+{
+public:
+  /**
+  * \brief Encrypt with crypto_box_seal
+  * \return true on success
+  */
+  static bool
+  Encrypt (unsigned char *ciphertext, unsigned char *message, int len, unsigned char *key)
+  {
+    return crypto_box_seal (ciphertext, message, len, key) == 0;
+  }
+
+  /**
+  * \brief Decrypt with crypto_box_seal_open
+  * \return true on success
+  */
+  static bool
+  Decrypt (unsigned char *innerLayer, unsigned char *onion, uint16_t onionLen, unsigned char *pk,
+           unsigned char *sk)
+  {
+    return crypto_box_seal_open (innerLayer, onion, onionLen, pk, sk) == 0;
+  }
+};
+
+/**
+ * \ingroup managers
+ * \brief OnionRouting over IPv4 with sealed boxes, specialized at compile time
+ */
+typedef OnionRoutingStatic<ONION_IPV4, crypto_box_SEALBYTES, SealedBoxCipher> SealedBoxOnionRouting;
+
 /**
  * \ingroup managers
  * \class OnionManager
@@ -47,6 +85,11 @@ namespace ns3 {
 class OnionManager : public OnionRouting
 {
 public:
+  static const uint16_t LAYER_KEY_BYTES =
+      crypto_box_PUBLICKEYBYTES; //!< size of the keys returned by LayerKey() in all onion modes
+  static const uint16_t KEY_SEED_BYTES =
+      crypto_box_SEEDBYTES; //!< size of the seed of GenerateKeyPairFromSeed() in all onion modes
+
   /**
  *  Register this type.
  *  \return The object TypeId.
@@ -67,6 +110,58 @@ public:
   */
   ~OnionManager ();
 
+  /**
+  *
+  * \brief Compute the key used to encrypt layers addressed to the node owning \p publicKey
+  *        The sealed box encrypts layers with the public key of the node
+  *
+  * \param [in] publicKey the public key of the node given as a string
+  *
+  * \return the layer key as a string, empty if \p publicKey is not a valid public key
+  *
+  */
+  virtual std::string LayerKey (const std::string &publicKey);
+
+  /**
+  *
+  * \brief Register the public key of the peer node, the sink node for sensor nodes
+  *        Not used by the sealed box
+  *
+  * \param [in] publicKey the public key of the peer given as a string
+  *
+  * \return true on success, false if \p publicKey is not a valid public key
+  *
+  */
+  virtual bool SetPeerPublicKey (const std::string &publicKey);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return Return the pointer to the key used to decrypt layers, the secret key for the sealed box
+  *
+  */
+  virtual unsigned char *GetDecryptionKey (void);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return Return the size increase in bytes of each layer, crypto_box_SEALBYTES for the sealed box
+  *
+  */
+  uint16_t GetLayerOverhead (void) const;
+
+  /**
+  *
+  * \brief Return the simulated processing time of the encryption charged since the last call, and reset it
+  *        The encryption of the sealed box takes no simulated time
+  *
+  * \return the processing delay
+  *
+  */
+  virtual Time TakeProcessingDelay (void);
+
   /**
 *
 * \brief Implementing encryption using the libsodium library
@@ -75,11 +170,11 @@ public:
 *   \param [in] mesage memory locations containing the data to be encrypted
 *   \param [in] len length in bytes of the \p plaintext 
 *   \param [in] key pointer to the encryption key 
-*
+*   \return true on success
 *
 */
 
-  virtual void EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
+  virtual bool EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
                              unsigned char *key) const;
 
   /**
@@ -91,10 +186,11 @@ public:
 *   \param [in] len length in bytes of the \p onion 
 *   \param [in] pk pointer to the public encryption key 
 *   \param [in] sk pointer to the secret encryption key 
+*   \return true on success, false if the layer is corrupted or not addressed to the node
 *
 */
 
-  virtual void DecryptLayer (unsigned char *innerLayer, unsigned char *onion, uint16_t onionLen,
+  virtual bool DecryptLayer (unsigned char *innerLayer, unsigned char *onion, uint16_t onionLen,
                              unsigned char *pk, unsigned char *sk) const;
 
   /**
@@ -102,7 +198,16 @@ public:
   * \brief Generate a new public/private keypair using the libsodium library
   *
   */
-  void GenerateNewKeyPair (void);
+  virtual void GenerateNewKeyPair (void);
+
+  /**
+  *
+  * \brief Derive the public/private keypair from \p seed, the same seed gives the same keypair
+  *
+  * \param [in] seed KEY_SEED_BYTES bytes of seed
+  *
+  */
+  virtual void GenerateKeyPairFromSeed (const unsigned char *seed);
   /**
   *
   * \brief accessor
@@ -154,16 +259,6 @@ public:
   */
   void SetSK (unsigned char *sk);
 
-  /**
-  *
-  * \brief Convert a string to an array of unsigned chars
-  * 
-  * \param [in] in a std::string
-  * 
-  * \return the pointer to the array of unsigned chars
-  *
-  */
-  unsigned char *StringToUchar (std::string in);
   /**
   *
   * \brief Convert an array of unsigned chars to a std::string
@@ -176,16 +271,15 @@ public:
   */
   std::string UcharToString (unsigned char *seq, int len);
 
+protected:
   /**
   *
-  * \brief Convert an Ipv4 address given as an unsigned integer value to buffer array of 4Bytes
-  * 
-  * \param [in] in an Ipv4 address given as an unsigned integer value
-  * 
-  * \return the pointer to the array of 4Bytes
+  * \brief Constructor for subclasses encrypting layers with a different method
+  *
+  * \param [in] sealPadding size increase of the ciphertext in bytes, introduced by the encryption method
   *
   */
-  unsigned char *IpToBuff (uint32_t in);
+  OnionManager (uint16_t sealPadding);
 
 private:
   unsigned char m_publickey[crypto_box_PUBLICKEYBYTES]; //!< the public encryption key
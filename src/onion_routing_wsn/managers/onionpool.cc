@@ -0,0 +1,186 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include "onionpool.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+PooledOnion::PooledOnion (uint16_t addressSize, uint16_t keySize)
+    : route (addressSize, keySize),
+      firstHop (0),
+      status (OnionRouting::ERROR_NOTERROR),
+      claimed (false),
+      done (false)
+{
+}
+
+OnionPool::OnionPool () : m_builder (nullptr), m_threads (1), m_stop (false)
+{
+}
+
+OnionPool::~OnionPool ()
+{
+  Stop ();
+}
+
+void
+OnionPool::Start (const OnionRouting *builder, uint16_t pools, uint16_t threads)
+{
+  Stop ();
+  m_builder = builder;
+  m_threads = threads;
+  m_pools.assign (pools, std::deque<std::shared_ptr<PooledOnion>> ());
+  m_stop = false;
+  m_worker = std::thread (&OnionPool::Work, this);
+}
+
+void
+OnionPool::Stop ()
+{
+  if (!m_worker.joinable ())
+    {
+      return;
+    }
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_stop = true;
+    m_queue.clear ();
+  }
+  m_submitted.notify_one ();
+  //the worker completes its batch before exiting, nobody waits on the queued onions
+  m_worker.join ();
+  m_pools.clear ();
+}
+
+bool
+OnionPool::IsRunning () const
+{
+  return m_worker.joinable ();
+}
+
+void
+OnionPool::Submit (uint16_t pool, std::shared_ptr<PooledOnion> onion)
+{
+  m_pools[pool].push_back (onion);
+  {
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_queue.push_back (onion);
+  }
+  m_submitted.notify_one ();
+}
+
+std::shared_ptr<PooledOnion>
+OnionPool::Take (uint16_t pool)
+{
+  std::shared_ptr<PooledOnion> onion = m_pools[pool].front ();
+  m_pools[pool].pop_front ();
+
+  std::unique_lock<std::mutex> lock (m_mutex);
+  if (onion->claimed)
+    {
+      //the batch of the onion is under construction and completes in bounded time
+      m_built.wait (lock, [&onion] () { return onion->done; });
+      return onion;
+    }
+
+  //the worker did not reach the onion, build it here
+  onion->claimed = true;
+  m_queue.erase (std::find (m_queue.begin (), m_queue.end (), onion));
+  lock.unlock ();
+
+  OnionRouting::OnionErrno status = m_builder->BuildOnion (Request (*onion));
+
+  lock.lock ();
+  onion->status = status;
+  onion->done = true;
+  return onion;
+}
+
+uint32_t
+OnionPool::GetPending (uint16_t pool) const
+{
+  return m_pools[pool].size ();
+}
+
+void
+OnionPool::Work ()
+{
+  std::vector<std::shared_ptr<PooledOnion>> batch;
+  std::vector<orOnionRequest> requests;
+  std::vector<OnionRouting::OnionErrno> status;
+
+  std::unique_lock<std::mutex> lock (m_mutex);
+  while (true)
+    {
+      m_submitted.wait (lock, [this] () { return m_stop || !m_queue.empty (); });
+      if (m_stop)
+        {
+          return;
+        }
+
+      //claim every onion submitted so far, the simulation thread does not touch them until done
+      batch.assign (m_queue.begin (), m_queue.end ());
+      m_queue.clear ();
+      for (std::shared_ptr<PooledOnion> &onion : batch)
+        {
+          onion->claimed = true;
+        }
+      lock.unlock ();
+
+      requests.clear ();
+      for (std::shared_ptr<PooledOnion> &onion : batch)
+        {
+          requests.push_back (Request (*onion));
+        }
+      status.assign (batch.size (), OnionRouting::ERROR_NOTERROR);
+      m_builder->BuildOnions (&requests[0], &status[0], batch.size (), m_threads);
+
+      lock.lock ();
+      for (uint32_t i = 0; i < batch.size (); ++i)
+        {
+          batch[i]->status = status[i];
+          batch[i]->done = true;
+        }
+      batch.clear ();
+      m_built.notify_all ();
+    }
+}
+
+orOnionRequest
+OnionPool::Request (PooledOnion &onion)
+{
+  orOnionRequest request;
+  request.cipher = (uint8_t *) &onion.cipher[0];
+  request.route = onion.route.GetRoute ();
+  request.keys = onion.route.GetKeys ();
+  request.routeLen = onion.route.GetRouteLen ();
+  request.layerContent = nullptr;
+  request.layerContentLen = 0;
+  request.endContent = nullptr;
+  request.endContentLen = 0;
+  return request;
+}
+
+} // namespace ns3
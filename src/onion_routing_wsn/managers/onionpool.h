@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef ONIONPOOL_H
+#define ONIONPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ns3/onion-routing.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup managers
+ * \struct PooledOnion
+ * \brief onion head built in the background by ns3::OnionPool
+ */
+
+struct PooledOnion
+{
+  PooledOnion (uint16_t addressSize, uint16_t keySize);
+
+  OnionRouteDescriptor route; //!< route and keys of the onion, filled before the submission
+  uint32_t firstHop; //!< ipv4 address of the first hop
+  std::string cipher; //!< the onion head, OnionLength() bytes set before the submission
+  OnionRouting::OnionErrno status; //!< result of the construction
+  bool claimed; //!< the construction was started by the worker or by Take(), guarded by the mutex of the pool
+  bool done; //!< the construction is completed, guarded by the mutex of the pool
+};
+
+/**
+ * \ingroup managers
+ * \class OnionPool
+ * \brief Bounded pools of onion heads built by background threads
+ *
+ * The sink fills the route of each onion on the simulation thread and submits it to the pool of
+ * a path length. The worker takes all the onions submitted so far as a batch and builds them with
+ * ns3::OnionRouting::BuildOnions() on several threads.
+ * Onions are taken from a pool in the order of submission. If the oldest one is still queued,
+ * Take() builds it on the simulation thread instead of waiting for the worker, it waits only for
+ * an onion whose batch is under construction. The sequence of onions depends only on the order of
+ * submissions and is deterministic under the simulation seed.
+ */
+
+class OnionPool
+{
+public:
+  /**
+  *
+  * \brief Default constructor
+  *
+  */
+  OnionPool ();
+
+  /**
+  *
+  * \brief Default destructor, stop the worker
+  *
+  */
+  ~OnionPool ();
+
+  /**
+  *
+  * \brief Start the worker
+  *
+  * \param [in] builder the object encrypting the layers, its reentrant BuildOnion() must be thread-safe
+  * \param [in] pools the number of pools, one for each path length
+  * \param [in] threads the number of threads building a batch, 0 for the hardware concurrency
+  *
+  */
+  void Start (const OnionRouting *builder, uint16_t pools, uint16_t threads);
+
+  /**
+  *
+  * \brief Stop the worker once the batch under construction is built, onions not taken are discarded
+  *
+  */
+  void Stop (void);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return true if the worker is running
+  *
+  */
+  bool IsRunning (void) const;
+
+  /**
+  *
+  * \brief Submit the construction of \p onion to the pool \p pool
+  *
+  * \param [in] pool index of the pool
+  * \param [in] onion the onion with the route and the size of the cipher set
+  *
+  */
+  void Submit (uint16_t pool, std::shared_ptr<PooledOnion> onion);
+
+  /**
+  *
+  * \brief Take the oldest onion of the pool \p pool, build it if the worker did not start it
+  *
+  * \param [in] pool index of the pool, must not be empty
+  *
+  * \return the onion
+  *
+  */
+  std::shared_ptr<PooledOnion> Take (uint16_t pool);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \param [in] pool index of the pool
+  *
+  * \return the number of onions submitted to the pool and not yet taken
+  *
+  */
+  uint32_t GetPending (uint16_t pool) const;
+
+private:
+  /**
+  *
+  * \brief Loop of the worker thread, build the submitted onions in batches
+  *
+  */
+  void Work (void);
+
+  /**
+  *
+  * \brief Describe the construction of \p onion
+  *
+  * \param [in] onion the onion to build
+  *
+  * \return the request of ns3::OnionRouting::BuildOnion()
+  *
+  */
+  static orOnionRequest Request (PooledOnion &onion);
+
+  const OnionRouting *m_builder; //!< encrypts the layers
+  uint16_t m_threads; //!< threads building a batch
+  std::vector<std::deque<std::shared_ptr<PooledOnion>>>
+      m_pools; //!< onions of each path length, accessed only by the simulation thread
+  std::deque<std::shared_ptr<PooledOnion>> m_queue; //!< onions to build, guarded by \p m_mutex
+  std::mutex m_mutex; //!< guards \p m_queue, PooledOnion::claimed, PooledOnion::done and \p m_stop
+  std::condition_variable m_submitted; //!< signals a new onion in \p m_queue
+  std::condition_variable m_built; //!< signals a completed batch
+  std::thread m_worker; //!< the background worker
+  bool m_stop; //!< the worker must exit
+};
+
+} // namespace ns3
+
+#endif /* ONIONPOOL_H */
@@ -0,0 +1,154 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include "onionstream.h"
+
+namespace ns3 {
+
+OnionStreamSender::OnionStreamSender () : m_routeLen (0)
+{
+}
+
+OnionStreamSender::~OnionStreamSender ()
+{
+  if (!m_layerContent.empty ())
+    {
+      sodium_memzero (m_layerContent.data (), m_layerContent.size ());
+    }
+  if (!m_states.empty ())
+    {
+      sodium_memzero (m_states.data (), m_states.size () * sizeof (m_states[0]));
+    }
+}
+
+void
+OnionStreamSender::Init (uint16_t routeLen)
+{
+  m_routeLen = routeLen;
+  m_states.resize (routeLen);
+  m_layerContent.resize (routeLen * LAYER_CONTENT_BYTES);
+  m_layerContentPtr.resize (routeLen);
+
+  for (uint16_t i = 0; i < routeLen; ++i)
+    {
+      uint8_t *key = &m_layerContent[i * LAYER_CONTENT_BYTES];
+      uint8_t *header = key + KEY_BYTES;
+      crypto_secretstream_xchacha20poly1305_keygen (key);
+      crypto_secretstream_xchacha20poly1305_init_push (&m_states[i], header, key);
+      m_layerContentPtr[i] = key;
+    }
+}
+
+uint8_t **
+OnionStreamSender::GetLayerContent ()
+{
+  return m_layerContentPtr.data ();
+}
+
+uint32_t
+OnionStreamSender::EncryptedChunkLength (uint32_t chunkLen) const
+{
+  return chunkLen + m_routeLen * CHUNK_OVERHEAD;
+}
+
+bool
+OnionStreamSender::EncryptChunk (uint8_t *ciphertext, const uint8_t *chunk, uint32_t chunkLen,
+                                 bool last)
+{
+  if (m_routeLen == 0)
+    {
+      return false;
+    }
+  if (m_scratch.size () < EncryptedChunkLength (chunkLen))
+    {
+      m_scratch.resize (EncryptedChunkLength (chunkLen));
+    }
+
+  uint8_t tag = last ? crypto_secretstream_xchacha20poly1305_TAG_FINAL
+                     : crypto_secretstream_xchacha20poly1305_TAG_MESSAGE;
+
+  //the last hop encrypts first, alternate the buffers so that the first hop writes to ciphertext
+  const uint8_t *in = chunk;
+  unsigned long long inLen = chunkLen;
+  for (int i = m_routeLen - 1; i >= 0; --i)
+    {
+      uint8_t *out = (i % 2 == 0) ? ciphertext : m_scratch.data ();
+      unsigned long long outLen;
+      if (crypto_secretstream_xchacha20poly1305_push (&m_states[i], out, &outLen, in, inLen,
+                                                      NULL, 0, tag) != 0)
+        {
+          return false;
+        }
+      in = out;
+      inLen = outLen;
+    }
+  return true;
+}
+
+OnionStreamReceiver::OnionStreamReceiver () : m_finished (false)
+{
+}
+
+OnionStreamReceiver::~OnionStreamReceiver ()
+{
+  sodium_memzero (&m_state, sizeof (m_state));
+}
+
+bool
+OnionStreamReceiver::Init (const uint8_t *layerContent)
+{
+  m_finished = false;
+  const uint8_t *key = layerContent;
+  const uint8_t *header = layerContent + OnionStreamSender::KEY_BYTES;
+  return crypto_secretstream_xchacha20poly1305_init_pull (&m_state, header, key) == 0;
+}
+
+bool
+OnionStreamReceiver::DecryptChunk (uint8_t *chunk, const uint8_t *ciphertext,
+                                   uint32_t ciphertextLen, bool *last)
+{
+  if (m_finished || ciphertextLen < OnionStreamSender::CHUNK_OVERHEAD)
+    {
+      return false;
+    }
+
+  unsigned long long chunkLen;
+  uint8_t tag;
+  if (crypto_secretstream_xchacha20poly1305_pull (&m_state, chunk, &chunkLen, &tag, ciphertext,
+                                                  ciphertextLen, NULL, 0) != 0)
+    {
+      return false;
+    }
+
+  m_finished = (tag == crypto_secretstream_xchacha20poly1305_TAG_FINAL);
+  *last = m_finished;
+  return true;
+}
+
+bool
+OnionStreamReceiver::IsFinished () const
+{
+  return m_finished;
+}
+
+} // namespace ns3
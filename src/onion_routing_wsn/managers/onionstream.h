@@ -0,0 +1,197 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef ONIONSTREAM_H
+#define ONIONSTREAM_H
+
+#include <stdint.h>
+#include <vector>
+#include <sodium.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup managers
+ * \class OnionStreamSender
+ * \brief Layered encryption of a large end content, chunk by chunk, with libsodium secretstream
+ *
+ * Only the onion head is built by ns3::OnionRouting::BuildOnion(), in the ONION_LAYERCONTENT mode
+ * with the layer contents returned by GetLayerContent(). The layer content of each hop is the key
+ * and the header of a secretstream. The content is then sent as a sequence of chunks, each chunk is
+ * encrypted with the stream of every hop, the last hop first, so each hop removes one layer from
+ * each chunk with ns3::OnionStreamReceiver. Only one chunk is held in memory at a time, and the
+ * size of the content is not bounded by the uint16_t length of the onion head.
+ *
+ * Wire format of a chunk: the chunk grows by CHUNK_OVERHEAD bytes for each hop still to peel it.
+ *
+ * The stream is a library facility, ns3::Sink and ns3::SensorNode do not use it and carry the whole
+ * content in the onion message.
+ */
+
+class OnionStreamSender
+{
+public:
+  static const uint16_t KEY_BYTES =
+      crypto_secretstream_xchacha20poly1305_KEYBYTES; //!< size of the key of a stream
+  static const uint16_t HEADER_BYTES =
+      crypto_secretstream_xchacha20poly1305_HEADERBYTES; //!< size of the header of a stream
+  static const uint16_t LAYER_CONTENT_BYTES =
+      KEY_BYTES + HEADER_BYTES; //!< layer content of each hop, [key][header]
+  static const uint16_t CHUNK_OVERHEAD =
+      crypto_secretstream_xchacha20poly1305_ABYTES; //!< size increase of a chunk for each hop
+
+  /**
+  *
+  * \brief Default constructor
+  *
+  */
+  OnionStreamSender ();
+
+  /**
+  *
+  * \brief Default destructor, wipe the keys
+  *
+  */
+  ~OnionStreamSender ();
+
+  /**
+  *
+  * \brief Generate the key and initialize the stream of each hop of the onion path
+  *
+  * \param [in] routeLen the number of hops that peel the chunks
+  *
+  */
+  void Init (uint16_t routeLen);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return array of \p routeLen pointers to LAYER_CONTENT_BYTES bytes, the layerContent argument of
+  *         ns3::OnionRouting::BuildOnion()
+  *
+  */
+  uint8_t **GetLayerContent (void);
+
+  /**
+  *
+  * \brief Compute the size of an encrypted chunk as sent to the first hop
+  *
+  * \param [in] chunkLen size of the chunk of the content in bytes
+  *
+  * \return the size in bytes
+  *
+  */
+  uint32_t EncryptedChunkLength (uint32_t chunkLen) const;
+
+  /**
+  *
+  * \brief Encrypt the next chunk of the content with the streams of all hops
+  *
+  * \param [in,out] ciphertext memory of at least EncryptedChunkLength() bytes on which the encrypted chunk is stored
+  * \param [in] chunk the chunk of the content, must not overlap \p ciphertext
+  * \param [in] chunkLen size of the \p chunk in bytes
+  * \param [in] last true for the last chunk of the content, the hops detect the truncation of the stream
+  *
+  * \return true on success
+  *
+  */
+  bool EncryptChunk (uint8_t *ciphertext, const uint8_t *chunk, uint32_t chunkLen, bool last);
+
+private:
+  uint16_t m_routeLen; //!< number of hops
+  std::vector<crypto_secretstream_xchacha20poly1305_state> m_states; //!< stream of each hop
+  std::vector<uint8_t> m_layerContent; //!< key and header of the stream of each hop
+  std::vector<uint8_t *> m_layerContentPtr; //!< pointers into \p m_layerContent
+  std::vector<uint8_t> m_scratch; //!< chunk encrypted by the inner hops, reused across chunks
+};
+
+/**
+ * \ingroup managers
+ * \class OnionStreamReceiver
+ * \brief Removes the stream layer of a hop from the chunks of a content sent by ns3::OnionStreamSender
+ *
+ * The hop initializes the stream from the layer content of the peeled onion head, orLayer::innerLayer,
+ * then decrypts each chunk before forwarding it to the next hop.
+ */
+
+class OnionStreamReceiver
+{
+public:
+  /**
+  *
+  * \brief Default constructor
+  *
+  */
+  OnionStreamReceiver ();
+
+  /**
+  *
+  * \brief Default destructor, wipe the stream state
+  *
+  */
+  ~OnionStreamReceiver ();
+
+  /**
+  *
+  * \brief Initialize the stream from the layer content of this hop
+  *
+  * \param [in] layerContent OnionStreamSender::LAYER_CONTENT_BYTES bytes, [key][header]
+  *
+  * \return true on success, false if the header is invalid
+  *
+  */
+  bool Init (const uint8_t *layerContent);
+
+  /**
+  *
+  * \brief Remove the layer of this hop from the next chunk
+  *
+  * \param [in,out] chunk memory of at least \p ciphertextLen - OnionStreamSender::CHUNK_OVERHEAD bytes
+  * \param [in] ciphertext the chunk as received, must not overlap \p chunk
+  * \param [in] ciphertextLen size of the \p ciphertext in bytes
+  * \param [out] last set to true if the chunk is the last of the content
+  *
+  * \return true on success, false if the chunk is corrupted, reordered or not for this hop
+  *
+  */
+  bool DecryptChunk (uint8_t *chunk, const uint8_t *ciphertext, uint32_t ciphertextLen,
+                     bool *last);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return true after the last chunk of the content was decrypted
+  *
+  */
+  bool IsFinished (void) const;
+
+private:
+  crypto_secretstream_xchacha20poly1305_state m_state; //!< stream of this hop
+  bool m_finished; //!< the last chunk was decrypted
+};
+
+} // namespace ns3
+
+#endif /* ONIONSTREAM_H */
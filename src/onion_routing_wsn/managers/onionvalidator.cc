@@ -87,6 +87,12 @@ OnionValidator::CheckOnionReceived (int hop)
   return true;
 }
 
+void
+OnionValidator::AbortOnion (void)
+{
+  m_onionSeq = 0;
+}
+
 //changes state of the onion status
 int
 OnionValidator::OnionHopCount (void)
@@ -105,6 +105,13 @@ public:
   * \return TRUE if the onion is running, FALSE if the onion was aborted
   */
   bool CheckOnionReceived (int hop);
+
+  /**
+  *
+  * \brief  Called by the sink node when it learns that the onion was dropped, abort the onion
+  * 
+  */
+  void AbortOnion (void);
   /**
   *
   * \brief  Return the current hop sequence number
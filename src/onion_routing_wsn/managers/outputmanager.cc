@@ -111,12 +111,19 @@ OutputManager::PrintIntro (std::string intro)
       << intro
       << "-----------------------------------Simulation "
          "output--------------------------------------");
+
+  std::string energyHeaders;
+  if (m_energyAccounting)
+    {
+      energyHeaders = "\n" + h_onionEnergyHeader + "\n" + h_nodeEnergyHeader;
+    }
   if (m_printDescription)
     {
       PrintLine ("---------------------------------Simulation "
                  "description-----------------------------------\n" +
                  intro + "--csv headers--\n" + h_onionHeader + "\n" + h_routingHeader + "\n" +
-                 h_timeoutHeader + "\n" + h_nodeDetailsHeader +
+                 h_timeoutHeader + "\n" + h_dropHeader + "\n" + h_dropStatisticsHeader + "\n" +
+                 h_nodeDetailsHeader + energyHeaders +
                  "\n-----------------------------------Simulation "
                  "output--------------------------------------");
     }
@@ -161,6 +168,8 @@ OutputManager::RecvOnion (Time recv_at)
                << std::to_string (recv_at.GetSeconds ()) << " with onion id: " << m_onionId
                << ", onion traveling time: "
                << std::to_string (recv_at.GetSeconds () - t_onionDelta));
+
+  PrintOnionEnergy ();
 }
 
 void
@@ -203,6 +212,78 @@ OutputManager::AbortOnion (Time abort_at)
 
   NS_LOG_INFO ("Onion Was aborted at time: " << std::to_string (abort_at.GetSeconds ())
                                              << " , with onion id: " << m_onionId);
+
+  PrintOnionEnergy ();
+}
+
+void
+OutputManager::DropOnion (Ipv4Address node_ip, Time drop_at)
+{
+  m_droppedOnions++;
+  PrintLine ("onion_dropped," + m_simName + "," + m_simDetails + "," + std::to_string (m_onionId) +
+             "," + std::to_string (m_onionPathLength) + "," + Ipv4ToString (node_ip) + "," +
+             std::to_string (drop_at.GetSeconds ()));
+
+  NS_LOG_INFO ("Onion dropped at node ip: " << Ipv4ToString (node_ip) << ", at time: "
+                                            << std::to_string (drop_at.GetSeconds ())
+                                            << ", with onion id: " << m_onionId);
+}
+
+void
+OutputManager::FailureNotice (Time recv_at)
+{
+  m_failureNotices++;
+  NS_LOG_INFO ("Failure notice received at time: " << std::to_string (recv_at.GetSeconds ())
+                                                   << ", with onion id: " << m_onionId);
+}
+
+void
+OutputManager::PrintDropStatistics ()
+{
+  PrintLine ("drop_statistics," + m_simName + "," + m_simDetails + "," +
+             std::to_string (m_droppedOnions) + "," + std::to_string (m_failureNotices));
+}
+
+void
+OutputManager::EnableEnergyAccounting ()
+{
+  m_energyAccounting = true;
+}
+
+void
+OutputManager::AddOnionEnergy (double joules)
+{
+  m_onionEnergy += joules;
+}
+
+//the energy of the onion includes its construction, charged before it is sent
+void
+OutputManager::PrintOnionEnergy ()
+{
+  if (m_energyAccounting)
+    {
+      PrintLine ("onion_energy," + m_simName + "," + m_simDetails + "," +
+                 std::to_string (m_onionId) + "," + std::to_string (m_onionPathLength) + "," +
+                 EnergyToString (m_onionEnergy));
+
+      NS_LOG_INFO ("Energy drawn by CPUs for the onion with onion id: " << m_onionId << ", "
+                                                                       << m_onionEnergy << " J");
+    }
+  m_onionEnergy = 0;
+}
+
+void
+OutputManager::NodeEnergy (Ipv4Address node_ip, const CpuCounters &counters, double cpu_energy,
+                           double radio_energy, double remaining_energy)
+{
+  PrintLine ("node_energy," + m_simName + "," + m_simDetails + "," + Ipv4ToString (node_ip) + "," +
+             std::to_string (counters.encryptions) + "," + std::to_string (counters.decryptions) +
+             "," + std::to_string (counters.cryptoBytes) + "," +
+             std::to_string (counters.serializations) + "," +
+             std::to_string (counters.deserializations) + "," +
+             std::to_string (counters.codecBytes) + "," + std::to_string (counters.cycles) + "," +
+             EnergyToString (cpu_energy) + "," + EnergyToString (radio_energy) + "," +
+             EnergyToString (remaining_energy));
 }
 
 //prints the output when a new node registers to the sink
@@ -258,6 +339,14 @@ OutputManager::Ipv4ToString (Ipv4Address ip)
   return ss.str ();
 }
 
+std::string
+OutputManager::EnergyToString (double joules)
+{
+  std::stringstream ss;
+  ss << std::setprecision (9) << joules;
+  return ss.str ();
+}
+
 std::string
 OutputManager::CurrentTime ()
 {
@@ -27,6 +27,7 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <iomanip>
 #include <fstream>
 #include "ns3/core-module.h"
 #include <vector>
@@ -34,6 +35,7 @@
 #include "ns3/internet-module.h"
 #include <time.h>
 #include "ns3/enums.h"
+#include "ns3/cpuenergymodel.h"
 #include <experimental/filesystem> 
 
 namespace ns3 {
@@ -121,6 +123,49 @@ public:
   */
   void AbortOnion (Time abort_at);
 
+  /**
+  *
+  * \brief Called by the sensor node that drops the onion message, whose layer can not be decrypted
+  *
+  */
+  void DropOnion (Ipv4Address node_ip, Time drop_at);
+
+  /**
+  *
+  * \brief Called by the sink node when it receives the failure notice of a dropped onion message
+  *
+  */
+  void FailureNotice (Time recv_at);
+
+  /**
+  *
+  * \brief Print the number of dropped onion messages and of failure notices, at the end of the simulation
+  *
+  */
+  void PrintDropStatistics (void);
+
+  /**
+  *
+  * \brief Print the energy of onion messages and of nodes, see ns3::CpuEnergyModel
+  *
+  */
+  void EnableEnergyAccounting (void);
+
+  /**
+  *
+  * \brief Called by each node that processes the running onion message, with the energy drawn by its CPU
+  *
+  */
+  void AddOnionEnergy (double joules);
+
+  /**
+  *
+  * \brief Print the work and the energy of a node at the end of the simulation
+  *
+  */
+  void NodeEnergy (Ipv4Address node_ip, const CpuCounters &counters, double cpu_energy,
+                   double radio_energy, double remaining_energy);
+
   /**
   *
   * \brief Called when the sink receives a new handhake message
@@ -150,6 +195,14 @@ public:
   */
   void PrintLine (std::string line);
 
+  /**
+  *
+  * \brief print the energy line of the onion message on the csv file, if the energy is accounted,
+  *         and restart the accounting for the next onion message
+  *
+  */
+  void PrintOnionEnergy (void);
+
   /**
   *
   * \brief Convert an IpV4 address to a string
@@ -157,6 +210,13 @@ public:
   */
   std::string Ipv4ToString (Ipv4Address ip);
 
+  /**
+  *
+  * \brief Convert an energy in joules to a string, keeping the significant digits of small values
+  *
+  */
+  std::string EnergyToString (double joules);
+
   /**
   *
   * \brief return the current time as a string
@@ -223,6 +283,17 @@ public:
                                 "onion_path_length,abort_time"; //!< header of CSV format
   std::string h_nodeDetailsHeader = "node_details,sim_name,sim_num,num_of_nodes,topology,routing,"
                                     "coord_x,coord_y,node_degree"; //!< header of CSV format
+  std::string h_dropHeader = "onion_dropped,sim_name,sim_num,num_of_nodes,topology,routing,onion_"
+                            "id,onion_path_length,node_ip,drop_time"; //!< header of CSV format
+  std::string h_dropStatisticsHeader =
+      "drop_statistics,sim_name,sim_num,num_of_nodes,topology,routing,dropped_onions,failure_"
+      "notices"; //!< header of CSV format
+  std::string h_onionEnergyHeader = "onion_energy,sim_name,sim_num,num_of_nodes,topology,routing,"
+                                    "onion_id,onion_path_length,cpu_energy_j"; //!< header of CSV format
+  std::string h_nodeEnergyHeader =
+      "node_energy,sim_name,sim_num,num_of_nodes,topology,routing,node_ip,encryptions,decryptions,"
+      "crypto_bytes,serializations,deserializations,codec_bytes,cpu_cycles,cpu_energy_j,radio_"
+      "energy_j,remaining_energy_j"; //!< header of CSV format
 
   //reference to the onion we are executing
   std::string m_onionData; //!< holds data of the onion message currently executing in the network
@@ -234,6 +305,12 @@ public:
   double t_onionDelta = 0; //!< Hold time information of the onion message traveling in the network
   double t_hopDelta = 0; //!<  Hold time information of the onion message traveling from hop to hop
 
+  uint32_t m_droppedOnions = 0; //!< onion messages dropped by sensor nodes at a failed decryption
+  uint32_t m_failureNotices = 0; //!< failure notices received by the sink node
+
+  bool m_energyAccounting = false; //!< print the energy of onion messages and of nodes
+  double m_onionEnergy = 0; //!< energy in joules drawn by CPUs for the onion message, since the last one ended
+
   enum Routing m_routing; //!< information on the routing protocol
 
   std::map<uint32_t,std::string>
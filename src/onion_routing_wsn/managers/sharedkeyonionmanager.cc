@@ -0,0 +1,123 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include "sharedkeyonionmanager.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("sharedkeyonionmanager");
+
+NS_OBJECT_ENSURE_REGISTERED (SharedKeyOnionManager);
+
+TypeId
+SharedKeyOnionManager::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SharedKeyOnionManager")
+                          .SetParent<OnionManager> ()
+                          .SetGroupName ("OnionRouting");
+  return tid;
+}
+
+SharedKeyOnionManager::SharedKeyOnionManager () : OnionManager (LAYER_OVERHEAD)
+{
+  memset (m_sharedKey, 0, crypto_box_BEFORENMBYTES);
+}
+
+SharedKeyOnionManager::~SharedKeyOnionManager ()
+{
+  sodium_memzero (m_sharedKey, crypto_box_BEFORENMBYTES);
+}
+
+//the message is stored after the nonce and the MAC, the ciphertext overwrites it in place
+bool
+SharedKeyOnionManager::EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
+                                     unsigned char *key) const
+{
+  randombytes_buf (ciphertext, NONCE_BYTES);
+  if (crypto_box_easy_afternm (&ciphertext[NONCE_BYTES], message, len, ciphertext, key) != 0)
+    {
+      NS_LOG_ERROR ("Error during encryption");
+      return false;
+    }
+  return true;
+}
+
+bool
+SharedKeyOnionManager::DecryptLayer (unsigned char *innerLayer, unsigned char *onion,
+                                     uint16_t onionLen, unsigned char *pk, unsigned char *sk) const
+{
+  return onionLen >= NONCE_BYTES + MAC_BYTES &&
+         crypto_box_open_easy_afternm (innerLayer, &onion[NONCE_BYTES], onionLen - NONCE_BYTES,
+                                       onion, sk) == 0;
+}
+
+std::string
+SharedKeyOnionManager::LayerKey (const std::string &publicKey)
+{
+  unsigned char key[crypto_box_BEFORENMBYTES];
+  if (!PrecomputeKey (key, publicKey))
+    {
+      return std::string ();
+    }
+  std::string layerKey = UcharToString (key, crypto_box_BEFORENMBYTES);
+  sodium_memzero (key, crypto_box_BEFORENMBYTES);
+  return layerKey;
+}
+
+bool
+SharedKeyOnionManager::SetPeerPublicKey (const std::string &publicKey)
+{
+  unsigned char key[crypto_box_BEFORENMBYTES];
+  if (!PrecomputeKey (key, publicKey))
+    {
+      return false;
+    }
+  memcpy (m_sharedKey, key, crypto_box_BEFORENMBYTES);
+  sodium_memzero (key, crypto_box_BEFORENMBYTES);
+  return true;
+}
+
+bool
+SharedKeyOnionManager::PrecomputeKey (unsigned char *key, const std::string &publicKey)
+{
+  if (publicKey.size () != crypto_box_PUBLICKEYBYTES)
+    {
+      NS_LOG_WARN ("Public key of unexpected size: " << publicKey.size ());
+      return false;
+    }
+  if (crypto_box_beforenm (key, reinterpret_cast<const unsigned char *> (publicKey.data ()),
+                           GetSK ()) != 0)
+    {
+      NS_LOG_WARN ("Error during the key precomputation, the public key is not valid");
+      return false;
+    }
+  return true;
+}
+
+unsigned char *
+SharedKeyOnionManager::GetDecryptionKey ()
+{
+  return m_sharedKey;
+}
+
+} // namespace ns3
@@ -0,0 +1,152 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef SHAREDKEYONIONMANAGER_H
+#define SHAREDKEYONIONMANAGER_H
+
+#include "ns3/onionmanager.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup managers
+ * \class SharedKeyOnionManager
+ * \brief Onion manager encrypting layers with keys precomputed by crypto_box_beforenm
+ *
+ * The sink computes a shared key for each sensor node once, at the receipt of the handshake,
+ * and the sensor node computes the same key from the public key of the sink, sent back by the sink.
+ * Layers are then encrypted and decrypted only with the symmetric crypto_box_easy_afternm and crypto_box_open_easy_afternm.
+ *
+ * Wire format of a layer: [nonce (NONCE_BYTES)][MAC (MAC_BYTES)][encrypted plaintext],
+ * the overhead of each layer is LAYER_OVERHEAD bytes.
+ */
+
+class SharedKeyOnionManager : public OnionManager
+{
+public:
+  static const uint16_t NONCE_BYTES = crypto_box_NONCEBYTES; //!< size of the random nonce in front of each layer
+  static const uint16_t MAC_BYTES = crypto_box_MACBYTES; //!< size of the authentication tag of each layer
+  static const uint16_t LAYER_OVERHEAD = NONCE_BYTES + MAC_BYTES; //!< size increase of each layer in bytes
+
+  /**
+ *  Register this type.
+ *  \return The object TypeId.
+ */
+  static TypeId GetTypeId (void);
+
+  /**
+  *
+  * \brief Default constructor
+  *
+  */
+  SharedKeyOnionManager ();
+
+  /**
+  *
+  * \brief Default destructor
+  *
+  */
+  ~SharedKeyOnionManager ();
+
+  /**
+*
+* \brief Encrypt the layer with crypto_box_easy_afternm under a random nonce
+* 
+*   \param [in,out] ciphertext memory on which the ciphertext will be stored
+*   \param [in] message memory locations containing the data to be encrypted
+*   \param [in] len length in bytes of the \p message 
+*   \param [in] key pointer to the shared key, computed by ns3::SharedKeyOnionManager::LayerKey()
+*   \return true on success
+*
+*/
+
+  virtual bool EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
+                             unsigned char *key) const;
+
+  /**
+*
+* \brief Decrypt the layer with crypto_box_open_easy_afternm
+* 
+*   \param [in,out] innerLayer memory on which the inner onion layer will be stored
+*   \param [in] onion memory locations containing the data to be decrypted
+*   \param [in] onionLen length in bytes of the \p onion 
+*   \param [in] pk not used
+*   \param [in] sk pointer to the shared key, returned by ns3::SharedKeyOnionManager::GetDecryptionKey()
+*   \return true on success, false if the layer is corrupted or not addressed to the node
+*
+*/
+
+  virtual bool DecryptLayer (unsigned char *innerLayer, unsigned char *onion, uint16_t onionLen,
+                             unsigned char *pk, unsigned char *sk) const;
+
+  /**
+  *
+  * \brief Precompute the key shared with the node owning \p publicKey
+  *
+  * \param [in] publicKey the public key of the node given as a string
+  *
+  * \return the shared key as a string, empty if \p publicKey is not a valid public key
+  *
+  */
+  virtual std::string LayerKey (const std::string &publicKey);
+
+  /**
+  *
+  * \brief Precompute the key shared with the peer, sensor nodes call it with the public key of the sink
+  *
+  * \param [in] publicKey the public key of the peer given as a string
+  *
+  * \return true on success, false if \p publicKey is not a valid public key, the shared key is
+  *         left unchanged
+  *
+  */
+  virtual bool SetPeerPublicKey (const std::string &publicKey);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return Return the pointer to the key shared with the peer
+  *
+  */
+  virtual unsigned char *GetDecryptionKey (void);
+
+private:
+  /**
+  *
+  * \brief Precompute with crypto_box_beforenm the key shared with the node owning \p publicKey
+  *
+  * \param [out] key crypto_box_BEFORENMBYTES bytes
+  * \param [in] publicKey the public key of the node given as a string
+  *
+  * \return true on success, false if \p publicKey is not a valid public key
+  *
+  */
+  bool PrecomputeKey (unsigned char *key, const std::string &publicKey);
+
+  unsigned char m_sharedKey[crypto_box_BEFORENMBYTES]; //!< the key shared with the peer
+};
+
+} // namespace ns3
+
+#endif /* SHAREDKEYONIONMANAGER_H */
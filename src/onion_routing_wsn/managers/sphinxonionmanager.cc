@@ -0,0 +1,278 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include "sphinxonionmanager.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("sphinxonionmanager");
+
+NS_OBJECT_ENSURE_REGISTERED (SphinxOnionManager);
+
+static const uint8_t SPHINX_NONCE[crypto_stream_chacha20_NONCEBYTES] = {0}; //!< keys are never reused, zero nonce
+
+TypeId
+SphinxOnionManager::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SphinxOnionManager")
+                          .SetParent<OnionManager> ()
+                          .SetGroupName ("OnionRouting");
+  return tid;
+}
+
+SphinxOnionManager::SphinxOnionManager () : OnionManager (MAC_BYTES)
+{
+  memset (m_nextHop, 0, sizeof (m_nextHop));
+}
+
+SphinxOnionManager::~SphinxOnionManager ()
+{
+}
+
+void
+SphinxOnionManager::GenerateNewKeyPair ()
+{
+  unsigned char pk[crypto_core_ristretto255_BYTES];
+  unsigned char sk[crypto_core_ristretto255_SCALARBYTES];
+  crypto_core_ristretto255_scalar_random (sk);
+  crypto_scalarmult_ristretto255_base (pk, sk);
+  SetPK (pk);
+  SetSK (sk);
+  sodium_memzero (sk, sizeof (sk));
+}
+
+void
+SphinxOnionManager::GenerateKeyPairFromSeed (const unsigned char *seed)
+{
+  unsigned char pk[crypto_core_ristretto255_BYTES];
+  unsigned char sk[crypto_core_ristretto255_SCALARBYTES];
+  unsigned char hash[crypto_hash_sha512_BYTES];
+  crypto_hash_sha512 (hash, seed, KEY_SEED_BYTES);
+  crypto_core_ristretto255_scalar_reduce (sk, hash);
+  crypto_scalarmult_ristretto255_base (pk, sk);
+  SetPK (pk);
+  SetSK (sk);
+  sodium_memzero (hash, sizeof (hash));
+  sodium_memzero (sk, sizeof (sk));
+}
+
+uint16_t
+SphinxOnionManager::BlockSize () const
+{
+  return m_addressSize + MAC_BYTES;
+}
+
+uint16_t
+SphinxOnionManager::OnionLength (uint16_t routeLen, uint16_t layerContentLen,
+                                 uint16_t endContentLen)
+{
+  return HEADER_BYTES + (routeLen - 1) * BlockSize ();
+}
+
+void
+SphinxOnionManager::DeriveKeys (const uint8_t *secret, uint8_t *rho, uint8_t *mu) const
+{
+  crypto_generichash (rho, crypto_stream_chacha20_KEYBYTES,
+                      reinterpret_cast<const unsigned char *> ("sphinx-rho"), 10, secret,
+                      GROUP_BYTES);
+  crypto_generichash (mu, crypto_onetimeauth_KEYBYTES,
+                      reinterpret_cast<const unsigned char *> ("sphinx-mu"), 9, secret,
+                      GROUP_BYTES);
+}
+
+void
+SphinxOnionManager::BlindingFactor (const uint8_t *alpha, const uint8_t *secret,
+                                    uint8_t *blinding) const
+{
+  uint8_t in[2 * GROUP_BYTES];
+  uint8_t hash[crypto_core_ristretto255_NONREDUCEDSCALARBYTES];
+  memcpy (in, alpha, GROUP_BYTES);
+  memcpy (&in[GROUP_BYTES], secret, GROUP_BYTES);
+  crypto_generichash (hash, sizeof (hash), in, sizeof (in), nullptr, 0);
+  crypto_core_ristretto255_scalar_reduce (blinding, hash);
+}
+
+void
+SphinxOnionManager::CreateOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys,
+                                 uint16_t routeLen, uint8_t **layerContent,
+                                 uint16_t layerContentLen, uint8_t *endContent,
+                                 uint16_t endContentLen)
+{
+  if (layerContentLen != 0 || endContentLen != 0)
+    {
+      NS_LOG_WARN ("Sphinx onion heads carry only routing information.");
+      m_errno = ERROR_NOT_SUPPORTED;
+      return;
+    }
+
+  const uint16_t hops = routeLen - 1;
+  const uint16_t block = BlockSize ();
+  const uint16_t betaLen = hops * block;
+  uint8_t *gamma = &cipher[GROUP_BYTES];
+  uint8_t *beta = &cipher[HEADER_BYTES];
+
+  //shared secrets of hops, alpha of hop i is g^(x * b_0 * ... * b_i-1)
+  std::vector<uint8_t> rho (hops * crypto_stream_chacha20_KEYBYTES);
+  std::vector<uint8_t> mu (hops * crypto_onetimeauth_KEYBYTES);
+  uint8_t exponent[crypto_core_ristretto255_SCALARBYTES];
+  uint8_t blinding[crypto_core_ristretto255_SCALARBYTES];
+  uint8_t alpha[GROUP_BYTES];
+  uint8_t secret[GROUP_BYTES];
+
+  crypto_core_ristretto255_scalar_random (exponent);
+  for (uint16_t i = 0; i < hops; ++i)
+    {
+      crypto_scalarmult_ristretto255_base (alpha, exponent);
+      if (i == 0)
+        {
+          memcpy (cipher, alpha, GROUP_BYTES);
+        }
+      if (crypto_scalarmult_ristretto255 (secret, exponent, keys[i]) != 0)
+        {
+          NS_LOG_WARN ("Invalid public key of hop " << i);
+          m_errno = ERROR_ENCRYPTION;
+          return;
+        }
+      DeriveKeys (secret, &rho[i * crypto_stream_chacha20_KEYBYTES],
+                  &mu[i * crypto_onetimeauth_KEYBYTES]);
+      BlindingFactor (alpha, secret, blinding);
+      crypto_core_ristretto255_scalar_mul (exponent, exponent, blinding);
+    }
+
+  //filler -- the tail each hop appends to beta, encrypted by the streams of previous hops
+  m_stream.resize (betaLen + block);
+  std::vector<uint8_t> filler ((hops - 1) * block, 0);
+  for (uint16_t i = 0; i + 1 < hops; ++i)
+    {
+      uint16_t fillerLen = (i + 1) * block;
+      crypto_stream_chacha20 (&m_stream[0], betaLen + block, SPHINX_NONCE,
+                              &rho[i * crypto_stream_chacha20_KEYBYTES]);
+      for (uint16_t j = 0; j < fillerLen; ++j)
+        {
+          filler[j] ^= m_stream[betaLen + block - fillerLen + j];
+        }
+    }
+
+  //routing information of the last hop, followed by the filler
+  uint16_t last = hops - 1;
+  memcpy (beta, route[hops], m_addressSize);
+  memset (&beta[m_addressSize], 0, MAC_BYTES);
+  crypto_stream_chacha20_xor (beta, beta, block, SPHINX_NONCE,
+                              &rho[last * crypto_stream_chacha20_KEYBYTES]);
+  if (!filler.empty ())
+    {
+      memcpy (&beta[block], &filler[0], filler.size ());
+    }
+  crypto_onetimeauth (gamma, beta, betaLen, &mu[last * crypto_onetimeauth_KEYBYTES]);
+
+  //wrap the routing information of previous hops, from the last hop backward
+  for (int i = hops - 2; i >= 0; --i)
+    {
+      memmove (&beta[block], beta, betaLen - block);
+      memcpy (beta, route[i + 1], m_addressSize);
+      memcpy (&beta[m_addressSize], gamma, MAC_BYTES);
+      crypto_stream_chacha20_xor (beta, beta, betaLen, SPHINX_NONCE,
+                                  &rho[i * crypto_stream_chacha20_KEYBYTES]);
+      crypto_onetimeauth (gamma, beta, betaLen, &mu[i * crypto_onetimeauth_KEYBYTES]);
+    }
+
+  sodium_memzero (exponent, sizeof (exponent));
+}
+
+orLayer
+SphinxOnionManager::PeelOnion (uint8_t *onion, uint16_t onionLen, uint8_t *publicKey,
+                               uint8_t *secretKey, uint8_t *buffer)
+{
+  const uint16_t block = BlockSize ();
+  const uint16_t betaLen = onionLen - HEADER_BYTES;
+
+  orLayer layer;
+  layer.nextHopIP = m_nextHop;
+  layer.innerLayer = buffer;
+  layer.innerLayerLen = onionLen;
+  memset (m_nextHop, 0, sizeof (m_nextHop));
+
+  uint8_t secret[GROUP_BYTES];
+  uint8_t rho[crypto_stream_chacha20_KEYBYTES];
+  uint8_t mu[crypto_onetimeauth_KEYBYTES];
+  uint8_t blinding[crypto_core_ristretto255_SCALARBYTES];
+  uint8_t alpha[GROUP_BYTES];
+
+  m_errno = ERROR_NOTERROR;
+  if (onionLen < HEADER_BYTES + block || betaLen % block != 0 ||
+      crypto_scalarmult_ristretto255 (secret, secretKey, onion) != 0)
+    {
+      NS_LOG_INFO ("Malformed onion head");
+      m_errno = ERROR_DECRYPTION;
+      return layer;
+    }
+
+  DeriveKeys (secret, rho, mu);
+  if (crypto_onetimeauth_verify (&onion[GROUP_BYTES], &onion[HEADER_BYTES], betaLen, mu) != 0)
+    {
+      NS_LOG_INFO ("Messge corrupted or not for this node");
+      m_errno = ERROR_DECRYPTION;
+      return layer;
+    }
+
+  //blind alpha for the next hop
+  BlindingFactor (onion, secret, blinding);
+  crypto_scalarmult_ristretto255 (alpha, blinding, onion);
+
+  //decrypt beta extended by a block of zeros
+  m_stream.resize (betaLen + block);
+  memcpy (&m_stream[0], &onion[HEADER_BYTES], betaLen);
+  memset (&m_stream[betaLen], 0, block);
+  crypto_stream_chacha20_xor (&m_stream[0], &m_stream[0], betaLen + block, SPHINX_NONCE, rho);
+
+  //next hop address, the head of the next hop is [alpha][gamma][beta]
+  memcpy (m_nextHop, &m_stream[0], m_addressSize);
+  memcpy (buffer, alpha, GROUP_BYTES);
+  memcpy (&buffer[GROUP_BYTES], &m_stream[m_addressSize], MAC_BYTES);
+  memcpy (&buffer[HEADER_BYTES], &m_stream[block], betaLen);
+
+  return layer;
+}
+
+orLayer
+SphinxOnionManager::PeelOnionInPlace (uint8_t *onion, uint16_t onionLen, uint8_t *publicKey,
+                                      uint8_t *secretKey)
+{
+  return PeelOnion (onion, onionLen, publicKey, secretKey, onion);
+}
+
+bool
+SphinxOnionManager::EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
+                                  unsigned char *key) const
+{
+  return false;
+}
+
+bool
+SphinxOnionManager::DecryptLayer (unsigned char *innerLayer, unsigned char *onion,
+                                  uint16_t onionLen, unsigned char *pk, unsigned char *sk) const
+{
+  return false;
+}
+
+} // namespace ns3
@@ -0,0 +1,191 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef SPHINXONIONMANAGER_H
+#define SPHINXONIONMANAGER_H
+
+#include <vector>
+
+#include "ns3/onionmanager.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup managers
+ * \class SphinxOnionManager
+ * \brief Onion manager building constant-size onion heads in the style of the Sphinx packet format
+ *
+ * Sphinx: A Compact and Provably Secure Mix Format, George Danezis and Ian Goldberg, 2009.<br>
+ * The onion head is [alpha (GROUP_BYTES)][gamma (MAC_BYTES)][beta (hops * (address + MAC_BYTES))], where alpha is a
+ * ristretto255 group element, gamma the MAC of beta and beta the routing information of all hops encrypted with a stream cipher.
+ * Each hop derives the shared secret from alpha and its secret key, checks gamma, decrypts its next hop address
+ * and the MAC of the following hop, and blinds alpha for the next hop. The head keeps the same size on the whole route,
+ * so no padding is needed to hide the position of the hop.
+ *
+ * Keys of nodes are ristretto255 scalars and group elements, generated by ns3::SphinxOnionManager::GenerateNewKeyPair().
+ * Only onions without content (ONION_NO_CONTENT) are supported.
+ */
+
+class SphinxOnionManager : public OnionManager
+{
+public:
+  static const uint16_t GROUP_BYTES =
+      crypto_core_ristretto255_BYTES; //!< size of the group element alpha
+  static const uint16_t MAC_BYTES = crypto_onetimeauth_BYTES; //!< size of the MAC of each hop
+  static const uint16_t HEADER_BYTES = GROUP_BYTES + MAC_BYTES; //!< size of alpha and gamma
+
+  /**
+ *  Register this type.
+ *  \return The object TypeId.
+ */
+  static TypeId GetTypeId (void);
+
+  /**
+  *
+  * \brief Default constructor
+  *
+  */
+  SphinxOnionManager ();
+
+  /**
+  *
+  * \brief Default destructor
+  *
+  */
+  ~SphinxOnionManager ();
+
+  /**
+  *
+  * \brief Generate a new ristretto255 keypair, the secret key is a scalar and the public key the corresponding group element
+  *
+  */
+  virtual void GenerateNewKeyPair (void);
+
+  /**
+  *
+  * \brief Derive the ristretto255 keypair from \p seed, the secret key is the scalar reduced from the SHA-512 of the seed
+  *
+  * \param [in] seed KEY_SEED_BYTES bytes of seed
+  *
+  */
+  virtual void GenerateKeyPairFromSeed (const unsigned char *seed);
+
+  /**
+*
+* \brief Constructs the Sphinx onion head, the route is given as for ns3::OnionRouting::CreateOnion()
+* 
+* Hop i of the route receives the head from the previous hop, decrypts the address \p route [i + 1] and
+* forwards the head. \p keys [i] is the public key of hop i.
+*
+*/
+
+  virtual void CreateOnion (uint8_t *cipher, uint8_t **route, uint8_t **keys, uint16_t routeLen,
+                            uint8_t **layerContent, uint16_t layerContentLen, uint8_t *endContent,
+                            uint16_t endContentLen);
+
+  /**
+*
+* \brief Process the onion head into \p buffer
+* 
+* The returned orLayer holds the next hop address, valid until the next call, and the processed head of length \p onionLen stored in \p buffer.
+* On failure the next hop address is the zero address and the errno is set to ERROR_DECRYPTION.
+*
+*   \param [in] onion the onion head
+*   \param [in] onionLen the length in bytes of the onion head
+*   \param [in] publicKey not used
+*   \param [in] secretKey the secret key of the node
+*   \param [in,out] buffer memory of at least \p onionLen bytes, may be equal to \p onion
+*  <br>
+*   \return orLayer struct holding the onion layer details
+*
+*/
+
+  virtual orLayer PeelOnion (uint8_t *onion, uint16_t onionLen, uint8_t *publicKey,
+                             uint8_t *secretKey, uint8_t *buffer);
+
+  /**
+*
+* \brief Process the onion head in place, the processed head overwrites \p onion
+*
+*/
+
+  virtual orLayer PeelOnionInPlace (uint8_t *onion, uint16_t onionLen, uint8_t *publicKey,
+                                    uint8_t *secretKey);
+
+  /**
+*
+* \brief Compute the length of the onion head, HEADER_BYTES and one routing block for each hop
+*
+*/
+
+  virtual uint16_t OnionLength (uint16_t routeLen, uint16_t layerContentLen,
+                                uint16_t endContentLen);
+
+  /**
+*
+* \brief Layers are not used by the Sphinx onion head, always fails
+*
+*/
+
+  virtual bool EncryptLayer (unsigned char *ciphertext, unsigned char *message, int len,
+                             unsigned char *key) const;
+
+  /**
+*
+* \brief Layers are not used by the Sphinx onion head, always fails
+*   \return false
+*
+*/
+
+  virtual bool DecryptLayer (unsigned char *innerLayer, unsigned char *onion, uint16_t onionLen,
+                             unsigned char *pk, unsigned char *sk) const;
+
+private:
+  /**
+  *
+  * \brief Derive the stream cipher key \p rho and the MAC key \p mu from the shared secret
+  *
+  */
+  void DeriveKeys (const uint8_t *secret, uint8_t *rho, uint8_t *mu) const;
+
+  /**
+  *
+  * \brief Derive the blinding factor of alpha from alpha and the shared secret
+  *
+  */
+  void BlindingFactor (const uint8_t *alpha, const uint8_t *secret, uint8_t *blinding) const;
+
+  /**
+  *
+  * \brief Size in bytes of the routing information of a hop, the next hop address and MAC
+  *
+  */
+  uint16_t BlockSize (void) const;
+
+  uint8_t m_nextHop[16]; //!< next hop address of the last processed onion head
+  std::vector<uint8_t> m_stream; //!< scratch memory for the stream cipher
+};
+
+} // namespace ns3
+
+#endif /* SPHINXONIONMANAGER_H */
@@ -0,0 +1,260 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#include "cpuenergymodel.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("cpuenergymodel");
+
+NS_OBJECT_ENSURE_REGISTERED (CpuEnergyModel);
+
+/**
+ * \brief Cycles and currents of the onion protocol on a CPU profile
+ */
+struct CpuEnergyProfile
+{
+  double frequency; //!< clock frequency in Hz
+  uint64_t encryption; //!< crypto_box_seal, two X25519 scalar multiplications
+  uint64_t decryption; //!< crypto_box_seal_open, one X25519 scalar multiplication
+  uint32_t cryptoByte; //!< XSalsa20-Poly1305 per byte
+  uint64_t circuitLayer; //!< ChaCha20-Poly1305 layer of a circuit cell, Poly1305 key block and tag
+  uint32_t codecByte; //!< protobuf encoding or decoding per byte
+  double activeCurrent; //!< active current in A
+  double idleCurrent; //!< current in the low power mode in A
+};
+
+//indexed by ns3::CpuProfile, cycles of the ns3::CostModelOnionManager costs at the clock frequency
+static const CpuEnergyProfile g_cpuEnergyProfiles[] = {
+    {16e6, 18240000, 9120000, 250, 20000, 20, 3.7e-3, 2e-6}, //MSP430 16MHz, ~230uA/MHz, LPM3 idle
+    {64e6, 1817600, 908800, 30, 2500, 6, 3.3e-3, 1.5e-6} //Cortex-M4 64MHz, ~52uA/MHz, sleep idle
+};
+
+TypeId
+CpuEnergyModel::GetTypeId (void)
+{
+  static TypeId tid =
+      TypeId ("ns3::CpuEnergyModel")
+          .SetParent<DeviceEnergyModel> ()
+          .SetGroupName ("OnionRouting")
+          .AddConstructor<CpuEnergyModel> ()
+          .AddAttribute ("CpuProfile", "CPU of the node, defines the cycles and the currents",
+                         EnumValue (CpuProfile::CortexM4),
+                         MakeEnumAccessor (&CpuEnergyModel::m_cpuProfile),
+                         MakeEnumChecker (CpuProfile::MSP430, "msp430", CpuProfile::CortexM4,
+                                          "cortexm4", CpuProfile::CustomCpu, "custom"))
+          .AddAttribute ("Frequency", "Clock frequency in Hz, custom CPU profile",
+                         DoubleValue (64e6), MakeDoubleAccessor (&CpuEnergyModel::m_frequency),
+                         MakeDoubleChecker<double> (1))
+          .AddAttribute ("EncryptionCycles",
+                         "Cycles of the encryption of a layer, custom CPU profile",
+                         UintegerValue (1817600),
+                         MakeUintegerAccessor (&CpuEnergyModel::m_encryptionCycles),
+                         MakeUintegerChecker<uint64_t> ())
+          .AddAttribute ("DecryptionCycles",
+                         "Cycles of the decryption of a layer, custom CPU profile",
+                         UintegerValue (908800),
+                         MakeUintegerAccessor (&CpuEnergyModel::m_decryptionCycles),
+                         MakeUintegerChecker<uint64_t> ())
+          .AddAttribute ("CryptoByteCycles",
+                         "Cycles of each encrypted or decrypted byte, custom CPU profile",
+                         UintegerValue (30),
+                         MakeUintegerAccessor (&CpuEnergyModel::m_cryptoByteCycles),
+                         MakeUintegerChecker<uint32_t> ())
+          .AddAttribute ("CircuitLayerCycles",
+                         "Cycles of the encryption or decryption of a layer of a circuit cell, "
+                         "custom CPU profile",
+                         UintegerValue (2500),
+                         MakeUintegerAccessor (&CpuEnergyModel::m_circuitLayerCycles),
+                         MakeUintegerChecker<uint64_t> ())
+          .AddAttribute ("CodecByteCycles",
+                         "Cycles of each serialized or deserialized byte, custom CPU profile",
+                         UintegerValue (6),
+                         MakeUintegerAccessor (&CpuEnergyModel::m_codecByteCycles),
+                         MakeUintegerChecker<uint32_t> ())
+          .AddAttribute ("ActiveCurrentA", "Current in the active state in A, custom CPU profile",
+                         DoubleValue (3.3e-3),
+                         MakeDoubleAccessor (&CpuEnergyModel::m_activeCurrentA),
+                         MakeDoubleChecker<double> (0))
+          .AddAttribute ("IdleCurrentA", "Current in the idle state in A, custom CPU profile",
+                         DoubleValue (1.5e-6),
+                         MakeDoubleAccessor (&CpuEnergyModel::m_idleCurrentA),
+                         MakeDoubleChecker<double> (0))
+          .AddTraceSource ("TotalEnergyConsumption", "Total energy consumed by the CPU",
+                           MakeTraceSourceAccessor (&CpuEnergyModel::m_totalEnergyConsumption),
+                           "ns3::TracedValueCallback::Double");
+  return tid;
+}
+
+CpuEnergyModel::CpuEnergyModel ()
+{
+  m_totalEnergyConsumption = 0;
+  m_state = CPU_IDLE;
+  m_lastUpdateTime = Seconds (0);
+  m_busyUntil = Seconds (0);
+}
+
+CpuEnergyModel::~CpuEnergyModel ()
+{
+}
+
+void
+CpuEnergyModel::SetEnergySource (Ptr<EnergySource> source)
+{
+  NS_ASSERT (source != 0);
+  m_source = source;
+}
+
+double
+CpuEnergyModel::GetTotalEnergyConsumption (void) const
+{
+  if (m_source == 0)
+    {
+      return m_totalEnergyConsumption;
+    }
+  //the energy of the current state is accounted at the next state change
+  Time duration = Simulator::Now () - m_lastUpdateTime;
+  return m_totalEnergyConsumption +
+         duration.GetSeconds () * DoGetCurrentA () * m_source->GetSupplyVoltage ();
+}
+
+void
+CpuEnergyModel::ChangeState (int newState)
+{
+  NS_ASSERT (m_source != 0);
+  Time duration = Simulator::Now () - m_lastUpdateTime;
+  m_totalEnergyConsumption +=
+      duration.GetSeconds () * DoGetCurrentA () * m_source->GetSupplyVoltage ();
+  m_lastUpdateTime = Simulator::Now ();
+
+  //the source draws the current of the previous state up to now
+  m_source->UpdateEnergySource ();
+  m_state = (enum CpuState) newState;
+}
+
+void
+CpuEnergyModel::HandleEnergyDepletion (void)
+{
+  NS_LOG_INFO ("Energy source depleted at time: " << Simulator::Now ().GetSeconds ());
+}
+
+void
+CpuEnergyModel::HandleEnergyRecharged (void)
+{
+}
+
+void
+CpuEnergyModel::HandleEnergyChanged (void)
+{
+}
+
+double
+CpuEnergyModel::ChargeCpu (enum CpuOperation operation, uint32_t bytes)
+{
+  CpuEnergyProfile profile;
+  if (m_cpuProfile == CpuProfile::CustomCpu)
+    {
+      profile = {m_frequency,       m_encryptionCycles,   m_decryptionCycles,
+                 m_cryptoByteCycles, m_circuitLayerCycles, m_codecByteCycles,
+                 m_activeCurrentA,   m_idleCurrentA};
+    }
+  else
+    {
+      profile = g_cpuEnergyProfiles[m_cpuProfile];
+    }
+
+  uint64_t cycles = 0;
+  switch (operation)
+    {
+    case CpuOperation::LayerEncryption:
+      m_counters.encryptions++;
+      m_counters.cryptoBytes += bytes;
+      cycles = profile.encryption + (uint64_t) profile.cryptoByte * bytes;
+      break;
+    case CpuOperation::LayerDecryption:
+      m_counters.decryptions++;
+      m_counters.cryptoBytes += bytes;
+      cycles = profile.decryption + (uint64_t) profile.cryptoByte * bytes;
+      break;
+    case CpuOperation::CircuitEncryption:
+      m_counters.encryptions++;
+      m_counters.cryptoBytes += bytes;
+      cycles = profile.circuitLayer + (uint64_t) profile.cryptoByte * bytes;
+      break;
+    case CpuOperation::CircuitDecryption:
+      m_counters.decryptions++;
+      m_counters.cryptoBytes += bytes;
+      cycles = profile.circuitLayer + (uint64_t) profile.cryptoByte * bytes;
+      break;
+    case CpuOperation::PacketSerialization:
+      m_counters.serializations++;
+      m_counters.codecBytes += bytes;
+      cycles = (uint64_t) profile.codecByte * bytes;
+      break;
+    case CpuOperation::PacketDeserialization:
+      m_counters.deserializations++;
+      m_counters.codecBytes += bytes;
+      cycles = (uint64_t) profile.codecByte * bytes;
+      break;
+    }
+  m_counters.cycles += cycles;
+
+  if (m_source == 0)
+    {
+      //counted only, the model is not attached to a node
+      return 0;
+    }
+
+  //the CPU stays active until the work charged so far is done
+  Time now = Simulator::Now ();
+  m_busyUntil = std::max (m_busyUntil, now) + Seconds (cycles / profile.frequency);
+  if (m_state != CPU_ACTIVE)
+    {
+      ChangeState (CPU_ACTIVE);
+    }
+  m_idleEvent.Cancel ();
+  m_idleEvent =
+      Simulator::Schedule (m_busyUntil - now, &CpuEnergyModel::ChangeState, this, (int) CPU_IDLE);
+
+  return cycles / profile.frequency * (profile.activeCurrent - profile.idleCurrent) *
+         m_source->GetSupplyVoltage ();
+}
+
+const CpuCounters &
+CpuEnergyModel::GetCounters (void) const
+{
+  return m_counters;
+}
+
+double
+CpuEnergyModel::DoGetCurrentA (void) const
+{
+  if (m_cpuProfile == CpuProfile::CustomCpu)
+    {
+      return (m_state == CPU_ACTIVE) ? m_activeCurrentA : m_idleCurrentA;
+    }
+  const CpuEnergyProfile &profile = g_cpuEnergyProfiles[m_cpuProfile];
+  return (m_state == CPU_ACTIVE) ? profile.activeCurrent : profile.idleCurrent;
+}
+
+} // namespace ns3
@@ -0,0 +1,195 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef CPUENERGYMODEL_H
+#define CPUENERGYMODEL_H
+
+#include "ns3/device-energy-model.h"
+#include "ns3/energy-source.h"
+#include "ns3/core-module.h"
+#include "ns3/traced-value.h"
+#include "ns3/enums.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup node-application
+ * \struct CpuCounters
+ * \brief Work done by the CPU of a node for the onion protocol
+ */
+
+struct CpuCounters
+{
+  uint64_t encryptions = 0; //!< onion layers and layers of circuit cells encrypted
+  uint64_t decryptions = 0; //!< onion layers and layers of circuit cells decrypted
+  uint64_t cryptoBytes = 0; //!< bytes encrypted and decrypted
+  uint64_t serializations = 0; //!< packets serialized
+  uint64_t deserializations = 0; //!< packets deserialized
+  uint64_t codecBytes = 0; //!< bytes serialized and deserialized
+  uint64_t cycles = 0; //!< modelled CPU cycles of the work above
+};
+
+/**
+ * \ingroup node-application
+ * \class CpuEnergyModel
+ * \brief Energy consumed by the CPU of a node for the onion protocol, an ns3::DeviceEnergyModel
+ *
+ * The node charges each ns3::CpuOperation with ChargeCpu(), the operation is converted to CPU
+ * cycles by the ns3::CpuProfile and the CPU stays in the active state for the cycles at the clock
+ * frequency, drawing the active current from the ns3::EnergySource of the node, otherwise it
+ * draws the idle current. The cycles of the profiles model the sealed box, as in
+ * ns3::CostModelOnionManager, other onion modes can be modelled with CpuProfile::CustomCpu.
+ */
+
+class CpuEnergyModel : public DeviceEnergyModel
+{
+public:
+  /**
+  * \brief States of the CPU
+  */
+  enum CpuState {
+    CPU_IDLE = 0, //!< low power mode, waiting for packets
+    CPU_ACTIVE //!< running the onion protocol
+  };
+
+  /**
+ *  Register this type.
+ *  \return The object TypeId.
+ */
+  static TypeId GetTypeId (void);
+
+  /**
+  *
+  * \brief Default constructor
+  *
+  */
+  CpuEnergyModel ();
+
+  /**
+  *
+  * \brief Default destructor
+  *
+  */
+  virtual ~CpuEnergyModel ();
+
+  /**
+  *
+  * \brief Set the energy source drawn by the CPU
+  *
+  * \param [in] source the energy source of the node
+  *
+  */
+  virtual void SetEnergySource (Ptr<EnergySource> source);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the energy consumed by the CPU in joules, up to the current time
+  *
+  */
+  virtual double GetTotalEnergyConsumption (void) const;
+
+  /**
+  *
+  * \brief Account the energy of the current state and change the state of the CPU
+  *
+  * \param [in] newState the new ns3::CpuEnergyModel::CpuState
+  *
+  */
+  virtual void ChangeState (int newState);
+
+  /**
+  *
+  * \brief Called by the energy source when it is depleted
+  *
+  */
+  virtual void HandleEnergyDepletion (void);
+
+  /**
+  *
+  * \brief Called by the energy source when it is recharged
+  *
+  */
+  virtual void HandleEnergyRecharged (void);
+
+  /**
+  *
+  * \brief Called by the energy source when its energy changes
+  *
+  */
+  virtual void HandleEnergyChanged (void);
+
+  /**
+  *
+  * \brief Count an operation of the onion protocol and keep the CPU active for its cycles
+  *
+  * \param [in] operation the operation
+  * \param [in] bytes length in bytes of the processed data
+  *
+  * \return the energy in joules drawn by the operation above the idle current
+  *
+  */
+  double ChargeCpu (enum CpuOperation operation, uint32_t bytes);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the operations counted by ChargeCpu()
+  *
+  */
+  const CpuCounters &GetCounters (void) const;
+
+private:
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the current drawn in the current state, in amperes
+  *
+  */
+  virtual double DoGetCurrentA (void) const;
+
+  Ptr<EnergySource> m_source; //!< energy source of the node
+  enum CpuProfile m_cpuProfile; //!< CPU of the node
+  double m_frequency; //!< clock frequency in Hz with the CpuProfile::CustomCpu
+  uint64_t m_encryptionCycles; //!< cycles of a layer encryption with the CpuProfile::CustomCpu
+  uint64_t m_decryptionCycles; //!< cycles of a layer decryption with the CpuProfile::CustomCpu
+  uint32_t m_cryptoByteCycles; //!< cycles per encrypted or decrypted byte, CpuProfile::CustomCpu
+  uint64_t m_circuitLayerCycles; //!< cycles of a layer of a circuit cell, CpuProfile::CustomCpu
+  uint32_t m_codecByteCycles; //!< cycles per (de)serialized byte, CpuProfile::CustomCpu
+  double m_activeCurrentA; //!< current in the active state with the CpuProfile::CustomCpu
+  double m_idleCurrentA; //!< current in the idle state with the CpuProfile::CustomCpu
+
+  TracedValue<double> m_totalEnergyConsumption; //!< energy consumed up to \p m_lastUpdateTime
+  enum CpuState m_state; //!< current state of the CPU
+  Time m_lastUpdateTime; //!< time of the last state change
+  Time m_busyUntil; //!< end of the charged work, the CPU is idle afterwards
+  EventId m_idleEvent; //!< return to the idle state at \p m_busyUntil
+  CpuCounters m_counters; //!< operations counted by ChargeCpu()
+};
+
+} // namespace ns3
+
+#endif /* CPUENERGYMODEL_H */
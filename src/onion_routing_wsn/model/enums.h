@@ -110,6 +110,87 @@ enum BodyOptions {
   AggregateAndFixed //!< The onion body will aggregate a value and will maintain a fixed size apecified by the ns3::Sink::BodySize attribute
 };
 
+/**
+ * 
+ * \ingroup enumerators
+ * \enum OnionMode
+ * \brief Specifies how layers of onion messages are encrypted
+ */
+
+enum OnionMode {
+  SealedBox = 0, //!< Each layer is a sealed box to the public key of the node, ns3::OnionManager
+  SharedKey, //!< Each layer is encrypted with a key shared between the sink and the node, ns3::SharedKeyOnionManager
+  Sphinx, //!< Constant-size onion head in the Sphinx format, ns3::SphinxOnionManager
+  CostModel, //!< Size-preserving dummy encryption charging simulated processing time, ns3::CostModelOnionManager
+  Aead //!< X25519 key agreement and the AEAD of ns3::AeadOnionManager::Cipher, ns3::AeadOnionManager
+};
+
+/**
+ * 
+ * \ingroup enumerators
+ * \enum CpuProfile
+ * \brief Processing cost of the onion encryption on the CPU of sensor nodes, used by ns3::CostModelOnionManager and ns3::CpuEnergyModel
+ */
+
+enum CpuProfile {
+  MSP430 = 0, //!< TI MSP430 at 16MHz, X25519 in about 9M cycles
+  CortexM4, //!< ARM Cortex-M4 at 64MHz, X25519 in about 0.9M cycles
+  CustomCpu //!< Costs given by the attributes of ns3::CostModelOnionManager or ns3::CpuEnergyModel
+};
+
+/**
+ * 
+ * \ingroup enumerators
+ * \enum CpuOperation
+ * \brief Operations of the onion protocol charged to the CPU of a node by ns3::CpuEnergyModel
+ */
+
+enum CpuOperation {
+  LayerEncryption = 0, //!< Encryption of an onion layer
+  LayerDecryption, //!< Decryption of an onion layer
+  PacketSerialization, //!< Serialization of a protobuf message into a packet
+  PacketDeserialization, //!< Deserialization of a protobuf message from a packet
+  CircuitEncryption, //!< Encryption of a symmetric layer of a circuit cell
+  CircuitDecryption //!< Decryption of a symmetric layer of a circuit cell
+};
+
+/**
+ * 
+ * \ingroup enumerators
+ * \enum PoolCost
+ * \brief Simulated time charged for the construction of onions taken from the onion pool of ns3::Sink
+ */
+
+enum PoolCost {
+  ZeroCost = 0, //!< Onions taken from the pool are sent immediately
+  ModelledCost //!< Onions are sent after the ns3::Sink::OnionPoolLayerCost for each layer
+};
+
+/**
+ * 
+ * \ingroup enumerators
+ * \enum LayerCipher
+ * \brief AEAD encrypting the layers of onion messages, used by ns3::AeadOnionManager
+ */
+
+enum LayerCipher {
+  AesGcm = 0, //!< AES-256-GCM, falls back to ChaCha20-Poly1305 if the CPU has no AES instructions
+  ChaChaPoly, //!< ChaCha20-Poly1305 in the IETF variant
+  NullCipher //!< Layers are copied in clear without overhead, measures the cost of the routing alone
+};
+
+/**
+ * 
+ * \ingroup enumerators
+ * \enum WireFormat
+ * \brief Encoding of the messages sent in packets by nodes
+ */
+
+enum WireFormat {
+  ProtobufFormat = 0, //!< protobuf encoding of ns3::SerializationWrapper
+  BinaryFormat //!< fixed-layout binary encoding of ns3::BinaryWrapper
+};
+
 } // namespace ns3
 
 #endif /* ENUMS_H */
\ No newline at end of file
@@ -21,6 +21,8 @@
 
 #include "sensornode.h"
 
+#include <string.h>
+
 namespace ns3 {
 
 //Zagotovi, da se registrira TypeId
@@ -37,12 +39,24 @@ SensorNode::GetTypeId (void)
                           .AddAttribute ("SinkNodeAddress", "Address to send packets.",
                                          Ipv4AddressValue (Ipv4Address::GetAny ()),
                                          MakeIpv4AddressAccessor (&SensorNode::m_sinkAddress),
-                                         MakeIpv4AddressChecker ());
+                                         MakeIpv4AddressChecker ())
+                          .AddAttribute ("CircuitTableSize",
+                                         "Maximum number of circuits known by the node, the oldest "
+                                         "circuit is evicted",
+                                         UintegerValue (64),
+                                         MakeUintegerAccessor (&SensorNode::m_circuitTableSize),
+                                         MakeUintegerChecker<uint16_t> (1))
+                          .AddAttribute ("FailureNotice",
+                                         "Send a failure notice to the sink node when an onion is "
+                                         "dropped, otherwise the sink waits for the OnionTimeout",
+                                         BooleanValue (false),
+                                         MakeBooleanAccessor (&SensorNode::m_failureNotice),
+                                         MakeBooleanChecker ());
 
   return tid;
 }
 
-SensorNode::SensorNode ()
+SensorNode::SensorNode () : m_circuitTable (0)
 {
 }
 
@@ -56,14 +70,14 @@ SensorNode::~SensorNode ()
 void
 SensorNode::Handshake ()
 {
-  std::string pk = m_onionManager.GetPKtoString ();
+  std::string pk = m_onionManager->GetPKtoString ();
 
   //construct a new packet /w publickey type of sensor
-  protomessage::ProtoPacket handshake_message;
+  protomessage::ProtoPacket &handshake_message = *m_txMessage;
+  handshake_message.Clear ();
   handshake_message.mutable_h_shake ()->set_publickey (pk); //publickey
-  SerializationWrapper sw (handshake_message);
-  Ptr<Packet> p = Create<Packet> ();
-  p->AddHeader (sw);
+  Ptr<Packet> p = EncodePacket (&handshake_message);
+  ChargeCpu (CpuOperation::PacketSerialization, p->GetSize ());
 
   //send to the sink node
   InetSocketAddress remote (m_sinkAddress, m_port);
@@ -74,6 +88,12 @@ SensorNode::Handshake ()
   //Simulator::Schedule (Seconds (60), &Wsn_node::ActivateNode, this);
 }
 
+bool
+SensorNode::IsExpectedOnion (int onionId)
+{
+  return onionId == m_onionValidator->GetOnionSeq ();
+}
+
 //callback, when the onion is received
 void
 SensorNode::ReceivePacket (Ptr<Socket> socket)
@@ -84,44 +104,112 @@ SensorNode::ReceivePacket (Ptr<Socket> socket)
   if (p != NULL)
     {
       NotifyRx (p);
-      SerializationWrapper sw;
-      //get the onion message
-      protomessage::ProtoPacket onion;
-      p->RemoveHeader (sw);
-      sw.GetData (&onion);
+      if (DropGhostOnion (p))
+        {
+          return;
+        }
+      //get the onion message, parsed straight from the packet
+      protomessage::ProtoPacket &onion = *m_rxMessage;
+      OnionPadding padding;
+      uint32_t packetSize = p->GetSize ();
+      bool parsed = DecodePacket (p, &onion, &padding);
+      //the virtual padding of the binary format is left in the packet, it is not decoded
+      bool virtualPadding = m_wireFormat == WireFormat::BinaryFormat;
+      double decodingEnergy =
+          ChargeCpu (CpuOperation::PacketDeserialization, packetSize - p->GetSize ());
+      if (!parsed)
+        {
+          NS_LOG_WARN ("Malformed packet deleted, at ip: " << m_address);
+          return;
+        }
+
+      //the sink replied to the handshake with its publickey
+      if (onion.has_h_shake ())
+        {
+          if (!m_onionManager->SetPeerPublicKey (onion.h_shake ().publickey ()))
+            {
+              NS_LOG_WARN ("Invalid public key of the sink, at ip: " << m_address);
+            }
+          return;
+        }
 
       //get the onion ID
       o_sequenceNum = onion.mutable_o_head ()->onionid ();
 
-      if (o_sequenceNum == m_onionValidator->GetOnionSeq ())
+      if (IsExpectedOnion (o_sequenceNum))
         { //message IDs are equal
 
           //Call that the onion was received
           m_outputManager->OnionRoutingRecv (Simulator::Now ());
+          m_outputManager->AddOnionEnergy (decodingEnergy);
           Wsn_node::OnionReceived ();
 
           //Process onion head and get next hop IP address
-          uint32_t ip = ProcessOnionHead (onion.mutable_o_head ());
+          uint32_t ip;
+          uint32_t outerLen = onion.o_head ().onion_message ().length ();
+          bool valid = m_circuitMode ? ProcessCircuitHead (onion.mutable_o_head (), ip)
+                                     : ProcessOnionHead (onion.mutable_o_head (), ip);
+          if (!valid)
+            {
+              //do not forward garbage, the onion can not reach the sink
+              DropOnion ();
+              return;
+            }
+
+          //grow the padding by the bytes of the removed layer
+          if (padding.head)
+            {
+              padding.headLen += outerLen - onion.o_head ().onion_message ().length ();
+            }
 
           //ProcessOnionHead();
           ProcessOnionBody (onion.mutable_o_body ());
 
-          //create the packet
-          Ptr<Packet> np = Create<Packet> ();
-          sw.SetData (onion);
-          np = Create<Packet> ();
-
-          np->AddHeader (sw);
-
-          //send further the message
+          //create the packet, or rewrite the fields before the virtual padding of the received one
+          Ptr<Packet> np;
+          uint32_t virtualBytes = 0;
+          if (virtualPadding)
+            {
+              //tags of the previous hop, the segment tag would break the reassembly
+              p->RemoveAllByteTags ();
+              p->RemoveAllPacketTags ();
+              if (padding.GetSize () > p->GetSize ())
+                {
+                  //zero-filled, adjacent to the zero area of the padding
+                  p->AddAtEnd (Create<Packet> (padding.GetSize () - p->GetSize ()));
+                }
+              BinaryWrapper bw;
+              bw.SetPadding (padding);
+              bw.SetData (onion);
+              p->AddHeader (bw);
+              np = p;
+              virtualBytes = padding.GetSize ();
+            }
+          else
+            {
+              np = EncodePacket (&onion, padding);
+            }
+          ChargeOnionCpu (CpuOperation::PacketSerialization, np->GetSize () - virtualBytes);
+
+          //send further the message, after the simulated decryption time if it is charged
           InetSocketAddress remote (Ipv4Address (ip), m_port);
           NotifyTx (p);
-          Wsn_node::SendSegment (remote, np, true);
+          Time delay = m_onionManager->TakeProcessingDelay ();
+          if (delay.IsStrictlyPositive ())
+            {
+              Simulator::Schedule (delay, &Wsn_node::SendSegment, this, remote, np, true);
+            }
+          else
+            {
+              Wsn_node::SendSegment (remote, np, true);
+            }
 
           ///Log details about the onion
           m_outputManager->OnionRoutingSend (
-              m_address, Ipv4Address (ip), np->GetSize (), onion.mutable_o_head ()->ByteSizeLong (),
-              onion.mutable_o_body ()->ByteSizeLong (), Simulator::Now ());
+              m_address, Ipv4Address (ip), np->GetSize (),
+              onion.mutable_o_head ()->ByteSizeLong () + (virtualPadding ? padding.headLen : 0),
+              onion.mutable_o_body ()->ByteSizeLong () + (virtualPadding ? padding.bodyLen : 0),
+              Simulator::Now ());
         }
       else
         { //the onion should be deleted
@@ -132,46 +220,117 @@ SensorNode::ReceivePacket (Ptr<Socket> socket)
     }
 }
 
-uint32_t
-SensorNode::ProcessOnionHead (protomessage::ProtoPacket_OnionHead *onionHead)
+bool
+SensorNode::ProcessOnionHead (protomessage::ProtoPacket_OnionHead *onionHead, uint32_t &ip)
 {
-  std::string onion = onionHead->onion_message ();
+  //work on the string of the message, the head is not copied
+  std::string *onion = onionHead->mutable_onion_message ();
+
+  //decrypt the onion in place, the layer refers to the memory of the onion string
+  ChargeOnionCpu (CpuOperation::LayerDecryption, onion->length ());
+  orLayer onionLayer = m_onionManager->PeelOnionInPlace (
+      reinterpret_cast<uint8_t *> (&(*onion)[0]), onion->length (), m_onionManager->GetPK (),
+      m_onionManager->GetDecryptionKey ());
+  if (m_onionManager->GetErrno () != OnionRouting::ERROR_NOTERROR)
+    {
+      return false;
+    }
+
+  //resolve the next hop from the onion to uint32
+  ip = m_nodeIds.Decode (onionLayer.nextHopIP).Get ();
+  //keep only the inner layer, moved to the front of the string without reallocating
+  onion->assign (reinterpret_cast<char *> (onionLayer.innerLayer), onionLayer.innerLayerLen);
 
-  //get length in bytes of the onion
-  int outer_layer_len = onion.length ();
+  return true;
+}
 
-  //get previous padding
-  if (onionHead->has_padding ())
+bool
+SensorNode::ProcessCircuitHead (protomessage::ProtoPacket_OnionHead *onionHead, uint32_t &ip)
+{
+  std::string *cell = onionHead->mutable_onion_message ();
+  if (cell->length () < Circuit::ID_BYTES)
     {
-      outer_layer_len += onionHead->padding ().length ();
+      return false;
     }
 
-  //decrypt the onion
-  unsigned char *serialized_onion = m_onionManager.StringToUchar (onion);
-  orLayer *onionLayer = m_onionManager.PeelOnion (serialized_onion, onion.length (),
-                                                  m_onionManager.GetPK (), m_onionManager.GetSK ());
+  uint8_t *data = reinterpret_cast<uint8_t *> (&(*cell)[0]);
+  uint32_t id = Circuit::ReadId (data);
 
-  //convert ip from the onion to uint32
-  uint32_t ip = DeserializeIpv4ToInt (onionLayer->nextHopIP);
-  //convert onion to string for serialization
-  onion = m_onionManager.UcharToString (onionLayer->innerLayer, onionLayer->innerLayerLen);
-
-  //mount the onion head
-  onionHead->set_onion_message (onion);
+  if (id == Circuit::SETUP_ID)
+    {
+      //public-key layer, the content holds the circuit of this node
+      uint16_t onionLen = cell->length () - Circuit::ID_BYTES;
+      ChargeOnionCpu (CpuOperation::LayerDecryption, onionLen);
+      orLayer onionLayer = m_onionManager->PeelOnionInPlace (
+          data + Circuit::ID_BYTES, onionLen, m_onionManager->GetPK (),
+          m_onionManager->GetDecryptionKey ());
+      if (m_onionManager->GetErrno () != OnionRouting::ERROR_NOTERROR ||
+          onionLayer.innerLayerLen < Circuit::SETUP_CONTENT_BYTES)
+        {
+          return false;
+        }
 
-  //add padding if set
-  if (onionHead->has_padding ())
+      CircuitHop hop;
+      ip = m_nodeIds.Decode (onionLayer.nextHopIP).Get ();
+      hop.nextHop = ip;
+      Circuit::ReadSetupContent (onionLayer.innerLayer, id, hop);
+      m_circuitTable.Add (id, hop);
+
+      //forward the rest of the setup onion behind SETUP_ID
+      uint16_t innerLen = onionLayer.innerLayerLen - Circuit::SETUP_CONTENT_BYTES;
+      memmove (data + Circuit::ID_BYTES, onionLayer.innerLayer + Circuit::SETUP_CONTENT_BYTES,
+               innerLen);
+      cell->resize (Circuit::ID_BYTES + innerLen);
+    }
+  else
     {
-      std::string padding (outer_layer_len - onion.length (), '0');
-      onionHead->set_padding (padding);
+      const CircuitHop *hop = m_circuitTable.Find (id);
+      if (hop == nullptr)
+        {
+          return false;
+        }
+      uint16_t layerLen = cell->length () - Circuit::ID_BYTES;
+      ChargeOnionCpu (CpuOperation::CircuitDecryption, layerLen - Circuit::LAYER_OVERHEAD);
+      if (!Circuit::OpenLayer (data + Circuit::ID_BYTES, layerLen, hop->key, id))
+        {
+          return false;
+        }
+      ip = hop->nextHop;
+
+      //the circuit id of the next hop takes the place of the nonce and the mac
+      Circuit::WriteId (data + Circuit::LAYER_OVERHEAD, hop->nextId);
+      cell->erase (0, Circuit::LAYER_OVERHEAD);
     }
 
-  //release memory
-  delete[] onionLayer->nextHopIP;
-  delete onionLayer;
-  delete[] serialized_onion;
+  return true;
+}
+
+void
+SensorNode::DropOnion ()
+{
+  NS_LOG_WARN ("Onion dropped, the layer can not be processed, with onion id: "
+               << o_sequenceNum << ", at ip: " << m_address
+               << ", at time: " << std::to_string (Simulator::Now ().GetSeconds ()));
+  m_outputManager->DropOnion (m_address, Simulator::Now ());
 
-  return ip;
+  if (m_failureNotice)
+    {
+      //an onion head carrying only the onion id
+      protomessage::ProtoPacket &notice = *m_txMessage;
+      notice.Clear ();
+      notice.mutable_o_head ()->set_onionid (o_sequenceNum);
+      Ptr<Packet> p = EncodePacket (&notice);
+      ChargeOnionCpu (CpuOperation::PacketSerialization, p->GetSize ());
+
+      InetSocketAddress remote (m_sinkAddress, m_port);
+      Wsn_node::SendSegment (remote, p, false);
+    }
+  else
+    {
+      //no node receives the onion anymore, it is aborted after the OnionTimeout
+      Simulator::Schedule (Seconds (m_onionTimeout), &Wsn_node::CheckSentOnion, this,
+                           m_onionValidator->OnionHopCount ());
+    }
 }
 
 void
@@ -188,20 +347,6 @@ SensorNode::ProcessOnionBody (protomessage::ProtoPacket_OnionBody *onionBody)
     }
 }
 
-uint32_t
-SensorNode::DeserializeIpv4ToInt (uint8_t *buff)
-{
-  uint32_t ip = 0;
-  ip += buff[0];
-  ip = ip << 8;
-  ip += buff[1];
-  ip = ip << 8;
-  ip += buff[2];
-  ip = ip << 8;
-  ip += buff[3];
-  return ip;
-}
-
 //callback, at a new connection
 void
 SensorNode::Accept (Ptr<Socket> socket, const ns3::Address &from)
@@ -215,9 +360,7 @@ SensorNode::StartApplication (void)
 {
   //basic configuration
   Wsn_node::Configure ();
-
-  //Generate encryption keys
-  m_onionManager.GenerateNewKeyPair ();
+  m_circuitTable.SetCapacity (m_circuitTableSize);
 
   uint32_t delay = Wsn_node::getNodeDelay (m_address);
 
@@ -29,6 +29,7 @@
 #include <sodium.h>
 #include "ns3/proto-packet.pb.h"
 #include "ns3/serializationwrapper.h"
+#include "ns3/circuit.h"
 #include "ns3/wsn_node.h"
 
 namespace ns3 {
@@ -85,17 +86,52 @@ public:
 
   void ReceivePacket (Ptr<Socket> socket);
 
+  /**
+ *  \brief The node expects the running onion, see ns3::Wsn_node::IsExpectedOnion()
+ * 
+ *  \param [in] onionId the onion id
+ * 
+ *  \return true if \p onionId is the ns3::OnionValidator::GetOnionSeq()
+ */
+
+  virtual bool IsExpectedOnion (int onionId);
+
   /**
  *  \brief Decrypt the outer layer of the onion head, obtain the information of the next IP address, 
- *         reasemble the onion head by including padding if required.
+ *         keep the inner layer in the onion head. The caller grows the padding by the removed bytes.
  *              
  * 
  *  \param [in] onionHead pionter to the protobuf object holding informations of the onion head
+ *  \param [out] ip the IpV4 address of the next hop as an unisgned integer of 32b
  * 
- *  \return an IpV4 address as an unisgned integer of 32b
+ *  \return false if the layer is corrupted or not addressed to the node, the onion must be deleted
  */
 
-  uint32_t ProcessOnionHead (protomessage::ProtoPacket_OnionHead *onionHead);
+  bool ProcessOnionHead (protomessage::ProtoPacket_OnionHead *onionHead, uint32_t &ip);
+
+  /**
+ *  \brief Delete the onion whose layer can not be processed, instead of forwarding it.
+ *         Send a failure notice to the sink node if ns3::SensorNode::FailureNotice is set,
+ *         otherwise the onion is aborted after the OnionTimeout, as if it was lost.
+ * 
+ */
+
+  void DropOnion (void);
+
+  /**
+ *  \brief Process the cell of a circuit carried in the onion head, see ns3::Circuit.
+ *         The setup onion is peeled as in ns3::SensorNode::ProcessOnionHead() and the circuit is stored
+ *         in \p m_circuitTable, otherwise the symmetric layer of the circuit is removed and the circuit id
+ *         of the next hop is written in front of the inner layer. The caller grows the padding as for ns3::SensorNode::ProcessOnionHead().
+ *              
+ * 
+ *  \param [in] onionHead pionter to the protobuf object holding informations of the onion head
+ *  \param [out] ip the IpV4 address of the next hop as an unisgned integer of 32b
+ * 
+ *  \return false if the circuit is unknown or the layer is not authentic, the onion must be deleted
+ */
+
+  bool ProcessCircuitHead (protomessage::ProtoPacket_OnionHead *onionHead, uint32_t &ip);
 
   /**
  *  \brief If the onion body contains the aggregated value, 
@@ -119,17 +155,6 @@ public:
 
   void Accept (Ptr<Socket> socket, const ns3::Address &from);
 
-  /**
- *  \brief Convert an IPV4 address given as a buffer
- * 
- *  \param [in] buff pointer to an array containing an IpV4 address
- *  
- *  \return an IpV4 address as an unisgned integer of 32b
- * 
- */
-
-  uint32_t DeserializeIpv4ToInt (uint8_t *buff);
-
 private:
   /**
   *
@@ -158,6 +183,9 @@ private:
   void Handshake (void);
 
   Ipv4Address m_sinkAddress; //!<  address of the sink node
+  uint16_t m_circuitTableSize; //!< maximum number of circuits known by the node
+  CircuitTable m_circuitTable; //!< circuits installed by setup onions, if ns3::Wsn_node::Circuits is set
+  bool m_failureNotice; //!< send a failure notice to the sink when an onion is dropped
   //the reading of the sensor
   uint32_t m_sensorValue = 20; //!< dummy reading of a sensor equipped on the node
 };
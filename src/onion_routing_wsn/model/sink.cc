@@ -55,12 +55,47 @@ Sink::GetTypeId (void)
           .AddAttribute (
               "BodySize", "Size of the onion body maintained fixed during the simulation",
               TypeId::ATTR_CONSTRUCT | TypeId::ATTR_SET | TypeId::ATTR_GET, UintegerValue (128),
-              MakeUintegerAccessor (&Sink::m_bodySize), MakeUintegerChecker<uint16_t> ());
+              MakeUintegerAccessor (&Sink::m_bodySize), MakeUintegerChecker<uint16_t> ())
+          .AddAttribute ("OnionPoolSize",
+                         "Number of onions built in advance by a background worker for each path "
+                         "length, 0 builds each onion when it is sent",
+                         UintegerValue (0), MakeUintegerAccessor (&Sink::m_poolSize),
+                         MakeUintegerChecker<uint16_t> ())
+          .AddAttribute ("OnionPoolThreads",
+                         "Number of threads building the onions of the pool, 0 uses the hardware "
+                         "concurrency",
+                         UintegerValue (0), MakeUintegerAccessor (&Sink::m_poolThreads),
+                         MakeUintegerChecker<uint16_t> ())
+          .AddAttribute ("OnionPoolCost", "Simulated time charged for onions taken from the pool",
+                         EnumValue (PoolCost::ZeroCost), MakeEnumAccessor (&Sink::m_poolCost),
+                         MakeEnumChecker (PoolCost::ZeroCost, "zero", PoolCost::ModelledCost,
+                                          "modelled"))
+          .AddAttribute ("OnionPoolLayerCost",
+                         "Simulated time charged for each layer of onions taken from the pool, "
+                         "modelled cost",
+                         TimeValue (MilliSeconds (28)), MakeTimeAccessor (&Sink::m_poolLayerCost),
+                         MakeTimeChecker ())
+          .AddAttribute ("SuffixCacheSize",
+                         "Bytes of encrypted inner layers cached for reuse by onions whose routes "
+                         "share the last hops, 0 disables the cache",
+                         UintegerValue (0), MakeUintegerAccessor (&Sink::m_suffixCacheSize),
+                         MakeUintegerChecker<uint32_t> ())
+          .AddAttribute ("CircuitUses",
+                         "Onions sent along a circuit, the setup onion included, before the circuit "
+                         "is rotated",
+                         UintegerValue (10), MakeUintegerAccessor (&Sink::m_circuitUses),
+                         MakeUintegerChecker<uint32_t> (1))
+          .AddAttribute ("CircuitLifetime", "Time after which a circuit is rotated",
+                         TimeValue (Seconds (300)), MakeTimeAccessor (&Sink::m_circuitLifetime),
+                         MakeTimeChecker ());
 
   return tid;
 }
 
 Sink::Sink ()
+    : m_keyRing (NodeIdTable (), OnionManager::LAYER_KEY_BYTES),
+      m_route (4, OnionManager::LAYER_KEY_BYTES),
+      m_suffixCache (0)
 {
 }
 
@@ -89,6 +124,13 @@ Sink::Accept (Ptr<Socket> socket, const ns3::Address &from)
   socket->SetRecvCallback (MakeCallback (&Sink::ReceivePacket, this));
 }
 
+bool
+Sink::IsExpectedOnion (int onionId)
+{
+  //m_onionId is larger for one value
+  return onionId == m_onionId - 1;
+}
+
 //callback, when a new packet is received
 
 void
@@ -100,29 +142,49 @@ Sink::ReceivePacket (Ptr<Socket> socket)
   if (p != NULL)
     {
       NotifyRx (p);
+      if (DropGhostOnion (p))
+        {
+          return;
+        }
 
       InetSocketAddress address = InetSocketAddress::ConvertFrom (from);
-      SerializationWrapper sw;
-      p->RemoveHeader (sw);
-      protomessage::ProtoPacket message;
-      sw.GetData (&message);
+      protomessage::ProtoPacket &message = *m_rxMessage;
+      uint32_t packetSize = p->GetSize ();
+      bool parsed = DecodePacket (p, &message);
+      double decodingEnergy = ChargeCpu (CpuOperation::PacketDeserialization, packetSize);
+      if (!parsed)
+        {
+          NS_LOG_WARN ("Malformed packet deleted, at ip: " << m_address);
+          return;
+        }
 
       if (message.has_h_shake ())
         {
           //register node
           RecvHandshake (message.mutable_h_shake (), address);
         }
+      else if (!message.o_head ().has_onion_message ())
+        {
+          //a sensor node dropped the onion
+          RecvFailureNotice (message.o_head ().onionid ());
+        }
       else //onion message
         {
           //get the onion ID
           o_sequenceNum = message.mutable_o_head ()->onionid ();
 
           //
-          if (o_sequenceNum == m_onionId - 1)
-            { //message IDs are equal, -1 since m_onionId is larger for one value
+          if (IsExpectedOnion (o_sequenceNum))
+            { //message IDs are equal
 
               //call that onion was received
               Wsn_node::OnionReceived ();
+              m_outputManager->AddOnionEnergy (decodingEnergy);
+
+              if (m_circuitMode)
+                {
+                  RecvCircuitCell (message.mutable_o_head ());
+                }
 
               RecvOnion (message.mutable_o_body ());
             }
@@ -142,7 +204,30 @@ void
 Sink::RecvHandshake (protomessage::ProtoPacket_Handshake *handshake_message, InetSocketAddress from)
 {
   std::string pk = handshake_message->publickey ();
+  //precompute the key of layers addressed to the node
+  std::string layerKey = m_onionManager->LayerKey (pk);
+  if (layerKey.empty ())
+    {
+      NS_LOG_WARN ("Handshake with an invalid public key ignored, from ip: " << from.GetIpv4 ());
+      return;
+    }
   m_nodeManager[from.GetIpv4 ().Get ()] = pk;
+  m_keyRing.SetKey (from.GetIpv4 (), layerKey);
+  //cached layers may be encrypted with a previous key of the node
+  m_suffixCache.Clear ();
+
+  //the node needs the publickey of the sink to compute the shared key
+  if (m_onionMode == OnionMode::SharedKey)
+    {
+      protomessage::ProtoPacket &reply = *m_txMessage;
+      reply.Clear ();
+      reply.mutable_h_shake ()->set_publickey (m_publickey);
+      Ptr<Packet> p = EncodePacket (&reply);
+      ChargeCpu (CpuOperation::PacketSerialization, p->GetSize ());
+
+      InetSocketAddress remote (from.GetIpv4 (), m_port);
+      Wsn_node::SendSegment (remote, p, false);
+    }
 
   //print output to file
   m_outputManager->NewHandshake (m_nodeManager.size () - 1, from.GetIpv4 (), Simulator::Now ());
@@ -158,6 +243,42 @@ Sink::RecvOnion (protomessage::ProtoPacket_OnionBody *onion_body)
   Simulator::Schedule (Seconds (0.5), &Sink::SinkTasks, this);
 }
 
+void
+Sink::RecvCircuitCell (protomessage::ProtoPacket_OnionHead *onion_head)
+{
+  Circuit &circuit = m_circuits[m_onionLengthIndex];
+  std::string *cell = onion_head->mutable_onion_message ();
+  uint8_t *data = reinterpret_cast<uint8_t *> (&(*cell)[0]);
+
+  //the setup onion traversed the route, each hop stored its circuit
+  if (cell->length () >= Circuit::ID_BYTES && Circuit::ReadId (data) == Circuit::SETUP_ID)
+    {
+      circuit.SetEstablished (true);
+      return;
+    }
+
+  ChargeOnionCpu (CpuOperation::CircuitDecryption, 0);
+  if (!circuit.OpenCell (data, cell->length ()))
+    {
+      NS_LOG_WARN ("Cell of the circuit not authentic at the sink, the circuit is rotated");
+      circuit.SetEstablished (false);
+    }
+}
+
+void
+Sink::RecvFailureNotice (int onionId)
+{
+  m_outputManager->FailureNotice (Simulator::Now ());
+
+  //the notice of an onion already aborted by the timeout is ignored
+  if (onionId == m_onionId - 1 && m_onionValidator->OnionStatus ())
+    {
+      m_onionValidator->AbortOnion ();
+      m_outputManager->AbortOnion (Simulator::Now ());
+      ResendOnion ();
+    }
+}
+
 //defines the behaviour of the source how many OR sends, how to build the route ecc...
 void
 Sink::SinkTasks ()
@@ -169,11 +290,29 @@ Sink::SinkTasks ()
       if (m_repeateCount < m_repeateTimes)
         {
 
-          //selet the route of the onion
-          int route[m_onionPathLengths[m_onionLengthIndex]];
-          SelectRoute (route, m_onionPathLengths[m_onionLengthIndex]);
-          //send the onion
-          PrepareOnion (route, m_onionPathLengths[m_onionLengthIndex]);
+          if (m_poolSize > 0 && !m_circuitMode && !m_onionPool.IsRunning ())
+            {
+              StartOnionPool ();
+            }
+
+          if (m_circuitMode)
+            {
+              //the onion is a cell of the circuit of the current path length
+              SendCircuitOnion ();
+            }
+          else if (m_onionPool.IsRunning ())
+            {
+              //the onion was built in advance
+              SendPooledOnion ();
+            }
+          else
+            {
+              //selet the route of the onion
+              int route[m_onionPathLengths[m_onionLengthIndex]];
+              SelectRoute (route, m_onionPathLengths[m_onionLengthIndex]);
+              //send the onion
+              PrepareOnion (route, m_onionPathLengths[m_onionLengthIndex]);
+            }
 
           m_repeateCount++;
         }
@@ -188,6 +327,15 @@ Sink::SinkTasks ()
     {
       //simulation ended, can print details of nodes
       m_outputManager->PrintNodeDetails (m_nodeManager);
+      m_outputManager->PrintDropStatistics ();
+
+      if (m_suffixCacheSize > 0)
+        {
+          NS_LOG_INFO ("Suffix cache hits: " << m_suffixCache.GetHits ()
+                                             << " misses: " << m_suffixCache.GetMisses ()
+                                             << " layer hit rate: "
+                                             << m_suffixCache.GetLayerHitRate ());
+        }
 
       //end simulation
       Simulator::Stop ();
@@ -229,64 +377,291 @@ Sink::SelectRoute (int *route, int routeLen)
 void
 Sink::PrepareOnion (int *route, int routeLen)
 {
-  int cipherLen = m_onionManager.OnionLength (routeLen + 1, 0, 0);
+  int cipherLen = m_onionManager->OnionLength (routeLen + 1, 0, 0);
   unsigned char cipher[cipherLen];
 
-  unsigned char *ipRoute[routeLen + 1];
+  FillRoute (m_route, route, routeLen);
 
-  unsigned char *keys[routeLen + 1];
+  //the Sphinx onion head has no self-contained inner layers
+  bool useCache = m_suffixCacheSize > 0 && m_onionMode != OnionMode::Sphinx;
+  //the specialized builder carries full ipv4 addresses, its route descriptor and suffix cache
+  //overloads derive the offsets of the layers at compile time
+  bool useBuilder = m_onionMode == OnionMode::SealedBox && m_addressEncoding == ONION_IPV4;
+  uint64_t encryptedLayers = m_suffixCache.GetEncryptedLayers ();
+
+  if (useBuilder && useCache)
+    {
+      m_onionBuilder.BuildOnion (cipher, m_route, m_suffixCache);
+    }
+  else if (useBuilder)
+    {
+      m_onionBuilder.BuildOnion (cipher, m_route);
+    }
+  else if (useCache)
+    {
+      m_onionManager->BuildOnion (cipher, m_route, m_suffixCache);
+    }
+  else
+    {
+      m_onionManager->BuildOnion (cipher, m_route);
+    }
 
-  //sink details
-  keys[routeLen] = m_onionManager.StringToUchar (m_publickey);
-  ipRoute[routeLen] =
-      m_onionManager.IpToBuff (m_address.Get ()); //set sink node as the last node in the onion path
+  //a failed onion is neither charged nor sent, CheckOnion starts it again
+  enum OnionRouting::OnionErrno status =
+      useBuilder ? m_onionBuilder.GetErrno () : m_onionManager->GetErrno ();
+  if (status != OnionRouting::ERROR_NOTERROR)
+    {
+      NS_LOG_WARN ("Construction of the onion failed with error: " << status);
+      m_onionManager->TakeProcessingDelay ();
+      return;
+    }
 
-  //define an iterator
-  std::map<uint32_t, std::string>::iterator item;
+  //layers taken from the cache are not encrypted again
+  if (useCache)
+    {
+      ChargeOnionConstruction (m_suffixCache.GetEncryptedLayers () - encryptedLayers, cipherLen,
+                               0);
+    }
+  else
+    {
+      ChargeOnionConstruction (routeLen, cipherLen, 0);
+    }
 
-  //fill other addresses and publickeys
+  uint32_t firstHop = m_keyRing.GetAddress (route[0]).Get ();
+  std::string str_cipher = m_onionManager->UcharToString (cipher, cipherLen);
+
+  //defer the onion by the simulated construction time, if the encryption is charged
+  DispatchOnion (firstHop, routeLen, str_cipher, m_onionManager->TakeProcessingDelay ());
+}
+
+void
+Sink::FillRoute (OnionRouteDescriptor &descriptor, int *route, int routeLen)
+{
+  //node ids are indexes in m_nodeManager, the key ring is ordered the same way
+  descriptor.Clear ();
   for (int i = 0; i < routeLen; ++i)
     {
-      item = m_nodeManager.begin ();
-      std::advance (item, route[i]);
+      descriptor.AddHop (m_keyRing.GetSerializedAddress (route[i]), m_keyRing.GetKey (route[i]));
+    }
 
-      ipRoute[i] = m_onionManager.IpToBuff (item->first);
+  //set sink node as the last node in the onion path
+  uint8_t sinkAddress[4];
+  m_nodeIds.Encode (m_address, sinkAddress);
+  descriptor.AddHop (sinkAddress, (const uint8_t *) m_sinkLayerKey.data ());
+}
 
-      keys[i] = m_onionManager.StringToUchar (item->second);
+void
+Sink::ChargeOnionConstruction (uint16_t layers, uint16_t cipherLen, uint16_t layerContentLen)
+{
+  //layers shrink from the outermost by a seal, an address and the content, the Sphinx head is of
+  //constant size
+  uint16_t seal = 0;
+  uint16_t step = 0;
+  if (m_onionMode != OnionMode::Sphinx)
+    {
+      seal = m_onionManager->m_sealPadding;
+      step = seal + m_nodeIds.GetAddressSize () + layerContentLen;
     }
+  for (uint16_t i = 0; i < layers; ++i)
+    {
+      ChargeOnionCpu (CpuOperation::LayerEncryption, cipherLen - i * step - seal);
+    }
+}
 
-  m_onionManager.BuildOnion (cipher, ipRoute, keys, routeLen + 1);
+void
+Sink::DispatchOnion (uint32_t firstHop, int routeLen, std::string str_cipher, Time delay)
+{
+  if (delay.IsStrictlyPositive ())
+    {
+      //the onion is running, CheckOnion must not start another one meanwhile
+      m_onionValidator->StartOnion (m_onionId);
+      Simulator::Schedule (delay, &Sink::SendOnion, this, firstHop, routeLen, str_cipher);
+    }
+  else
+    {
+      SendOnion (firstHop, routeLen, str_cipher);
+    }
+}
+
+void
+Sink::StartOnionPool ()
+{
+  //the worker needs the reentrant construction of onions
+  const OnionRouting *builder;
+  switch (m_onionMode)
+    {
+    case OnionMode::SealedBox:
+      //the specialized builder carries full ipv4 addresses
+      if (m_addressEncoding == ONION_IPV4)
+        {
+          builder = &m_onionBuilder;
+        }
+      else
+        {
+          builder = PeekPointer (m_onionManager);
+        }
+      break;
+    case OnionMode::SharedKey:
+    case OnionMode::Aead:
+      builder = PeekPointer (m_onionManager);
+      break;
+    default:
+      NS_LOG_WARN ("The onion pool is not supported in this onion mode, onions are built when sent");
+      m_poolSize = 0;
+      return;
+    }
 
-  item = m_nodeManager.begin ();
-  std::advance (item, route[0]);
-  SendOnion (item->first, routeLen, cipher, cipherLen);
+  m_onionPool.Start (builder, m_numOnionLengths, m_poolThreads);
+  for (uint16_t pool = 0; pool < m_numOnionLengths; ++pool)
+    {
+      for (int i = 0; i < std::min<int> (m_poolSize, m_repeateTimes); ++i)
+        {
+          SubmitPooledOnion (pool);
+        }
+    }
+}
 
-  //release memory
-  for (int i = 0; i < routeLen; ++i)
+void
+Sink::SubmitPooledOnion (uint16_t pool)
+{
+  uint16_t routeLen = m_onionPathLengths[pool];
+  int route[routeLen];
+  SelectRoute (route, routeLen);
+
+  std::shared_ptr<PooledOnion> onion (new PooledOnion (m_nodeIds.GetAddressSize (), OnionManager::LAYER_KEY_BYTES));
+  FillRoute (onion->route, route, routeLen);
+  onion->firstHop = m_keyRing.GetAddress (route[0]).Get ();
+  onion->cipher.resize (m_onionManager->OnionLength (routeLen + 1, 0, 0));
+
+  m_onionPool.Submit (pool, onion);
+}
+
+void
+Sink::SendPooledOnion ()
+{
+  uint16_t pool = m_onionLengthIndex;
+  uint16_t routeLen = m_onionPathLengths[pool];
+
+  //an aborted onion is sent again, the pool may be empty
+  if (m_onionPool.GetPending (pool) == 0)
+    {
+      SubmitPooledOnion (pool);
+    }
+  std::shared_ptr<PooledOnion> onion = m_onionPool.Take (pool);
+  if (onion->status != OnionRouting::ERROR_NOTERROR)
+    {
+      NS_LOG_WARN ("Construction of a pooled onion failed with error: " << onion->status);
+      return;
+    }
+
+  //keep in the pool the onions still to send at this path length
+  int remaining = m_repeateTimes - m_repeateCount - 1;
+  while ((int) m_onionPool.GetPending (pool) < std::min<int> (m_poolSize, remaining))
+    {
+      SubmitPooledOnion (pool);
+    }
+
+  //the layers were encrypted in the background by the CPU of the sink
+  ChargeOnionConstruction (routeLen, onion->cipher.size (), 0);
+
+  //the wall-clock time of the construction is not charged, it would depend on the host
+  Time delay = Seconds (0);
+  switch (m_poolCost)
+    {
+    case PoolCost::ModelledCost:
+      delay = NanoSeconds (m_poolLayerCost.GetNanoSeconds () * routeLen);
+      break;
+    case PoolCost::ZeroCost:
+    default:
+      break;
+    }
+
+  DispatchOnion (onion->firstHop, routeLen, onion->cipher, delay);
+}
+
+void
+Sink::SendCircuitOnion ()
+{
+  if (m_circuits.size () != m_numOnionLengths)
+    {
+      m_circuits.resize (m_numOnionLengths);
+    }
+  Circuit &circuit = m_circuits[m_onionLengthIndex];
+  uint16_t routeLen = m_onionPathLengths[m_onionLengthIndex];
+
+  //rotate the circuit after CircuitUses onions or CircuitLifetime
+  if (!circuit.IsEstablished () || circuit.GetUses () >= m_circuitUses ||
+      Simulator::Now () - circuit.GetCreationTime () >= m_circuitLifetime)
+    {
+      int route[routeLen];
+      SelectRoute (route, routeLen);
+      BuildCircuit (route, routeLen);
+      return;
+    }
+
+  std::string cell (circuit.GetCellLength (), 0);
+  if (!circuit.BuildCell (reinterpret_cast<uint8_t *> (&cell[0])))
+    {
+      NS_LOG_WARN ("Encryption of a cell of the circuit failed");
+    }
+  //the layer of hop i wraps the layers of the following hops
+  for (uint16_t i = 0; i < circuit.GetHops (); ++i)
     {
-      delete[] keys[i];
+      ChargeOnionCpu (CpuOperation::CircuitEncryption,
+                      (circuit.GetHops () - 1 - i) * Circuit::LAYER_OVERHEAD);
     }
+
+  SendOnion (circuit.GetFirstHop (), routeLen, cell);
 }
 
 void
-Sink::SendOnion (uint32_t firstHop, int routeLen, unsigned char *cipher, int cipherLen)
+Sink::BuildCircuit (int *route, int routeLen)
 {
-  //first convert cipher to string!!
-  std::string str_cipher = m_onionManager.UcharToString (cipher, cipherLen);
-  protomessage::ProtoPacket onion;
+  Circuit &circuit = m_circuits[m_onionLengthIndex];
+  uint16_t hops = routeLen + 1;
+  uint32_t firstHop = m_keyRing.GetAddress (route[0]).Get ();
+
+  FillRoute (m_route, route, routeLen);
+  //ids and keys are drawn from the streams of the simulation seed
+  Ptr<UniformRandomVariable> x = CreateObject<UniformRandomVariable> ();
+  circuit.Create (hops, firstHop, Simulator::Now (), x);
+
+  //each layer of the setup onion carries the circuit of its hop
+  std::vector<uint8_t> content (hops * Circuit::SETUP_CONTENT_BYTES);
+  std::vector<uint8_t *> layerContent (hops);
+  circuit.FillSetupContent (&content[0]);
+  for (uint16_t i = 0; i < hops; ++i)
+    {
+      layerContent[i] = &content[i * Circuit::SETUP_CONTENT_BYTES];
+    }
+
+  uint16_t onionLen = m_onionManager->OnionLength (hops, Circuit::SETUP_CONTENT_BYTES, 0);
+  std::string cell (Circuit::ID_BYTES + onionLen, 0);
+  Circuit::WriteId (reinterpret_cast<uint8_t *> (&cell[0]), Circuit::SETUP_ID);
+  m_onionManager->BuildOnion (reinterpret_cast<uint8_t *> (&cell[Circuit::ID_BYTES]),
+                              m_route.GetRoute (), m_route.GetKeys (), &layerContent[0],
+                              Circuit::SETUP_CONTENT_BYTES, hops);
+  ChargeOnionConstruction (hops, onionLen, Circuit::SETUP_CONTENT_BYTES);
+
+  DispatchOnion (firstHop, routeLen, cell, m_onionManager->TakeProcessingDelay ());
+}
+
+void
+Sink::SendOnion (uint32_t firstHop, int routeLen, std::string str_cipher)
+{
+  protomessage::ProtoPacket &onion = *m_txMessage;
+  onion.Clear ();
 
   //Create the onion head
   onion.mutable_o_head ()->set_onion_message (str_cipher);
   onion.mutable_o_head ()->set_onionid (m_onionId);
 
-  // fixed onion head size
-  if (m_fixedOnionSize)
-    {
-      onion.mutable_o_head ()->set_padding ("");
-    }
+  //the padding is added to the packet by EncodePacket (), virtual with the binary format
+  OnionPadding padding;
+  // fixed onion head size, the Sphinx onion head is of constant size without padding
+  padding.head = m_fixedOnionSize && m_onionMode != OnionMode::Sphinx;
 
   //Specify how the onion body must behave
-  std::string padding (m_bodySize, '0');
   switch (m_bodyOptions)
     {
     case BodyOptions::NO_Body:
@@ -295,18 +670,21 @@ Sink::SendOnion (uint32_t firstHop, int routeLen, unsigned char *cipher, int cip
       onion.mutable_o_body ()->set_aggregatedvalue (m_decoyNum);
       break;
     case BodyOptions::FixedSize:
-      onion.mutable_o_body ()->set_padding (padding);
+      padding.body = true;
+      padding.bodyLen = m_bodySize;
       break;
     case BodyOptions::AggregateAndFixed:
       onion.mutable_o_body ()->set_aggregatedvalue (m_decoyNum);
-      onion.mutable_o_body ()->set_padding (padding);
+      padding.body = true;
+      padding.bodyLen = m_bodySize;
       break;
     }
 
   //Create the packet
-  SerializationWrapper sw (onion);
-  Ptr<Packet> p = Create<Packet> ();
-  p->AddHeader (sw);
+  Ptr<Packet> p = EncodePacket (&onion, padding);
+  bool virtualPadding = m_wireFormat == WireFormat::BinaryFormat;
+  ChargeOnionCpu (CpuOperation::PacketSerialization,
+                  p->GetSize () - (virtualPadding ? padding.GetSize () : 0));
 
   InetSocketAddress remote = InetSocketAddress (Ipv4Address (firstHop), m_port);
 
@@ -317,12 +695,13 @@ Sink::SendOnion (uint32_t firstHop, int routeLen, unsigned char *cipher, int cip
   //increment onion sequence number
   m_onionId++;
 
-  m_outputManager->SendOnion (p->GetSize (), onion.mutable_o_head ()->ByteSizeLong (),
-                              onion.mutable_o_body ()->ByteSizeLong (), routeLen,
-                              Simulator::Now ());
-  m_outputManager->OnionRoutingSend (m_address, Ipv4Address (firstHop), p->GetSize (),
-                                     onion.mutable_o_head ()->ByteSizeLong (),
-                                     onion.mutable_o_body ()->ByteSizeLong (), Simulator::Now ());
+  uint32_t headSize =
+      onion.mutable_o_head ()->ByteSizeLong () + (virtualPadding ? padding.headLen : 0);
+  uint32_t bodySize =
+      onion.mutable_o_body ()->ByteSizeLong () + (virtualPadding ? padding.bodyLen : 0);
+  m_outputManager->SendOnion (p->GetSize (), headSize, bodySize, routeLen, Simulator::Now ());
+  m_outputManager->OnionRoutingSend (m_address, Ipv4Address (firstHop), p->GetSize (), headSize,
+                                     bodySize, Simulator::Now ());
 }
 
 //Check if the onion is still in the network and valid each parameter milliseconds
@@ -332,24 +711,42 @@ Sink::CheckOnion (void)
   //no onion running then -> send an onion
   if (!m_onionValidator->OnionStatus ())
     { //Onion was aborted start a new one
-
-      m_repeateCount--; // decrease value of m_repeateCount to re do the same onion size
-      SinkTasks ();
+      ResendOnion ();
     }
 
   //reset the the timer
   Simulator::Schedule (Seconds (5), &Sink::CheckOnion, this);
 }
 
+void
+Sink::ResendOnion (void)
+{
+  m_repeateCount--; // decrease value of m_repeateCount to re do the same onion size
+  //a hop of the circuit may be unreachable, the onion is sent along a new circuit
+  if (m_circuitMode && m_onionLengthIndex < (int) m_circuits.size ())
+    {
+      m_circuits[m_onionLengthIndex].SetEstablished (false);
+    }
+  SinkTasks ();
+}
+
 // executes at the start of the application
 void
 Sink::StartApplication (void)
 {
   //basic configuration
   Wsn_node::Configure ();
-  m_onionManager.GenerateNewKeyPair ();
-  m_publickey = m_onionManager.GetPKtoString ();
-  m_secretkey = m_onionManager.GetSKtoString ();
+  m_publickey = m_onionManager->GetPKtoString ();
+  m_secretkey = m_onionManager->GetSKtoString ();
+  m_sinkLayerKey = m_onionManager->LayerKey (m_publickey);
+  if (m_sinkLayerKey.empty ())
+    {
+      NS_FATAL_ERROR ("Unable to compute the layer key of the sink");
+    }
+  //addresses of onion layers are encoded as set in Configure
+  m_keyRing = KeyRing (m_nodeIds, OnionManager::LAYER_KEY_BYTES);
+  m_route = OnionRouteDescriptor (m_nodeIds.GetAddressSize (), OnionManager::LAYER_KEY_BYTES);
+  m_suffixCache.SetCapacity (m_suffixCacheSize);
 
   //sprejme nov connection izvede callback
   m_socket->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
@@ -366,6 +763,7 @@ Sink::StartApplication (void)
 void
 Sink::StopApplication (void)
 {
+  m_onionPool.Stop ();
   if (m_socket)
     {
       m_socket->Close ();
@@ -31,6 +31,9 @@
 #include <map>
 
 #include "ns3/wsn_node.h"
+#include "ns3/keyring.h"
+#include "ns3/onionpool.h"
+#include "ns3/circuit.h"
 #include "ns3/proto-packet.pb.h"
 #include "ns3/serializationwrapper.h"
 #include "ns3/network-module.h"
@@ -104,6 +107,12 @@ public:
  */
   void CheckOnion (void);
 
+  /**
+ *  \brief The running onion was aborted, decrease the value of \p m_repeateCount and call ns3::Sink::SinkTasks()
+ *          to send again an onion of the same path length. The circuit of the path length is rotated.
+ */
+  void ResendOnion (void);
+
 private:
   /**
   *
@@ -137,6 +146,18 @@ private:
 
   void ReceivePacket (Ptr<Socket> socket);
 
+  /**
+  *
+  * \brief The sink expects the last onion it sent, see ns3::Wsn_node::IsExpectedOnion()
+  * 
+  * \param [in] onionId the onion id
+  * 
+  * \return true if \p onionId is the id of the last onion sent
+  * 
+  * */
+
+  virtual bool IsExpectedOnion (int onionId);
+
   /**
   *
   * \brief When receiving a new handshake with a node. The sink node stores the sensor node IP address and publickey (PK)
@@ -160,6 +181,28 @@ private:
 
   void RecvOnion (protomessage::ProtoPacket_OnionBody *onion_body);
 
+  /**
+  *
+  * \brief Triggered when an onion message sent along a circuit is received back at the sink node.
+  *        The circuit is established by its setup onion, the following cells are authenticated.
+  * 
+  * \param [in] onion_head pointer to the protobuf object holding the cell of the circuit
+  * 
+  * */
+
+  void RecvCircuitCell (protomessage::ProtoPacket_OnionHead *onion_head);
+
+  /**
+  *
+  * \brief Triggered when a sensor node notifies that it dropped an onion message, see ns3::SensorNode::DropOnion().
+  *       If the onion is still running, it is aborted and sent again without waiting for the timeout.
+  * 
+  * \param [in] onionId the onion ID of the dropped onion message
+  * 
+  * */
+
+  void RecvFailureNotice (int onionId);
+
   /**
   *
   * \brief  The method builds the path of the onion message by randomly selecting 
@@ -177,9 +220,10 @@ private:
   /**
   *
   * \brief  Method that constructs the onion head from \p route and \p routeLen parameters.
-  *         The method constructs two arrays \p keys , \p ipRoute containing respectively encryption keys and IP addreses
-  *         of sensor nodes in the \p m_nodeManager structure at indexes specified by the \p route array.
-  *         The onion head is constructed by calling ns3::OnionRouting::BuildOnion().
+  *         The method fills the route descriptor \p m_route with the IP addresses and encryption keys
+  *         of sensor nodes in the \p m_keyRing at indexes specified by the \p route array.
+  *         The onion head is constructed by calling ns3::OnionRouting::BuildOnion(), reusing the inner
+  *         layers cached in \p m_suffixCache if ns3::Sink::SuffixCacheSize is set.
   * 
   * \param [in,out] route pointer to an array of length \p routeLen cointaining indexes of sensor nodes in the \p m_nodeManager structure. 
   * \param [in] routeLen length of the array \p route
@@ -188,6 +232,96 @@ private:
 
   void PrepareOnion (int *route, int routeLen);
 
+  /**
+  *
+  * \brief  Fill the route descriptor \p descriptor with the IP addresses and encryption keys of sensor nodes
+  *         in the \p m_keyRing at indexes specified by the \p route array, and of the sink as the last hop.
+  * 
+  * \param [in,out] descriptor the route descriptor to fill
+  * \param [in] route pointer to an array of length \p routeLen cointaining indexes of sensor nodes in the \p m_nodeManager structure. 
+  * \param [in] routeLen length of the array \p route
+  * 
+  * */
+
+  void FillRoute (OnionRouteDescriptor &descriptor, int *route, int routeLen);
+
+  /**
+  *
+  * \brief  Charge the encryption of the outermost \p layers layers of an onion head to the CPU of the sink,
+  *         see ns3::Wsn_node::ChargeOnionCpu()
+  * 
+  * \param [in] layers number of encrypted layers
+  * \param [in] cipherLen length in bytes of the onion head
+  * \param [in] layerContentLen length in bytes of the content of each layer
+  * 
+  * */
+
+  void ChargeOnionConstruction (uint16_t layers, uint16_t cipherLen, uint16_t layerContentLen);
+
+  /**
+  *
+  * \brief  Send the onion after the simulated construction time \p delay, if positive.
+  *         The onion is marked as started at once, so ns3::Sink::CheckOnion() does not start another one.
+  * 
+  * \param [in] firstHop IP address of the first sensor node in the onion path
+  * \param [in] routeLen length of the onion path
+  * \param [in] str_cipher the ciphertext of the onion head
+  * \param [in] delay the simulated construction time
+  * 
+  * */
+
+  void DispatchOnion (uint32_t firstHop, int routeLen, std::string str_cipher, Time delay);
+
+  /**
+  *
+  * \brief  Start the worker of the onion pool and fill the pool of each onion path length
+  *         Disable the pool if the onion mode has no reentrant construction of onions.
+  * 
+  * */
+
+  void StartOnionPool (void);
+
+  /**
+  *
+  * \brief  Select the route of a new onion of the path length at index \p pool and submit it to the onion pool
+  * 
+  * \param [in] pool index of the path length in \p m_onionPathLengths
+  * 
+  * */
+
+  void SubmitPooledOnion (uint16_t pool);
+
+  /**
+  *
+  * \brief  Take the next onion of the current path length from the onion pool, refill the pool and send the onion
+  *         after the simulated construction time selected by \p m_poolCost
+  * 
+  * */
+
+  void SendPooledOnion (void);
+
+  /**
+  *
+  * \brief  Send a cell along the circuit of the current path length.
+  *         The circuit is built again if it is not established, or after ns3::Sink::CircuitUses onions
+  *         or ns3::Sink::CircuitLifetime.
+  * 
+  * */
+
+  void SendCircuitOnion (void);
+
+  /**
+  *
+  * \brief  Create the circuit of the current path length along \p route and send its setup onion,
+  *         a public-key onion carrying in each layer the circuit id and the symmetric key of the hop.
+  * 
+  * \param [in] route pointer to an array of length \p routeLen cointaining indexes of sensor nodes in the \p m_nodeManager structure. 
+  * \param [in] routeLen length of the array \p route
+  * 
+  * */
+
+  void BuildCircuit (int *route, int routeLen);
+
   /**
   *
   * \brief  The method constructs the onion message as a protobuf object.
@@ -196,17 +330,19 @@ private:
   * 
   * \param [in] firstHop IP address of the first sensor node in the onion path
   * \param [in] routeLen length of the onion path
-  * \param [in,out] cipher pointer to the ciphertext of the onion head
-  * \param [in] cipherLen length in the number of bytes of the \p cipher
+  * \param [in] str_cipher the ciphertext of the onion head
   * 
   * */
 
-  void SendOnion (uint32_t firstHop, int routeLen, unsigned char *cipher, int cipherLen);
+  void SendOnion (uint32_t firstHop, int routeLen, std::string str_cipher);
 
   uint16_t m_numnodes; //!<  The number of sensor nodes in the simulation
   uint32_t m_onionDelay; //!<  The sink will start sending onion messagess after OnionDelay seconds
   std::map<uint32_t, std::string>
       m_nodeManager; //!<  hashmap to manage data about nodes in the WSN// pair <IP,publickey>
+  KeyRing m_keyRing; //!<  keys used to encrypt layers addressed to nodes, indexed as \p m_nodeManager
+  std::string m_sinkLayerKey; //!<  key used to encrypt the layer addressed to the sink
+  OnionRouteDescriptor m_route; //!<  route and keys of the onion under construction, reused across onions
   uint32_t m_decoyNum =
       1203; //!< dummy decoy value used to obfuscate the value carried in the onion body
   bool
@@ -224,12 +360,28 @@ private:
   //onion sequence number
   int m_onionId = 1; //!< onion ID incremented each time a new onion is issued
 
-  //VErbosity of onion
-  std::stringstream m_onionStream; //!< a string stream holding the onion represented as a string
-
   //sink node keys
   std::string m_publickey; //!< the encryption key: publickey
   std::string m_secretkey; //!< the encryption key: secretkey
+
+  //onion pool
+  uint16_t m_poolSize; //!< number of onions built in advance for each path length, 0 disables the pool
+  uint16_t m_poolThreads; //!< threads building the onions of the pool, 0 for the hardware concurrency
+  enum PoolCost m_poolCost; //!< simulated time charged for onions taken from the pool
+  Time m_poolLayerCost; //!< simulated time charged for each layer with PoolCost::ModelledCost
+  OnionPool m_onionPool; //!< builds onions in the background
+
+  //suffix cache
+  uint32_t m_suffixCacheSize; //!< bytes of inner layers cached, 0 disables the cache
+  OnionSuffixCache m_suffixCache; //!< inner layers of onions, keyed by the last hops of the route
+
+  //circuits
+  uint32_t m_circuitUses; //!< onions sent along a circuit before it is rotated
+  Time m_circuitLifetime; //!< age after which a circuit is rotated
+  std::vector<Circuit> m_circuits; //!< circuit of each path length in \p m_onionPathLengths
+
+  SealedBoxOnionRouting
+      m_onionBuilder; //!< builds onion messages in the OnionMode::SealedBox, specialized at compile time on IPv4 and sealed boxes
 };
 
 } // namespace ns3
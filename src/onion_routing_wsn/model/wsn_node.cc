@@ -49,6 +49,9 @@ Wsn_node::GetTypeId (void)
           .AddAttribute ("OnionValidator", "Manage onions and when to abort them", PointerValue (0),
                          MakePointerAccessor (&Wsn_node::m_onionValidator),
                          MakePointerChecker<OnionValidator> ())
+          .AddAttribute ("CpuEnergyModel", "Energy model of the CPU of the node", PointerValue (0),
+                         MakePointerAccessor (&Wsn_node::m_cpuEnergy),
+                         MakePointerChecker<CpuEnergyModel> ())
           .AddAttribute ("Delay", "Starting delay of sensor nodes, delay is given in milliseconds",
                          TypeId::ATTR_CONSTRUCT | TypeId::ATTR_SET | TypeId::ATTR_GET,
                          UintegerValue (200), MakeUintegerAccessor (&Wsn_node::m_delay),
@@ -63,6 +66,30 @@ Wsn_node::GetTypeId (void)
                          TypeId::ATTR_CONSTRUCT | TypeId::ATTR_SET | TypeId::ATTR_GET,
                          UintegerValue (100), MakeUintegerAccessor (&Wsn_node::m_onionTimeout),
                          MakeUintegerChecker<uint16_t> ())
+          .AddAttribute ("OnionMode", "Encryption of layers of onion messages",
+                         EnumValue (OnionMode::SealedBox), MakeEnumAccessor (&Wsn_node::m_onionMode),
+                         MakeEnumChecker (OnionMode::SealedBox, "sealed", OnionMode::SharedKey,
+                                          "shared", OnionMode::Sphinx, "sphinx",
+                                          OnionMode::CostModel, "costmodel", OnionMode::Aead,
+                                          "aead"))
+          .AddAttribute ("AddressEncoding",
+                         "Encoding of next hop addresses in onion layers, full address or node id "
+                         "in the WSN subnet",
+                         EnumValue (ONION_IPV4), MakeEnumAccessor (&Wsn_node::m_addressEncoding),
+                         MakeEnumChecker (ONION_IPV4, "ipv4", ONION_NODEID16, "id16",
+                                          ONION_NODEID8, "id8"))
+          .AddAttribute ("Circuits",
+                         "Send onions along circuits, the public-key setup onion of a circuit "
+                         "distributes symmetric layer keys used by the following onions",
+                         BooleanValue (false), MakeBooleanAccessor (&Wsn_node::m_circuitMode),
+                         MakeBooleanChecker ())
+          .AddAttribute ("WireFormat",
+                         "Encoding of the messages sent in packets, protobuf or the fixed-layout "
+                         "binary encoding, all nodes must use the same",
+                         EnumValue (WireFormat::ProtobufFormat),
+                         MakeEnumAccessor (&Wsn_node::m_wireFormat),
+                         MakeEnumChecker (WireFormat::ProtobufFormat, "protobuf",
+                                          WireFormat::BinaryFormat, "binary"))
           .AddTraceSource ("AppTx", "Packet transmitted",
                            MakeTraceSourceAccessor (&Wsn_node::m_appTx),
                            "ns3::TracedValueCallback::Packet")
@@ -84,8 +111,113 @@ Wsn_node::NotifyRx (Ptr<const Packet> packet)
   m_appRx (packet);
 }
 
+double
+Wsn_node::ChargeCpu (enum CpuOperation operation, uint32_t bytes)
+{
+  if (m_cpuEnergy == 0)
+    {
+      return 0;
+    }
+  return m_cpuEnergy->ChargeCpu (operation, bytes);
+}
+
+void
+Wsn_node::ChargeOnionCpu (enum CpuOperation operation, uint32_t bytes)
+{
+  m_outputManager->AddOnionEnergy (ChargeCpu (operation, bytes));
+}
+
+Ptr<Packet>
+Wsn_node::EncodePacket (protomessage::ProtoPacket *message, const OnionPadding &padding)
+{
+  if (m_wireFormat == WireFormat::BinaryFormat)
+    {
+      //zero-filled payload, not allocated by ns-3
+      Ptr<Packet> p = Create<Packet> (padding.GetSize ());
+      BinaryWrapper bw;
+      bw.SetPadding (padding);
+      bw.SetData (*message);
+      p->AddHeader (bw);
+      return p;
+    }
+
+  //grows the strings reused by the message, the existing padding is kept
+  if (padding.head)
+    {
+      message->mutable_o_head ()->mutable_padding ()->resize (padding.headLen, '0');
+    }
+  if (padding.body)
+    {
+      message->mutable_o_body ()->mutable_padding ()->resize (padding.bodyLen, '0');
+    }
+  Ptr<Packet> p = Create<Packet> ();
+  SerializationWrapper sw (*message);
+  p->AddHeader (sw);
+  return p;
+}
+
+bool
+Wsn_node::DecodePacket (Ptr<Packet> p, protomessage::ProtoPacket *message, OnionPadding *padding)
+{
+  if (m_wireFormat == WireFormat::BinaryFormat)
+    {
+      BinaryWrapper bw (message);
+      p->RemoveHeader (bw);
+      if (padding != nullptr)
+        {
+          *padding = bw.GetPadding ();
+        }
+      return bw.IsParsed ();
+    }
+
+  SerializationWrapper sw (message);
+  p->RemoveHeader (sw);
+  if (padding != nullptr)
+    {
+      padding->head = message->o_head ().has_padding ();
+      padding->headLen = message->o_head ().padding ().size ();
+      padding->body = message->o_body ().has_padding ();
+      padding->bodyLen = message->o_body ().padding ().size ();
+    }
+  return sw.IsParsed ();
+}
+
+uint32_t
+Wsn_node::PeekOnionId (Ptr<const Packet> p, int *onionId)
+{
+  if (m_wireFormat == WireFormat::BinaryFormat)
+    {
+      return BinaryWrapper::PeekOnionId (p, onionId);
+    }
+  return SerializationWrapper::PeekOnionId (p, onionId);
+}
+
+bool
+Wsn_node::IsExpectedOnion (int onionId)
+{
+  return true;
+}
+
+bool
+Wsn_node::DropGhostOnion (Ptr<const Packet> p)
+{
+  int onionId;
+  uint32_t peeked = PeekOnionId (p, &onionId);
+  if (peeked == 0 || IsExpectedOnion (onionId))
+    {
+      return false;
+    }
+  ChargeCpu (CpuOperation::PacketDeserialization, peeked);
+  NS_LOG_INFO ("Ghost onion received, deleted before parsing with onion id: "
+               << onionId << ", at ip: " << m_address
+               << ", at time: " << std::to_string (Simulator::Now ().GetSeconds ()));
+  return true;
+}
+
 Wsn_node::Wsn_node ()
 {
+  m_rxMessage = google::protobuf::Arena::CreateMessage<protomessage::ProtoPacket> (&m_arena);
+  m_txMessage = google::protobuf::Arena::CreateMessage<protomessage::ProtoPacket> (&m_arena);
 }
 
 void
@@ -108,6 +240,26 @@ Wsn_node::Configure ()
   Ipv4Address address = iaddr.GetLocal ();
   m_address = address;
 
+  //manager of the onion encryption
+  CreateOnionManager ();
+
+  //next hops are resolved in the subnet of the node
+  m_nodeIds = NodeIdTable (m_addressEncoding, address, iaddr.GetMask ());
+  m_onionManager->SetAddressFamily (m_addressEncoding);
+
+  //the setup onion of a circuit carries content in its layers
+  if (m_circuitMode && m_onionMode == OnionMode::Sphinx)
+    {
+      NS_LOG_WARN ("Circuits are not supported in the Sphinx onion mode, circuits are disabled");
+      m_circuitMode = false;
+    }
+
+  //generate encryption keys
+  if (!m_seededKeyPair)
+    {
+      m_onionManager->GenerateNewKeyPair ();
+    }
+
   m_socket = Socket::CreateSocket (GetNode (), TcpSocketFactory::GetTypeId ());
   InetSocketAddress local (Ipv4Address::GetAny (), m_port);
   m_socket->SetIpRecvTtl (true);
@@ -131,6 +283,41 @@ Wsn_node::Configure ()
     }
 }
 
+Ptr<OnionManager>
+Wsn_node::CreateOnionManager ()
+{
+  if (m_onionManager == 0)
+    {
+      switch (m_onionMode)
+        {
+        case OnionMode::SealedBox:
+          m_onionManager = CreateObject<OnionManager> ();
+          break;
+        case OnionMode::SharedKey:
+          m_onionManager = CreateObject<SharedKeyOnionManager> ();
+          break;
+        case OnionMode::Sphinx:
+          m_onionManager = CreateObject<SphinxOnionManager> ();
+          break;
+        case OnionMode::CostModel:
+          m_onionManager = CreateObject<CostModelOnionManager> ();
+          break;
+        case OnionMode::Aead:
+          m_onionManager = CreateObject<AeadOnionManager> ();
+          break;
+        }
+    }
+  return m_onionManager;
+}
+
+void
+Wsn_node::SeedKeyPair (const uint8_t *seed)
+{
+  //does not create objects, safe to call in parallel on distinct nodes
+  m_onionManager->GenerateKeyPairFromSeed (seed);
+  m_seededKeyPair = true;
+}
+
 void
 Wsn_node::DisableNode ()
 {
@@ -295,16 +482,27 @@ Wsn_node::RecvSeg (Ptr<Socket> socket, Ptr<Packet> p, Address from)
       f_receivingAddress = from_address.GetIpv4 (); //Ipv4Address(0);
       f_pendingPacket = Create<Packet> ();
       f_segmentSize = s_num.GetSegNum ();
+      //the first segment holds the onion id, the segments of a ghost onion are not stored
+      f_discard = DropGhostOnion (p);
+    }
+  if (!f_discard)
+    {
+      f_pendingPacket->AddAtEnd (p);
     }
-  f_pendingPacket->AddAtEnd (p);
 
   f_segmentSize = f_segmentSize - p->GetSize ();
 
   if (f_segmentSize == 0)
     {
-      p = f_pendingPacket->Copy ();
+      p = f_discard ? Ptr<Packet> () : f_pendingPacket->Copy ();
+      if (f_discard)
+        {
+          //the ghost onion is still received data of the application, zero-filled
+          NotifyRx (Create<Packet> (s_num.GetSegNum ()));
+        }
       f_receivingAddress = Ipv4Address::GetAny ();
       f_pendingPacket = NULL;
+      f_discard = false;
       socket->Close ();
       return p;
     }
@@ -30,7 +30,17 @@
 #include "ns3/segmentnum.h"
 #include "ns3/outputmanager.h"
 #include "ns3/onionmanager.h"
+#include "ns3/sharedkeyonionmanager.h"
+#include "ns3/sphinxonionmanager.h"
+#include "ns3/costmodelonionmanager.h"
+#include "ns3/aeadonionmanager.h"
+#include "ns3/nodeidtable.h"
+#include "ns3/cpuenergymodel.h"
+#include "ns3/enums.h"
 #include "ns3/onionvalidator.h"
+#include "ns3/proto-packet.pb.h"
+#include "ns3/serializationwrapper.h"
+#include "ns3/binarywrapper.h"
 
 #include "ns3/mobility-model.h"
 #include "ns3/core-module.h"
@@ -77,11 +87,32 @@ public:
   /**
   *
   * \brief 1. configure basic attributes of nodes
-  *        2. create socket and listen for connections
-  *        3. get node position in the form of x and y coordinates
+  *        2. create the ns3::OnionManager of the configured ns3::OnionMode
+  *        3. generate the keypair, unless it was derived from a seed by ns3::Wsn_node::SeedKeyPair()
+  *        4. create socket and listen for connections
+  *        5. get node position in the form of x and y coordinates
   *
   */
   void Configure (void);
+
+  /**
+  *
+  * \brief Create the ns3::OnionManager of the configured ns3::OnionMode, if not created yet
+  *
+  * \return the onion manager
+  *
+  */
+  Ptr<OnionManager> CreateOnionManager (void);
+
+  /**
+  *
+  * \brief Derive the keypair of the node from \p seed before the start of the application.
+  *         Call ns3::Wsn_node::CreateOnionManager() first, then nodes can be seeded in parallel.
+  *
+  * \param [in] seed OnionManager::KEY_SEED_BYTES bytes of seed
+  *
+  */
+  void SeedKeyPair (const uint8_t *seed);
   //Node Degree
 
   /**
@@ -142,12 +173,14 @@ public:
   * \brief  method for receiving packets able to merge segment fragments 
   *         if a packet was split into multiple segments due to being larger than the MSS
   *         Use the packet tag, to merge packet fragments into a single packet.
+  *         The segments of a ghost onion are not stored, see ns3::Wsn_node::DropGhostOnion().
   * 
   * \param [in] socket the receiving socket 
   * \param [in] packet pointer to the receiving packet 
   * \param [in,out] from extract the sender IP from the receiving socket 
   * 
   * \return return pointer to packet if the whole packet is received OR return NULL value if only packet fragment is received
+  *         or if the packet is a ghost onion
   * 
   * */
 
@@ -220,6 +253,103 @@ public:
 
   void NotifyRx (Ptr<const Packet> packet);
 
+  /**
+  *
+  * \brief Charge an operation of the onion protocol to the ns3::CpuEnergyModel of the node, if set
+  * 
+  * \param [in] operation the operation
+  * \param [in] bytes length in bytes of the processed data
+  * 
+  * \return the energy in joules drawn by the operation, 0 without the ns3::CpuEnergyModel
+  * 
+  * */
+
+  double ChargeCpu (enum CpuOperation operation, uint32_t bytes);
+
+  /**
+  *
+  * \brief Charge an operation processing the running onion message, see ns3::Wsn_node::ChargeCpu(),
+  *        and add its energy to the energy of the onion in the ns3::OutputManager
+  * 
+  * \param [in] operation the operation
+  * \param [in] bytes length in bytes of the processed data
+  * 
+  * */
+
+  void ChargeOnionCpu (enum CpuOperation operation, uint32_t bytes);
+
+  /**
+  *
+  * \brief Create a packet carrying \p message in the configured ns3::WireFormat.
+  *        The padding is written in the padding fields of the message with protobuf,
+  *        and is virtual with the binary format, see ns3::BinaryWrapper.
+  * 
+  * \param [in,out] message the message, the padding fields are not set by the caller
+  * \param [in] padding the padding of the onion
+  * 
+  * \return the packet
+  * 
+  * */
+
+  Ptr<Packet> EncodePacket (protomessage::ProtoPacket *message,
+                            const OnionPadding &padding = OnionPadding ());
+
+  /**
+  *
+  * \brief Remove the message in the configured ns3::WireFormat from the packet \p p,
+  *        the virtual padding of the binary format is left in the packet
+  * 
+  * \param [in] p the received packet
+  * \param [out] message the message parsed from the packet
+  * \param [out] padding the padding of the onion, if not null
+  * 
+  * \return false if the packet is malformed
+  * 
+  * */
+
+  bool DecodePacket (Ptr<Packet> p, protomessage::ProtoPacket *message,
+                     OnionPadding *padding = nullptr);
+
+  /**
+  *
+  * \brief Read the onion id of the onion message at the start of \p p in the configured
+  *        ns3::WireFormat, without parsing the message
+  * 
+  * \param [in] p the packet, or its first segment
+  * \param [out] onionId the onion id
+  * 
+  * \return the bytes read, 0 if \p p does not start with an onion message
+  * 
+  * */
+
+  uint32_t PeekOnionId (Ptr<const Packet> p, int *onionId);
+
+  /**
+  *
+  * \brief Check the onion id of an onion received by the node, onions of previous
+  *         aborted onions still in the network are ghost onions
+  * 
+  * \param [in] onionId the onion id
+  * 
+  * \return false if the onion is a ghost onion, true by default
+  * 
+  * */
+
+  virtual bool IsExpectedOnion (int onionId);
+
+  /**
+  *
+  * \brief Delete \p p if it starts with a ghost onion, found by ns3::Wsn_node::PeekOnionId()
+  *        before the packet is reassembled and parsed
+  * 
+  * \param [in] p the packet, or its first segment
+  * 
+  * \return true if the packet is a ghost onion and must be deleted
+  * 
+  * */
+
+  bool DropGhostOnion (Ptr<const Packet> p);
+
 protected:
   uint16_t m_port; //!< port of the application
   Ptr<OutputManager> m_outputManager; //!< Pointer to the ns3::OutputManager
@@ -227,7 +357,19 @@ protected:
   Ipv4Address m_address; //!< ns3::Ipv4Address of this node
   Ptr<Socket> m_socket; //!< listening socket
   uint16_t m_delay; //!< delay after which the handshake process will start
-  OnionManager m_onionManager; //!< The ns3::OnionManager object
+  enum OnionMode m_onionMode; //!< Specifies how layers of onion messages are encrypted
+  Ptr<OnionManager> m_onionManager; //!< The ns3::OnionManager object, created in Configure() from \p m_onionMode
+  enum OnionAddressFamily m_addressEncoding; //!< Encoding of next hop addresses in onion layers
+  NodeIdTable m_nodeIds; //!< Resolves next hop addresses of onion layers, set in Configure() from \p m_addressEncoding
+  bool m_circuitMode; //!< onions are sent along circuits, see ns3::Circuit
+  enum WireFormat m_wireFormat; //!< encoding of the messages sent in packets
+  bool m_seededKeyPair = false; //!< the keypair was derived from a seed before the start of the application
+  Ptr<CpuEnergyModel> m_cpuEnergy; //!< accounts the work of the CPU, not set if the energy is not accounted
+
+  //protobuf messages reused for every packet, their fields keep the capacity once grown
+  google::protobuf::Arena m_arena; //!< owns the protobuf messages of the node
+  protomessage::ProtoPacket *m_rxMessage; //!< the message parsed from a received packet
+  protomessage::ProtoPacket *m_txMessage; //!< the message serialized in a sent packet, clear it before use
 
   //To manage fragments
   uint16_t f_mss; //!< maximum segment size
@@ -235,6 +377,7 @@ protected:
   Ptr<Packet>
       f_pendingPacket; //!< pointer to the packet where received segment fragments are stored
   Ipv4Address f_receivingAddress = Ipv4Address::GetAny (); //!< the receiving address
+  bool f_discard = false; //!< the segments of the packet are not stored, the packet is a ghost onion
 
   // onion state
   int o_hopCount = 0; //!< track how the onion is is transiting in the network
@@ -0,0 +1,318 @@
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+#include "binarywrapper.h"
+#include "ns3/abort.h"
+#include "ns3/header.h"
+#include "ns3/network-module.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BinaryWrapper);
+
+TypeId
+BinaryWrapper::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BinaryWrapper")
+                          .SetParent<Header> ()
+                          .AddConstructor<BinaryWrapper> ()
+                          .SetGroupName ("Network");
+  return tid;
+}
+
+TypeId
+BinaryWrapper::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+BinaryWrapper::BinaryWrapper ()
+    : m_message (nullptr),
+      m_target (nullptr),
+      m_dataSize (0),
+      m_type (0),
+      m_parsed (false)
+{
+}
+
+BinaryWrapper::~BinaryWrapper ()
+{
+}
+
+BinaryWrapper::BinaryWrapper (const protomessage::ProtoPacket &message) : BinaryWrapper ()
+{
+  SetData (message);
+}
+
+BinaryWrapper::BinaryWrapper (protomessage::ProtoPacket *message) : BinaryWrapper ()
+{
+  SetTarget (message);
+}
+
+void
+BinaryWrapper::SetData (const protomessage::ProtoPacket &message)
+{
+  m_message = &message;
+  if (message.has_h_shake ())
+    {
+      m_type = HANDSHAKE;
+    }
+  else if (message.o_head ().has_onion_message ())
+    {
+      m_type = ONION;
+    }
+  else
+    {
+      m_type = FAILURE_NOTICE;
+    }
+  m_dataSize = ComputeSize (message);
+}
+
+void
+BinaryWrapper::SetTarget (protomessage::ProtoPacket *message)
+{
+  m_target = message;
+}
+
+bool
+BinaryWrapper::IsParsed (void) const
+{
+  return m_parsed;
+}
+
+void
+BinaryWrapper::SetPadding (const OnionPadding &padding)
+{
+  m_padding = padding;
+  //the padding lengths are encoded in the onion, the cached size of the message is stale
+  if (m_message != nullptr)
+    {
+      m_dataSize = ComputeSize (*m_message);
+    }
+}
+
+const OnionPadding &
+BinaryWrapper::GetPadding (void) const
+{
+  return m_padding;
+}
+
+uint32_t
+BinaryWrapper::PeekOnionId (Ptr<const Packet> p, int *onionId)
+{
+  //[type][flags][onion id, 4B]
+  uint8_t data[1 + 1 + 4];
+  if (p->CopyData (data, sizeof (data)) < sizeof (data) || data[0] != ONION)
+    {
+      return 0;
+    }
+  uint32_t id = ((uint32_t) data[2] << 24) | ((uint32_t) data[3] << 16) |
+                ((uint32_t) data[4] << 8) | data[5];
+  *onionId = (int32_t) id;
+  return sizeof (data);
+}
+
+uint32_t
+BinaryWrapper::ComputeSize (const protomessage::ProtoPacket &message) const
+{
+  if (message.has_h_shake ())
+    {
+      return 1 + 2 + message.h_shake ().publickey ().size ();
+    }
+  const protomessage::ProtoPacket_OnionHead &head = message.o_head ();
+  if (!head.has_onion_message ())
+    {
+      return 1 + 4;
+    }
+
+  uint32_t size = 1 + 1 + 4 + 2 + head.onion_message ().size ();
+  if (message.o_body ().has_aggregatedvalue ())
+    {
+      size += 4;
+    }
+  //only the lengths of the padding
+  size += m_padding.head ? 4 : 0;
+  size += m_padding.body ? 4 : 0;
+  return size;
+}
+
+uint32_t
+BinaryWrapper::GetSerializedSize (void) const
+{
+  return m_dataSize;
+}
+
+void
+BinaryWrapper::WriteLength (Buffer::Iterator &i, uint32_t len)
+{
+  NS_ABORT_MSG_IF (len > 0xffff, "field too long for the binary wire format");
+  i.WriteHtonU16 (len);
+}
+
+void
+BinaryWrapper::WriteField (Buffer::Iterator &i, const std::string &field)
+{
+  WriteLength (i, field.size ());
+  i.Write (reinterpret_cast<const uint8_t *> (field.data ()), field.size ());
+}
+
+bool
+BinaryWrapper::ReadField (Buffer::Iterator &i, std::string *field)
+{
+  if (i.GetRemainingSize () < 2)
+    {
+      return false;
+    }
+  uint16_t len = i.ReadNtohU16 ();
+  if (i.GetRemainingSize () < len)
+    {
+      return false;
+    }
+  if (field == nullptr)
+    {
+      i.Next (len);
+      return true;
+    }
+  //reuses the capacity of the string of the target
+  field->resize (len);
+  i.Read (reinterpret_cast<uint8_t *> (&(*field)[0]), len);
+  return true;
+}
+
+void
+BinaryWrapper::Serialize (Buffer::Iterator start) const
+{
+  NS_ASSERT_MSG (m_message != nullptr, "message not set");
+  Buffer::Iterator i = start;
+  i.WriteU8 (m_type);
+
+  if (m_type == HANDSHAKE)
+    {
+      WriteField (i, m_message->h_shake ().publickey ());
+      return;
+    }
+
+  const protomessage::ProtoPacket_OnionHead &head = m_message->o_head ();
+  if (m_type == FAILURE_NOTICE)
+    {
+      i.WriteHtonU32 (head.onionid ());
+      return;
+    }
+
+  const protomessage::ProtoPacket_OnionBody &body = m_message->o_body ();
+  uint8_t flags = 0;
+  flags |= m_padding.head ? HEAD_PADDING : 0;
+  flags |= body.has_aggregatedvalue () ? AGGREGATED_VALUE : 0;
+  flags |= m_padding.body ? BODY_PADDING : 0;
+  i.WriteU8 (flags);
+  i.WriteHtonU32 (head.onionid ());
+  WriteField (i, head.onion_message ());
+  if (body.has_aggregatedvalue ())
+    {
+      i.WriteHtonU32 (body.aggregatedvalue ());
+    }
+  if (m_padding.head)
+    {
+      i.WriteHtonU32 (m_padding.headLen);
+    }
+  if (m_padding.body)
+    {
+      i.WriteHtonU32 (m_padding.bodyLen);
+    }
+}
+
+uint32_t
+BinaryWrapper::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+  m_parsed = false;
+  m_padding = OnionPadding ();
+  if (m_target != nullptr)
+    {
+      m_target->Clear ();
+    }
+
+  m_type = i.GetRemainingSize () < 1 ? 0 : i.ReadU8 ();
+  bool valid = false;
+  if (m_type == HANDSHAKE)
+    {
+      valid = ReadField (i, m_target == nullptr
+                                ? nullptr
+                                : m_target->mutable_h_shake ()->mutable_publickey ());
+    }
+  else if (m_type == FAILURE_NOTICE && i.GetRemainingSize () >= 4)
+    {
+      uint32_t onionId = i.ReadNtohU32 ();
+      if (m_target != nullptr)
+        {
+          m_target->mutable_o_head ()->set_onionid (onionId);
+        }
+      valid = true;
+    }
+  else if (m_type == ONION && i.GetRemainingSize () >= 1 + 4)
+    {
+      uint8_t flags = i.ReadU8 ();
+      uint32_t onionId = i.ReadNtohU32 ();
+      protomessage::ProtoPacket_OnionHead *head = nullptr;
+      if (m_target != nullptr)
+        {
+          head = m_target->mutable_o_head ();
+          head->set_onionid (onionId);
+        }
+
+      valid = ReadField (i, head == nullptr ? nullptr : head->mutable_onion_message ());
+      if (valid && (flags & AGGREGATED_VALUE))
+        {
+          valid = i.GetRemainingSize () >= 4;
+          if (valid)
+            {
+              int32_t value = i.ReadNtohU32 ();
+              if (m_target != nullptr)
+                {
+                  m_target->mutable_o_body ()->set_aggregatedvalue (value);
+                }
+            }
+        }
+
+      m_padding.head = flags & HEAD_PADDING;
+      m_padding.body = flags & BODY_PADDING;
+      uint32_t lengths = (m_padding.head ? 4 : 0) + (m_padding.body ? 4 : 0);
+      valid = valid && i.GetRemainingSize () >= lengths;
+      if (valid)
+        {
+          m_padding.headLen = m_padding.head ? i.ReadNtohU32 () : 0;
+          m_padding.bodyLen = m_padding.body ? i.ReadNtohU32 () : 0;
+          //the zero bytes of the padding are left in the packet
+          valid = i.GetRemainingSize () >= m_padding.GetSize ();
+        }
+    }
+
+  m_parsed = valid && m_target != nullptr;
+  m_dataSize = i.GetDistanceFrom (start);
+  return m_dataSize;
+}
+
+void
+BinaryWrapper::Print (std::ostream &os) const
+{
+  os << "type=" << (uint32_t) m_type << " size=" << m_dataSize;
+}
+
+} // namespace ns3
@@ -0,0 +1,299 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+
+/*
+* Copyright (c) 2020 DLTLT 
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation;
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*
+* Corresponding author: Niki Hrovatin <niki.hrovatin@famnit.upr.si>
+*/
+
+
+#ifndef BINARYWRAPPER_H
+#define BINARYWRAPPER_H
+
+#include <string>
+#include "ns3/header.h"
+#include "ns3/network-module.h"
+#include "ns3/packet.h"
+#include "ns3/proto-packet.pb.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup serialization
+ * \struct OnionPadding
+ * \brief Presence and length of the padding of the onion head and of the onion body
+ */
+
+struct OnionPadding
+{
+  bool head = false; //!< the onion head has padding
+  uint32_t headLen = 0; //!< bytes of padding of the onion head
+  bool body = false; //!< the onion body has padding
+  uint32_t bodyLen = 0; //!< bytes of padding of the onion body
+
+  /**
+  *
+  * \return the bytes of padding of the onion
+  *
+  */
+  uint32_t
+  GetSize (void) const
+  {
+    return headLen + bodyLen;
+  }
+};
+
+/**
+ * \ingroup serialization
+ * 
+ * \class BinaryWrapper
+ * \brief Fixed-layout binary serialization of the messagess to send in packets, an alternative to
+ *        the protobuf encoding of ns3::SerializationWrapper with the same semantics
+ *
+ * The fields of the protobuf message are written in a fixed order, integers in network byte order:
+ * - handshake: [type][publickey length, 2B][publickey]
+ * - onion: [type][flags][onion id, 4B][head length, 2B][head] [aggregated value, 4B]
+ *   [head padding length, 4B] [body padding length, 4B], the aggregated value and the padding
+ *   lengths are present only if their flag is set
+ * - failure notice, an onion head without the onion message: [type][onion id, 4B]
+ *
+ * The offsets of the fields do not depend on their values, the onion id is at the same offset in
+ * every onion. The wrapper does not own nor copy the message, which must outlive the AddHeader()
+ * or RemoveHeader() call of the packet.
+ *
+ * The padding is virtual: only its length is encoded, from SetPadding() instead of the padding
+ * fields of the message, and its zero bytes follow the wrapper in the packet as the zero-filled
+ * payload of ns3::Packet (size). ns-3 keeps the payload as a zero area without allocating it, but
+ * operations that merge buffers, as the TCP reassembly with Buffer::AddAtEnd(), may write the zero
+ * bytes into memory. Deserialize() leaves the padding in
+ * the packet, so a relay can remove the wrapper from the received packet, process the head and
+ * the aggregated value, and add the wrapper back to the same packet.
+ *
+ */
+
+class BinaryWrapper : public Header
+{
+public:
+  /**
+  *
+  * \brief Type of the message, first byte of the serialized data
+  *
+  */
+  enum MessageType {
+    HANDSHAKE = 1, //!< ns3::protomessage::ProtoPacket::h_shake is set
+    ONION = 2, //!< ns3::protomessage::ProtoPacket::o_head carries an onion message
+    FAILURE_NOTICE = 3 //!< ns3::protomessage::ProtoPacket::o_head carries only the onion id
+  };
+
+  /**
+  *
+  * \brief Flags of the optional fields of an onion, second byte of the serialized onion
+  *
+  */
+  enum OnionFlags {
+    HEAD_PADDING = 0x01, //!< the onion head has padding, its length is encoded
+    AGGREGATED_VALUE = 0x02, //!< the onion body has an aggregated value
+    BODY_PADDING = 0x04 //!< the onion body has padding, its length is encoded
+  };
+
+  /**
+ *  Register this type.
+ *  \return The object TypeId.
+ */
+  static TypeId GetTypeId (void);
+
+  /**
+  *
+  * \brief Default constructor
+  *
+  */
+  BinaryWrapper ();
+
+  virtual ~BinaryWrapper ();
+
+  /**
+  *
+  * \brief Constructor of a wrapper sending a message
+  * 
+  * \param [in] message the protobuff object containing the data to transmit
+  *
+  */
+  BinaryWrapper (const protomessage::ProtoPacket &message);
+
+  /**
+  *
+  * \brief Constructor of a wrapper receiving a message
+  * 
+  * \param [in,out] message pointer to the protobuff object for storing data
+  *
+  */
+  BinaryWrapper (protomessage::ProtoPacket *message);
+
+  /**
+  *
+  * \brief Setter of the message to serialize, the size of the message is computed and cached
+  * 
+  * \param [in] message the protobuff object containing the data to transmit, must not be modified
+  * until the wrapper is added to the packet
+  *
+  */
+  void SetData (const protomessage::ProtoPacket &message);
+
+  /**
+  *
+  * \brief Setter of the message filled by Deserialize()
+  * 
+  * \param [in,out] message pointer to the protobuff object for storing data
+  *
+  */
+  void SetTarget (protomessage::ProtoPacket *message);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return true if the last Deserialize() parsed a valid message into the target
+  *
+  */
+  bool IsParsed (void) const;
+
+  /**
+  *
+  * \brief Read the onion id of the onion message at the start of \p p, at its fixed offset
+  *
+  * \param [in] p the packet, or its first segment
+  * \param [out] onionId the onion id
+  *
+  * \return the bytes read, 0 if \p p does not start with an onion message
+  *
+  */
+  static uint32_t PeekOnionId (Ptr<const Packet> p, int *onionId);
+
+  /**
+  *
+  * \brief Setter of the padding following the wrapper in the packet, the cached size of the message
+  * set by SetData() is updated
+  *
+  * \param [in] padding the padding of the onion
+  *
+  */
+  void SetPadding (const OnionPadding &padding);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return the padding following the wrapper in the packet, set by Deserialize()
+  *
+  */
+  const OnionPadding &GetPadding (void) const;
+
+  /**
+ *  
+ *  \return The object TypeId.
+ */
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  /**
+ * 
+ *  \brief compute the serialized size of the data
+ *  
+ *  \return return the size of the serialized data in bytes
+ */
+  virtual uint32_t GetSerializedSize (void) const;
+
+  /**
+ * 
+ *  \brief serialize the data
+ *  
+ *  \param [in,out] start	an iterator which points to where the data should be written.
+ * 
+ */
+  virtual void Serialize (Buffer::Iterator start) const;
+
+  /**
+ * 
+ *  \brief deserialize the data, parsed into the target if set
+ * 
+ *  \param [in,out] start	an iterator which points to where the data should read from.
+ * 
+ *  \return the number of bytes read.
+ *  
+ */
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+  /**
+ * 
+ *  \brief print the type and the size of the serialized data
+ * 
+ */
+  virtual void Print (std::ostream &os) const;
+
+private:
+  /**
+  *
+  * \brief compute the serialized size of \p message
+  *
+  * \param [in] message the message
+  *
+  * \return the size in bytes
+  *
+  */
+  uint32_t ComputeSize (const protomessage::ProtoPacket &message) const;
+
+  /**
+  *
+  * \brief write a length-prefixed field
+  *
+  * \param [in,out] i the iterator
+  * \param [in] field the bytes of the field, at most 65535
+  *
+  */
+  static void WriteField (Buffer::Iterator &i, const std::string &field);
+
+  /**
+  *
+  * \brief write a field length of at most 65535 bytes, abort on longer fields
+  *
+  * \param [in,out] i the iterator
+  * \param [in] len the length
+  *
+  */
+  static void WriteLength (Buffer::Iterator &i, uint32_t len);
+
+  /**
+  *
+  * \brief read a length-prefixed field
+  *
+  * \param [in,out] i the iterator
+  * \param [out] field the bytes of the field
+  *
+  * \return false if the field exceeds the data
+  *
+  */
+  static bool ReadField (Buffer::Iterator &i, std::string *field);
+
+  const protomessage::ProtoPacket *m_message; //!< the message to serialize, not owned
+  protomessage::ProtoPacket *m_target; //!< the message filled by Deserialize(), not owned
+  uint32_t m_dataSize; //!< holds the size of the serialized data in bytes
+  uint8_t m_type; //!< the ns3::BinaryWrapper::MessageType of the data
+  bool m_parsed; //!< the last Deserialize() parsed a valid message
+  OnionPadding m_padding; //!< the padding following the wrapper in the packet
+};
+} // namespace ns3
+
+#endif /* BINARYWRAPPER_H */
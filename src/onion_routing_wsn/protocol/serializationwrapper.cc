@@ -22,8 +22,173 @@
 #include "ns3/header.h"
 #include "ns3/network-module.h"
 
+#include <algorithm>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+
 namespace ns3 {
 
+namespace {
+
+const int CHUNK_BYTES = 512; //!< bytes staged on the stack between the buffer and protobuf
+
+/**
+ * \brief protobuf output stream writing to a ns3::Buffer::Iterator in chunks
+ *
+ * Pending bytes are written to the buffer at the next chunk and at the destruction, protobuf
+ * backs up the unused part of the last chunk so exactly the serialized bytes are written.
+ */
+class BufferOutputStream : public google::protobuf::io::ZeroCopyOutputStream
+{
+public:
+  explicit BufferOutputStream (Buffer::Iterator i) : m_iterator (i), m_pending (0), m_count (0)
+  {
+  }
+
+  ~BufferOutputStream ()
+  {
+    Flush ();
+  }
+
+  bool
+  Next (void **data, int *size) override
+  {
+    Flush ();
+    *data = m_chunk;
+    *size = CHUNK_BYTES;
+    m_pending = CHUNK_BYTES;
+    m_count += CHUNK_BYTES;
+    return true;
+  }
+
+  void
+  BackUp (int count) override
+  {
+    m_pending -= count;
+    m_count -= count;
+  }
+
+  int64_t
+  ByteCount () const override
+  {
+    return m_count;
+  }
+
+private:
+  void
+  Flush ()
+  {
+    m_iterator.Write (m_chunk, m_pending);
+    m_pending = 0;
+  }
+
+  Buffer::Iterator m_iterator; //!< where the next chunk is written
+  uint8_t m_chunk[CHUNK_BYTES]; //!< the chunk handed to protobuf
+  int m_pending; //!< bytes of the chunk not yet written
+  int64_t m_count; //!< bytes serialized
+};
+
+/**
+ * \brief protobuf input stream reading \p size bytes from a ns3::Buffer::Iterator in chunks
+ */
+class BufferInputStream : public google::protobuf::io::ZeroCopyInputStream
+{
+public:
+  BufferInputStream (Buffer::Iterator i, uint32_t size)
+      : m_iterator (i), m_remaining (size), m_available (0), m_backedUp (0), m_count (0)
+  {
+  }
+
+  bool
+  Next (const void **data, int *size) override
+  {
+    if (m_backedUp > 0)
+      {
+        *data = m_chunk + m_available - m_backedUp;
+        *size = m_backedUp;
+        m_count += m_backedUp;
+        m_backedUp = 0;
+        return true;
+      }
+    if (m_remaining == 0)
+      {
+        return false;
+      }
+    m_available = std::min<uint32_t> (CHUNK_BYTES, m_remaining);
+    m_iterator.Read (m_chunk, m_available);
+    m_remaining -= m_available;
+    m_count += m_available;
+    *data = m_chunk;
+    *size = m_available;
+    return true;
+  }
+
+  void
+  BackUp (int count) override
+  {
+    m_backedUp = count;
+    m_count -= count;
+  }
+
+  bool
+  Skip (int count) override
+  {
+    const void *data;
+    int size;
+    while (count > 0)
+      {
+        if (!Next (&data, &size))
+          {
+            return false;
+          }
+        if (size > count)
+          {
+            BackUp (size - count);
+            return true;
+          }
+        count -= size;
+      }
+    return true;
+  }
+
+  int64_t
+  ByteCount () const override
+  {
+    return m_count;
+  }
+
+private:
+  Buffer::Iterator m_iterator; //!< where the next chunk is read
+  uint8_t m_chunk[CHUNK_BYTES]; //!< the chunk handed to protobuf
+  uint32_t m_remaining; //!< bytes not yet read from the buffer
+  int m_available; //!< bytes of the last chunk read
+  int m_backedUp; //!< bytes of the last chunk returned by protobuf
+  int64_t m_count; //!< bytes handed to protobuf
+};
+
+/**
+ * \brief read a varint of at most 32 bits from \p data
+ *
+ * \return false if the varint exceeds \p len or 32 bits
+ */
+bool
+ReadVarint32 (const uint8_t *data, uint32_t len, uint32_t &pos, uint32_t &value)
+{
+  value = 0;
+  for (uint32_t shift = 0; shift < 35 && pos < len; shift += 7)
+    {
+      uint8_t byte = data[pos++];
+      value |= (uint32_t) (byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+} // namespace
+
 //Zagotovi, da se registrira TypeId
 NS_OBJECT_ENSURE_REGISTERED (SerializationWrapper);
 
@@ -45,83 +210,112 @@ SerializationWrapper::GetInstanceTypeId (void) const
 }
 
 SerializationWrapper::SerializationWrapper ()
+    : m_message (nullptr), m_target (nullptr), m_dataSize (0), m_parsed (false)
 {
 }
 
 SerializationWrapper::~SerializationWrapper ()
 {
-  //delete[] m_data;
 }
 
 //nastavi protobuf object
 void
-SerializationWrapper::SetData (protomessage::ProtoPacket message)
+SerializationWrapper::SetData (const protomessage::ProtoPacket &message)
 {
-
+  m_message = &message;
+  //caches the sizes of the submessages for SerializeWithCachedSizes
   m_dataSize = message.ByteSizeLong ();
-
-  m_data = new uint8_t[m_dataSize + 4];
-
-  m_data[0] = m_dataSize;
-  m_data[1] = m_dataSize >> 8;
-  m_data[2] = m_dataSize >> 16;
-  m_data[3] = m_dataSize >> 24;
-
-  int size = 0;
-  memcpy (&size, &m_data[0], 4);
-
-  message.SerializeToArray (&m_data[4], m_dataSize);
 }
 
-//vrne protobuf object
 void
-SerializationWrapper::GetData (protomessage::ProtoPacket *message)
+SerializationWrapper::SetTarget (protomessage::ProtoPacket *message)
 {
-  message->ParseFromArray (m_data, m_dataSize);
-  delete[] m_data;
+  m_target = message;
+}
+
+bool
+SerializationWrapper::IsParsed (void) const
+{
+  return m_parsed;
 }
 
 //Kontruktor, ki sprejme protobuf object
-SerializationWrapper::SerializationWrapper (protomessage::ProtoPacket message)
+SerializationWrapper::SerializationWrapper (const protomessage::ProtoPacket &message)
+    : SerializationWrapper ()
 {
   SetData (message);
 }
 
+SerializationWrapper::SerializationWrapper (protomessage::ProtoPacket *message)
+    : SerializationWrapper ()
+{
+  SetTarget (message);
+}
+
 uint32_t
-SerializationWrapper::GetSerializedSize (void) const
+SerializationWrapper::PeekOnionId (Ptr<const Packet> p, int *onionId)
 {
-  if (m_dataSize < 0)
+  //[size, 4B][tag of o_head][length of o_head][tag of onionId][onionId][tag of onion_message]
+  const uint8_t HEAD_TAG = (2 << 3) | 2; //field 2, length-delimited
+  const uint8_t ID_TAG = (1 << 3) | 0; //field 1, varint
+  const uint8_t MESSAGE_TAG = (2 << 3) | 2; //field 2, length-delimited
+  uint8_t data[SIZE_BYTES + 1 + 5 + 1 + 5 + 1];
+  uint32_t len = p->CopyData (data, sizeof (data));
+
+  uint32_t pos = SIZE_BYTES;
+  uint32_t headLen;
+  uint32_t id;
+  if (pos >= len || data[pos++] != HEAD_TAG || !ReadVarint32 (data, len, pos, headLen))
+    {
+      return 0;
+    }
+  uint32_t headStart = pos;
+  if (pos >= len || data[pos++] != ID_TAG || !ReadVarint32 (data, len, pos, id))
+    {
+      return 0;
+    }
+  //the failure notice is an onion head with the onion id only
+  if (pos - headStart >= headLen || pos >= len || data[pos++] != MESSAGE_TAG)
     {
-      std::cout << "message not set " << std::endl;
+      return 0;
     }
+  *onionId = (int32_t) id;
+  return pos;
+}
+
+uint32_t
+SerializationWrapper::GetSerializedSize (void) const
+{
   //4B where the size of the serialization is stored
-  return m_dataSize + 4;
+  return m_dataSize + SIZE_BYTES;
 }
 
 void
 SerializationWrapper::Serialize (Buffer::Iterator start) const
 {
-
+  NS_ASSERT_MSG (m_message != nullptr, "message not set");
   Buffer::Iterator i = start;
-  i.Write (m_data, m_dataSize + 4);
-  delete[] m_data;
+  i.WriteHtolsbU32 (m_dataSize);
+
+  BufferOutputStream stream (i);
+  //the coded stream backs up the unused bytes when destroyed, before the stream is flushed
+  google::protobuf::io::CodedOutputStream coded (&stream);
+  m_message->SerializeWithCachedSizes (&coded);
 }
+
 uint32_t
 SerializationWrapper::Deserialize (Buffer::Iterator start)
 {
-
   Buffer::Iterator i = start;
-  uint8_t *size_arr = new uint8_t[4];
-  int size = 0;
-  i.Read (size_arr, 4);
+  m_dataSize = i.ReadLsbtohU32 ();
+  m_parsed = false;
 
-  memcpy (&size, &size_arr[0], 4);
-  delete[] size_arr;
-
-  m_data = new uint8_t[size];
-  i.Read (m_data, size);
-  m_dataSize = size;
-  return size + 4;
+  if (m_target != nullptr)
+    {
+      BufferInputStream stream (i, m_dataSize);
+      m_parsed = m_target->ParseFromZeroCopyStream (&stream);
+    }
+  return m_dataSize + SIZE_BYTES;
 }
 
 //Ne implementirano
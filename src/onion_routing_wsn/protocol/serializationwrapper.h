@@ -49,6 +49,11 @@ namespace ns3 {
  * \class SerializationWrapper
  * \brief Class for the serialization-deserialization of the messagess to send in packets
  *
+ * The message is serialized straight into the buffer of the packet in Serialize() and parsed
+ * straight from it in Deserialize(), through a chunk on the stack since ns3::Buffer::Iterator does
+ * not expose its memory. The wrapper does not own nor copy the message, which must outlive the
+ * AddHeader() or RemoveHeader() call of the packet.
+ *
  */
 
 class SerializationWrapper : public Header
@@ -56,21 +61,44 @@ class SerializationWrapper : public Header
 public:
   /**
   *
-  * \brief Setter of the data in the protocol header
+  * \brief Setter of the message to serialize, the size of the message is computed and cached
   * 
-  * \param [in] message the protobuff object containing the data to transmit
+  * \param [in] message the protobuff object containing the data to transmit, must not be modified
+  * until the wrapper is added to the packet
   *
   */
-  void SetData (protomessage::ProtoPacket message);
+  void SetData (const protomessage::ProtoPacket &message);
 
   /**
   *
-  * \brief Getter of the data in the protocol header
+  * \brief Setter of the message filled by Deserialize()
   * 
   * \param [in,out] message pointer to the protobuff object for storing data
   *
   */
-  void GetData (protomessage::ProtoPacket *message);
+  void SetTarget (protomessage::ProtoPacket *message);
+
+  /**
+  *
+  * \brief accessor
+  *
+  * \return true if the last Deserialize() parsed a valid message into the target
+  *
+  */
+  bool IsParsed (void) const;
+
+  /**
+  *
+  * \brief Read the onion id of the onion message at the start of \p p, without parsing the
+  *        message: the onion id is the first field of the onion head, the first field of the message
+  *
+  * \param [in] p the packet, or its first segment
+  * \param [out] onionId the onion id
+  *
+  * \return the bytes read, 0 if \p p does not start with an onion message
+  *
+  */
+  static uint32_t PeekOnionId (Ptr<const Packet> p, int *onionId);
 
   /**
  *  Register this type.
@@ -90,12 +118,21 @@ public:
 
   /**
   *
-  * \brief Constructor with argument
+  * \brief Constructor of a wrapper sending a message
   * 
   * \param [in] message the protobuff object containing the data to transmit
   *
   */
-  SerializationWrapper (protomessage::ProtoPacket message);
+  SerializationWrapper (const protomessage::ProtoPacket &message);
+
+  /**
+  *
+  * \brief Constructor of a wrapper receiving a message
+  * 
+  * \param [in,out] message pointer to the protobuff object for storing data
+  *
+  */
+  SerializationWrapper (protomessage::ProtoPacket *message);
 
   /**
  *  
@@ -121,7 +158,7 @@ public:
   virtual void Serialize (Buffer::Iterator start) const;
   /**
  * 
- *  \brief deserialize the data
+ *  \brief deserialize the data, parsed into the target if set
  * 
  *  \param [in,out] start	an iterator which points to where the data should read from.
  * 
@@ -137,9 +174,13 @@ public:
  */
   virtual void Print (std::ostream &os) const;
 
-  int m_dataSize = 0; //!< holds the size of the serialized data in bytes
+  static const uint32_t SIZE_BYTES = 4; //!< bytes of the size prefix of the serialized data
 
-  uint8_t *m_data; //!< the serialized data
+private:
+  const protomessage::ProtoPacket *m_message; //!< the message to serialize, not owned
+  protomessage::ProtoPacket *m_target; //!< the message filled by Deserialize(), not owned
+  uint32_t m_dataSize; //!< holds the size of the serialized data in bytes
+  bool m_parsed; //!< the last Deserialize() parsed a valid message
 };
 } // namespace ns3
 
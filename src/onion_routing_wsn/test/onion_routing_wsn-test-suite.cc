@@ -1,55 +1,722 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
-// Include a header file from your module to test.
-#include "ns3/onion_routing_wsn.h"
-
-// An essential include is test.h
+#include "ns3/binarywrapper.h"
+#include "ns3/circuit.h"
+#include "ns3/onionmanager.h"
+#include "ns3/onionpool.h"
+#include "ns3/onionstream.h"
+#include "ns3/packet.h"
+#include "ns3/serializationwrapper.h"
+#include "ns3/sphinxonionmanager.h"
 #include "ns3/test.h"
 
+#include <string.h>
+#include <vector>
+
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
 using namespace ns3;
 
-// This is an example TestCase.
-class Onion_routing_wsnTestCase1 : public TestCase
+/**
+ * \ingroup onion_routing_wsn
+ * \brief Sealed-box onions are peeled in place on the message string by every hop
+ */
+class OnionManagerPeelTestCase : public TestCase
+{
+public:
+  OnionManagerPeelTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+OnionManagerPeelTestCase::OnionManagerPeelTestCase ()
+  : TestCase ("Sealed-box onions are peeled in place by every hop")
+{
+}
+
+void
+OnionManagerPeelTestCase::DoRun (void)
+{
+  const uint16_t routeLen = 5;
+  std::vector<Ptr<OnionManager>> nodes;
+  std::vector<uint8_t> addresses (routeLen * 4);
+  std::vector<uint8_t *> route (routeLen);
+  std::vector<uint8_t *> keys (routeLen);
+  for (uint16_t i = 0; i < routeLen; ++i)
+    {
+      nodes.push_back (CreateObject<OnionManager> ());
+      nodes[i]->GenerateNewKeyPair ();
+      uint8_t address[4] = {10, 1, 1, (uint8_t) (i + 1)};
+      memcpy (&addresses[i * 4], address, 4);
+      route[i] = &addresses[i * 4];
+      keys[i] = nodes[i]->GetPK ();
+    }
+
+  Ptr<OnionManager> sink = nodes[routeLen - 1];
+  std::string onion (sink->OnionLength (routeLen, 0, 0), 0);
+  sink->BuildOnion (reinterpret_cast<uint8_t *> (&onion[0]), &route[0], &keys[0], routeLen);
+  NS_TEST_ASSERT_MSG_EQ (sink->GetErrno (), OnionRouting::ERROR_NOTERROR, "construction failed");
+
+  //as the sensor node, the inner onion is moved to the front of the string
+  for (uint16_t hop = 0; hop + 1 < routeLen; ++hop)
+    {
+      orLayer layer = nodes[hop]->PeelOnionInPlace (reinterpret_cast<uint8_t *> (&onion[0]),
+                                                    onion.length (), nodes[hop]->GetPK (),
+                                                    nodes[hop]->GetDecryptionKey ());
+      NS_TEST_ASSERT_MSG_EQ (nodes[hop]->GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "hop " << hop << " can not peel its layer");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (layer.nextHopIP, route[hop + 1], 4), 0,
+                             "wrong next hop at hop " << hop);
+      onion.erase (0, layer.innerLayer - reinterpret_cast<uint8_t *> (&onion[0]));
+      NS_TEST_ASSERT_MSG_EQ (onion.length (), layer.innerLayerLen, "wrong inner onion length");
+    }
+  NS_TEST_ASSERT_MSG_EQ (onion.length (), 0, "the last layer is not empty");
+
+  //a layer is authenticated
+  onion.resize (sink->OnionLength (routeLen, 0, 0));
+  sink->BuildOnion (reinterpret_cast<uint8_t *> (&onion[0]), &route[0], &keys[0], routeLen);
+  onion[onion.length () - 1] ^= 1;
+  nodes[0]->PeelOnionInPlace (reinterpret_cast<uint8_t *> (&onion[0]), onion.length (),
+                              nodes[0]->GetPK (), nodes[0]->GetDecryptionKey ());
+  NS_TEST_ASSERT_MSG_EQ (nodes[0]->GetErrno (), OnionRouting::ERROR_DECRYPTION,
+                         "corrupted layer peeled");
+}
+
+/**
+ * \ingroup onion_routing_wsn
+ * \brief Every hop of a Sphinx onion head finds its next hop, the head keeps its size
+ */
+class SphinxOnionTestCase : public TestCase
+{
+public:
+  SphinxOnionTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SphinxOnionTestCase::SphinxOnionTestCase ()
+  : TestCase ("Sphinx onion heads are processed hop by hop")
+{
+}
+
+void
+SphinxOnionTestCase::DoRun (void)
+{
+  const uint16_t routeLen = 6;
+  std::vector<Ptr<SphinxOnionManager>> nodes;
+  std::vector<uint8_t> addresses (routeLen * 4);
+  std::vector<uint8_t *> route (routeLen);
+  std::vector<uint8_t *> keys (routeLen);
+  for (uint16_t i = 0; i < routeLen; ++i)
+    {
+      nodes.push_back (CreateObject<SphinxOnionManager> ());
+      nodes[i]->GenerateNewKeyPair ();
+      uint8_t address[4] = {10, 1, 2, (uint8_t) (i + 1)};
+      memcpy (&addresses[i * 4], address, 4);
+      route[i] = &addresses[i * 4];
+      keys[i] = nodes[i]->GetPK ();
+    }
+
+  Ptr<SphinxOnionManager> sink = nodes[routeLen - 1];
+  uint16_t len = sink->OnionLength (routeLen, 0, 0);
+  std::vector<uint8_t> head (len);
+  sink->BuildOnion (&head[0], &route[0], &keys[0], routeLen);
+  NS_TEST_ASSERT_MSG_EQ (sink->GetErrno (), OnionRouting::ERROR_NOTERROR, "construction failed");
+
+  std::vector<uint8_t> corrupted (head);
+  corrupted[SphinxOnionManager::HEADER_BYTES] ^= 1;
+
+  for (uint16_t hop = 0; hop + 1 < routeLen; ++hop)
+    {
+      orLayer layer = nodes[hop]->PeelOnionInPlace (&head[0], len, nodes[hop]->GetPK (),
+                                                    nodes[hop]->GetDecryptionKey ());
+      NS_TEST_ASSERT_MSG_EQ (nodes[hop]->GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "hop " << hop << " can not process the head");
+      NS_TEST_ASSERT_MSG_EQ (layer.innerLayerLen, len, "the head changed size");
+      NS_TEST_ASSERT_MSG_EQ (memcmp (layer.nextHopIP, route[hop + 1], 4), 0,
+                             "wrong next hop at hop " << hop);
+    }
+
+  //the head is processed only by the hop it is addressed to, and is authenticated
+  nodes[1]->PeelOnionInPlace (&corrupted[0], len, nodes[1]->GetPK (),
+                              nodes[1]->GetDecryptionKey ());
+  NS_TEST_ASSERT_MSG_EQ (nodes[1]->GetErrno (), OnionRouting::ERROR_DECRYPTION,
+                         "head processed by the wrong hop");
+  nodes[0]->PeelOnionInPlace (&corrupted[0], len, nodes[0]->GetPK (),
+                              nodes[0]->GetDecryptionKey ());
+  NS_TEST_ASSERT_MSG_EQ (nodes[0]->GetErrno (), OnionRouting::ERROR_DECRYPTION,
+                         "corrupted head processed");
+}
+
+/**
+ * \ingroup onion_routing_wsn
+ * \brief Onions of the pool are built by the worker or by Take(), in the order of submission
+ */
+class OnionPoolTestCase : public TestCase
+{
+public:
+  OnionPoolTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+OnionPoolTestCase::OnionPoolTestCase ()
+  : TestCase ("Onions of the pool are taken in order and peeled by the first hop")
+{
+}
+
+void
+OnionPoolTestCase::DoRun (void)
+{
+  const uint16_t routeLen = 5;
+  const uint16_t count = 12;
+  std::vector<Ptr<OnionManager>> nodes;
+  for (uint16_t i = 0; i < routeLen; ++i)
+    {
+      nodes.push_back (CreateObject<OnionManager> ());
+      nodes[i]->GenerateNewKeyPair ();
+    }
+
+  SealedBoxOnionRouting builder;
+  OnionPool pool;
+  pool.Start (&builder, 2, 2);
+  NS_TEST_ASSERT_MSG_EQ (pool.IsRunning (), true, "the worker did not start");
+
+  //the first hop of onion i is 10.1.3.i, onions alternate between the pools
+  for (uint16_t i = 0; i < count; ++i)
+    {
+      std::shared_ptr<PooledOnion> onion (new PooledOnion (4, OnionManager::LAYER_KEY_BYTES));
+      for (uint16_t hop = 0; hop < routeLen; ++hop)
+        {
+          uint8_t address[4] = {10, 1, 3, (uint8_t) (hop == 0 ? i : 100 + hop)};
+          onion->route.AddHop (address, nodes[hop]->GetPK ());
+        }
+      onion->cipher.resize (builder.OnionLength (routeLen, 0, 0));
+      pool.Submit (i % 2, onion);
+    }
+  NS_TEST_ASSERT_MSG_EQ (pool.GetPending (0), count / 2, "wrong number of pending onions");
+
+  //some onions are taken before the worker reaches them
+  for (uint16_t i = 0; i < count; ++i)
+    {
+      std::shared_ptr<PooledOnion> onion = pool.Take (i % 2);
+      NS_TEST_ASSERT_MSG_EQ (onion->done, true, "onion " << i << " not built");
+      NS_TEST_ASSERT_MSG_EQ (onion->status, OnionRouting::ERROR_NOTERROR,
+                             "construction of onion " << i << " failed");
+      NS_TEST_ASSERT_MSG_EQ (onion->route.GetAddress (0)[3], i, "onion " << i << " out of order");
+      orLayer layer = nodes[0]->PeelOnionInPlace ((uint8_t *) &onion->cipher[0],
+                                                  onion->cipher.length (), nodes[0]->GetPK (),
+                                                  nodes[0]->GetDecryptionKey ());
+      NS_TEST_ASSERT_MSG_EQ (nodes[0]->GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "onion " << i << " can not be peeled");
+      NS_TEST_ASSERT_MSG_EQ (layer.nextHopIP[3], 101, "wrong next hop of onion " << i);
+    }
+
+  //onions still queued are discarded
+  for (uint16_t i = 0; i < count; ++i)
+    {
+      std::shared_ptr<PooledOnion> onion (new PooledOnion (4, OnionManager::LAYER_KEY_BYTES));
+      for (uint16_t hop = 0; hop < routeLen; ++hop)
+        {
+          uint8_t address[4] = {10, 1, 3, (uint8_t) hop};
+          onion->route.AddHop (address, nodes[hop]->GetPK ());
+        }
+      onion->cipher.resize (builder.OnionLength (routeLen, 0, 0));
+      pool.Submit (0, onion);
+    }
+  pool.Stop ();
+  NS_TEST_ASSERT_MSG_EQ (pool.IsRunning (), false, "the worker did not stop");
+}
+
+/**
+ * \ingroup onion_routing_wsn
+ * \brief A circuit is installed by its setup onion, cells are peeled by every hop and opened by the sink
+ */
+class CircuitTestCase : public TestCase
+{
+public:
+  CircuitTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+CircuitTestCase::CircuitTestCase ()
+  : TestCase ("Circuits are set up by an onion and carry cells to the sink")
+{
+}
+
+void
+CircuitTestCase::DoRun (void)
+{
+  //sensor nodes and the sink
+  const uint16_t hops = 5;
+  std::vector<Ptr<OnionManager>> nodes;
+  std::vector<CircuitTable> tables (hops - 1, CircuitTable (4));
+  std::vector<uint8_t> addresses (hops * 4);
+  std::vector<uint8_t *> route (hops);
+  std::vector<uint8_t *> keys (hops);
+  for (uint16_t i = 0; i < hops; ++i)
+    {
+      nodes.push_back (CreateObject<OnionManager> ());
+      nodes[i]->GenerateNewKeyPair ();
+      uint8_t address[4] = {10, 1, 3, (uint8_t) (i + 1)};
+      memcpy (&addresses[i * 4], address, 4);
+      route[i] = &addresses[i * 4];
+      keys[i] = nodes[i]->GetPK ();
+    }
+
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  rng->SetStream (1);
+  Circuit circuit;
+  circuit.Create (hops, Circuit::ReadId (route[0]), Seconds (0), rng);
+  std::vector<uint8_t> content (hops * Circuit::SETUP_CONTENT_BYTES);
+  std::vector<uint8_t *> layerContent (hops);
+  circuit.FillSetupContent (&content[0]);
+  for (uint16_t i = 0; i < hops; ++i)
+    {
+      layerContent[i] = &content[i * Circuit::SETUP_CONTENT_BYTES];
+    }
+
+  Ptr<OnionManager> sink = nodes[hops - 1];
+  std::string onion (sink->OnionLength (hops, Circuit::SETUP_CONTENT_BYTES, 0), 0);
+  sink->BuildOnion (reinterpret_cast<uint8_t *> (&onion[0]), &route[0], &keys[0],
+                    &layerContent[0], Circuit::SETUP_CONTENT_BYTES, hops);
+  NS_TEST_ASSERT_MSG_EQ (sink->GetErrno (), OnionRouting::ERROR_NOTERROR,
+                         "construction of the setup onion failed");
+
+  //as the sensor node, each hop installs its circuit from the layer content
+  for (uint16_t hop = 0; hop + 1 < hops; ++hop)
+    {
+      orLayer layer = nodes[hop]->PeelOnionInPlace (reinterpret_cast<uint8_t *> (&onion[0]),
+                                                    onion.length (), nodes[hop]->GetPK (),
+                                                    nodes[hop]->GetDecryptionKey ());
+      NS_TEST_ASSERT_MSG_EQ (nodes[hop]->GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "hop " << hop << " can not peel the setup onion");
+      uint32_t id;
+      CircuitHop state;
+      state.nextHop = Circuit::ReadId (layer.nextHopIP);
+      Circuit::ReadSetupContent (layer.innerLayer, id, state);
+      NS_TEST_ASSERT_MSG_NE (id, Circuit::SETUP_ID, "circuit id of hop " << hop);
+      tables[hop].Add (id, state);
+      onion.assign (reinterpret_cast<char *> (layer.innerLayer) + Circuit::SETUP_CONTENT_BYTES,
+                    layer.innerLayerLen - Circuit::SETUP_CONTENT_BYTES);
+    }
+
+  //cells of the circuit, each with its own nonces
+  std::string previous;
+  for (int c = 0; c < 3; ++c)
+    {
+      std::string cell (circuit.GetCellLength (), 0);
+      NS_TEST_ASSERT_MSG_EQ (circuit.BuildCell (reinterpret_cast<uint8_t *> (&cell[0])), true,
+                             "encryption of cell " << c << " failed");
+      NS_TEST_ASSERT_MSG_NE (cell, previous, "cell " << c << " repeats the previous cell");
+      previous = cell;
+
+      for (uint16_t hop = 0; hop + 1 < hops; ++hop)
+        {
+          uint8_t *data = reinterpret_cast<uint8_t *> (&cell[0]);
+          uint32_t id = Circuit::ReadId (data);
+          const CircuitHop *state = tables[hop].Find (id);
+          NS_TEST_ASSERT_MSG_EQ ((state != nullptr), true,
+                                 "hop " << hop << " does not know the circuit");
+          NS_TEST_ASSERT_MSG_EQ (state->nextHop, Circuit::ReadId (route[hop + 1]),
+                                 "wrong next hop at hop " << hop);
+          NS_TEST_ASSERT_MSG_EQ (Circuit::OpenLayer (data + Circuit::ID_BYTES,
+                                                     cell.length () - Circuit::ID_BYTES,
+                                                     state->key, id),
+                                 true, "hop " << hop << " can not open cell " << c);
+          Circuit::WriteId (data + Circuit::LAYER_OVERHEAD, state->nextId);
+          cell.erase (0, Circuit::LAYER_OVERHEAD);
+        }
+      NS_TEST_ASSERT_MSG_EQ (circuit.OpenCell (reinterpret_cast<uint8_t *> (&cell[0]),
+                                               cell.length ()),
+                             true, "the sink can not open cell " << c);
+    }
+  NS_TEST_ASSERT_MSG_EQ (circuit.GetUses (), 4, "the setup onion and the cells are counted");
+
+  //layers are authenticated with the circuit id
+  std::string cell (circuit.GetCellLength (), 0);
+  circuit.BuildCell (reinterpret_cast<uint8_t *> (&cell[0]));
+  uint8_t *data = reinterpret_cast<uint8_t *> (&cell[0]);
+  const CircuitHop *state = tables[0].Find (Circuit::ReadId (data));
+  NS_TEST_ASSERT_MSG_EQ (Circuit::OpenLayer (data + Circuit::ID_BYTES,
+                                             cell.length () - Circuit::ID_BYTES, state->key,
+                                             Circuit::ReadId (data) + 1),
+                         false, "layer opened with another circuit id");
+
+  //a circuit drawn from the same stream has the same ids, keys and cells
+  Ptr<UniformRandomVariable> other = CreateObject<UniformRandomVariable> ();
+  other->SetStream (1);
+  Circuit replay;
+  replay.Create (hops, Circuit::ReadId (route[0]), Seconds (0), other);
+  std::vector<uint8_t> replayContent (hops * Circuit::SETUP_CONTENT_BYTES);
+  replay.FillSetupContent (&replayContent[0]);
+  NS_TEST_ASSERT_MSG_EQ ((replayContent == content), true, "the setup content differs");
+  //the circuit built four cells, the fifth cells are equal
+  std::string expected (replay.GetCellLength (), 0);
+  for (int c = 0; c < 5; ++c)
+    {
+      replay.BuildCell (reinterpret_cast<uint8_t *> (&expected[0]));
+    }
+  circuit.BuildCell (reinterpret_cast<uint8_t *> (&cell[0]));
+  NS_TEST_ASSERT_MSG_EQ (cell, expected, "the cells differ");
+}
+
+/**
+ * \brief A handshake, an onion and a failure notice, the messages exchanged by the nodes
+ */
+struct WireFormatTestMessages
+{
+  WireFormatTestMessages ()
+  {
+    handshake.mutable_h_shake ()->set_publickey (std::string (32, 'k'));
+    onion.mutable_o_head ()->set_onionid (300000);
+    onion.mutable_o_head ()->set_onion_message (std::string ("\0onion\xff", 7) +
+                                                std::string (400, 'o'));
+    onion.mutable_o_body ()->set_aggregatedvalue (-42);
+    notice.mutable_o_head ()->set_onionid (7);
+  }
+
+  protomessage::ProtoPacket handshake; //!< handshake carrying a public key
+  protomessage::ProtoPacket onion; //!< onion 300000 with an aggregated value
+  protomessage::ProtoPacket notice; //!< failure notice of the onion 7
+};
+
+/**
+ * \brief Packet carrying \p message in the wire format \p W
+ * \param [in] message the message to send
+ * \return the packet
+ */
+template <class W>
+static Ptr<Packet>
+EncodeMessage (const protomessage::ProtoPacket &message)
+{
+  Ptr<Packet> p = Create<Packet> ();
+  W tx;
+  tx.SetData (message);
+  p->AddHeader (tx);
+  return p;
+}
+
+/**
+ * \ingroup onion_routing_wsn
+ * \brief Messages survive the protobuf and the binary wire formats
+ */
+class WireFormatTestCase : public TestCase
 {
 public:
-  Onion_routing_wsnTestCase1 ();
-  virtual ~Onion_routing_wsnTestCase1 ();
+  WireFormatTestCase ();
 
 private:
   virtual void DoRun (void);
+
+  /**
+   * \brief Encode \p message in the wire format \p W and decode it
+   * \param [in] message the message to send
+   * \param [out] decoded the received message
+   * \return the packet after the wrapper is removed
+   */
+  template <class W>
+  Ptr<Packet> RoundTrip (const protomessage::ProtoPacket &message,
+                         protomessage::ProtoPacket *decoded);
 };
 
-// Add some help text to this case to describe what it is intended to test
-Onion_routing_wsnTestCase1::Onion_routing_wsnTestCase1 ()
-  : TestCase ("onion_routing_wsn test case (does nothing)")
+WireFormatTestCase::WireFormatTestCase ()
+  : TestCase ("Messages are encoded and decoded by the protobuf and the binary wire formats")
+{
+}
+
+template <class W>
+Ptr<Packet>
+WireFormatTestCase::RoundTrip (const protomessage::ProtoPacket &message,
+                               protomessage::ProtoPacket *decoded)
+{
+  Ptr<Packet> p = EncodeMessage<W> (message);
+  W rx (decoded);
+  p->RemoveHeader (rx);
+  NS_TEST_EXPECT_MSG_EQ (rx.IsParsed (), true, "message not parsed");
+  return p;
+}
+
+void
+WireFormatTestCase::DoRun (void)
 {
+  WireFormatTestMessages m;
+  protomessage::ProtoPacket decoded;
+
+  //protobuf -- the padding is carried by the message
+  protomessage::ProtoPacket padded (m.onion);
+  padded.mutable_o_head ()->set_padding (std::string (120, '0'));
+  padded.mutable_o_body ()->set_padding (std::string (33, '0'));
+  const protomessage::ProtoPacket *messages[] = {&m.handshake, &padded, &m.notice};
+  for (int i = 0; i < 3; ++i)
+    {
+      Ptr<Packet> p = RoundTrip<SerializationWrapper> (*messages[i], &decoded);
+      NS_TEST_ASSERT_MSG_EQ (decoded.SerializeAsString (), messages[i]->SerializeAsString (),
+                             "protobuf message " << i << " changed");
+      NS_TEST_ASSERT_MSG_EQ (p->GetSize (), 0, "bytes left after protobuf message " << i);
+    }
+
+  //binary -- the fields of the message, without the padding
+  messages[1] = &m.onion;
+  for (int i = 0; i < 3; ++i)
+    {
+      Ptr<Packet> p = RoundTrip<BinaryWrapper> (*messages[i], &decoded);
+      NS_TEST_ASSERT_MSG_EQ (decoded.SerializeAsString (), messages[i]->SerializeAsString (),
+                             "binary message " << i << " changed");
+      NS_TEST_ASSERT_MSG_EQ (p->GetSize (), 0, "bytes left after binary message " << i);
+    }
 }
 
-// This destructor does nothing but we include it as a reminder that
-// the test case should clean up after itself
-Onion_routing_wsnTestCase1::~Onion_routing_wsnTestCase1 ()
+/**
+ * \ingroup onion_routing_wsn
+ * \brief Only the lengths of the padding of binary onions are encoded, its zero bytes stay in the packet
+ */
+class VirtualPaddingTestCase : public TestCase
+{
+public:
+  VirtualPaddingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+VirtualPaddingTestCase::VirtualPaddingTestCase ()
+  : TestCase ("The virtual padding of binary onions is left in the packet")
 {
 }
 
-//
-// This method is the pure virtual method from class TestCase that every
-// TestCase must implement
-//
 void
-Onion_routing_wsnTestCase1::DoRun (void)
+VirtualPaddingTestCase::DoRun (void)
 {
-  // A wide variety of test macros are available in src/core/test.h
-  NS_TEST_ASSERT_MSG_EQ (true, true, "true doesn't equal true for some reason");
-  // Use this one for floating point comparisons
-  NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
+  WireFormatTestMessages m;
+  protomessage::ProtoPacket decoded;
+
+  //the length of the body padding exceeds 16 bits
+  OnionPadding padding;
+  padding.head = true;
+  padding.headLen = 120;
+  padding.body = true;
+  padding.bodyLen = 70000;
+
+  Ptr<Packet> p = Create<Packet> (padding.GetSize ());
+  BinaryWrapper tx;
+  tx.SetPadding (padding);
+  tx.SetData (m.onion);
+  p->AddHeader (tx);
+  NS_TEST_ASSERT_MSG_EQ (p->GetSize (), EncodeMessage<BinaryWrapper> (m.onion)->GetSize () + 8 +
+                                            padding.GetSize (),
+                         "the padding is not counted once");
+
+  //the padding may be set after the message
+  BinaryWrapper late;
+  late.SetData (m.onion);
+  late.SetPadding (padding);
+  NS_TEST_ASSERT_MSG_EQ (late.GetSerializedSize (), tx.GetSerializedSize (),
+                         "padding set after the message not counted");
+
+  //a relay removes the wrapper and adds it back to the same packet
+  for (int hop = 0; hop < 2; ++hop)
+    {
+      BinaryWrapper rx (&decoded);
+      p->RemoveHeader (rx);
+      NS_TEST_ASSERT_MSG_EQ (rx.IsParsed (), true, "onion not parsed at hop " << hop);
+      NS_TEST_ASSERT_MSG_EQ (decoded.SerializeAsString (), m.onion.SerializeAsString (),
+                             "onion changed at hop " << hop);
+      NS_TEST_ASSERT_MSG_EQ (rx.GetPadding ().head, true, "wrong head padding flag");
+      NS_TEST_ASSERT_MSG_EQ (rx.GetPadding ().headLen, padding.headLen, "wrong head padding");
+      NS_TEST_ASSERT_MSG_EQ (rx.GetPadding ().body, true, "wrong body padding flag");
+      NS_TEST_ASSERT_MSG_EQ (rx.GetPadding ().bodyLen, padding.bodyLen, "wrong body padding");
+      NS_TEST_ASSERT_MSG_EQ (p->GetSize (), padding.GetSize (), "the padding left the packet");
+
+      BinaryWrapper relay;
+      relay.SetPadding (rx.GetPadding ());
+      relay.SetData (decoded);
+      p->AddHeader (relay);
+    }
+
+  //the padding announced by the wrapper must follow it
+  BinaryWrapper truncated (&decoded);
+  p->RemoveAtEnd (1);
+  p->RemoveHeader (truncated);
+  NS_TEST_ASSERT_MSG_EQ (truncated.IsParsed (), false, "onion with truncated padding parsed");
 }
 
-// The TestSuite class names the TestSuite, identifies what type of TestSuite,
-// and enables the TestCases to be run.  Typically, only the constructor for
-// this class must be defined
-//
+/**
+ * \ingroup onion_routing_wsn
+ * \brief The onion id is peeked from both wire formats and from the first segment of an onion
+ */
+class PeekOnionIdTestCase : public TestCase
+{
+public:
+  PeekOnionIdTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+PeekOnionIdTestCase::PeekOnionIdTestCase ()
+  : TestCase ("The onion id is peeked without parsing the message")
+{
+}
+
+void
+PeekOnionIdTestCase::DoRun (void)
+{
+  WireFormatTestMessages m;
+  const protomessage::ProtoPacket *messages[] = {&m.handshake, &m.onion, &m.notice};
+  const int ids[] = {-1, 300000, -1};
+  int onionId;
+  for (int i = 0; i < 3; ++i)
+    {
+      onionId = -1;
+      SerializationWrapper::PeekOnionId (EncodeMessage<SerializationWrapper> (*messages[i]),
+                                         &onionId);
+      NS_TEST_ASSERT_MSG_EQ (onionId, ids[i], "wrong onion id peeked from protobuf message " << i);
+      onionId = -1;
+      BinaryWrapper::PeekOnionId (EncodeMessage<BinaryWrapper> (*messages[i]), &onionId);
+      NS_TEST_ASSERT_MSG_EQ (onionId, ids[i], "wrong onion id peeked from binary message " << i);
+    }
+
+  //the onion id is peeked from the first segment of an onion
+  Ptr<Packet> p = EncodeMessage<SerializationWrapper> (m.onion);
+  onionId = -1;
+  NS_TEST_ASSERT_MSG_GT (SerializationWrapper::PeekOnionId (p->CreateFragment (0, 16), &onionId),
+                         0, "onion id not peeked from a segment");
+  NS_TEST_ASSERT_MSG_EQ (onionId, 300000, "wrong onion id peeked from a segment");
+  NS_TEST_ASSERT_MSG_EQ (SerializationWrapper::PeekOnionId (p->CreateFragment (0, 6), &onionId),
+                         0, "onion id peeked from a truncated segment");
+
+  p = EncodeMessage<BinaryWrapper> (m.onion);
+  NS_TEST_ASSERT_MSG_EQ (BinaryWrapper::PeekOnionId (p->CreateFragment (0, 5), &onionId), 0,
+                         "onion id peeked from a truncated binary segment");
+}
+
+/**
+ * \ingroup onion_routing_wsn
+ * \brief The chunks of a stream are decrypted hop by hop with the keys carried by the onion head
+ */
+class OnionStreamTestCase : public TestCase
+{
+public:
+  OnionStreamTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+OnionStreamTestCase::OnionStreamTestCase ()
+  : TestCase ("Stream chunks are peeled by every hop up to the final chunk")
+{
+}
+
+void
+OnionStreamTestCase::DoRun (void)
+{
+  const uint16_t routeLen = 5;
+  std::vector<Ptr<OnionManager>> nodes;
+  std::vector<uint8_t> addresses (routeLen * 4);
+  std::vector<uint8_t *> route (routeLen);
+  std::vector<uint8_t *> keys (routeLen);
+  for (uint16_t i = 0; i < routeLen; ++i)
+    {
+      nodes.push_back (CreateObject<OnionManager> ());
+      nodes[i]->GenerateNewKeyPair ();
+      uint8_t address[4] = {10, 1, 3, (uint8_t) (i + 1)};
+      memcpy (&addresses[i * 4], address, 4);
+      route[i] = &addresses[i * 4];
+      keys[i] = nodes[i]->GetPK ();
+    }
+
+  //the sink builds the head carrying the stream of each hop, and keeps the stream of its own layer
+  OnionStreamSender sender;
+  sender.Init (routeLen);
+  Ptr<OnionManager> sink = nodes[routeLen - 1];
+  std::string head (sink->OnionLength (routeLen, OnionStreamSender::LAYER_CONTENT_BYTES, 0), 0);
+  sink->BuildOnion (reinterpret_cast<uint8_t *> (&head[0]), &route[0], &keys[0],
+                    sender.GetLayerContent (), OnionStreamSender::LAYER_CONTENT_BYTES, routeLen);
+  NS_TEST_ASSERT_MSG_EQ (sink->GetErrno (), OnionRouting::ERROR_NOTERROR, "construction failed");
+
+  std::vector<OnionStreamReceiver> receivers (routeLen);
+  for (uint16_t hop = 0; hop + 1 < routeLen; ++hop)
+    {
+      orLayer layer = nodes[hop]->PeelOnionInPlace (reinterpret_cast<uint8_t *> (&head[0]),
+                                                    head.length (), nodes[hop]->GetPK (),
+                                                    nodes[hop]->GetDecryptionKey ());
+      NS_TEST_ASSERT_MSG_EQ (nodes[hop]->GetErrno (), OnionRouting::ERROR_NOTERROR,
+                             "hop " << hop << " can not peel its layer");
+      NS_TEST_ASSERT_MSG_EQ (receivers[hop].Init (layer.innerLayer), true,
+                             "hop " << hop << " can not initialize the stream");
+      head.erase (0, layer.innerLayer - reinterpret_cast<uint8_t *> (&head[0]) +
+                         OnionStreamSender::LAYER_CONTENT_BYTES);
+    }
+  receivers[routeLen - 1].Init (sender.GetLayerContent ()[routeLen - 1]);
+
+  //every hop removes one layer, the last hop recovers the chunk and the final tag
+  const uint32_t chunkLens[] = {100, 0, 37};
+  for (int c = 0; c < 3; ++c)
+    {
+      std::vector<uint8_t> chunk (chunkLens[c], (uint8_t) (c + 1));
+      uint32_t len = sender.EncryptedChunkLength (chunkLens[c]);
+      std::vector<uint8_t> in (len), out (len);
+      NS_TEST_ASSERT_MSG_EQ (sender.EncryptChunk (in.data (), chunk.data (), chunkLens[c], c == 2),
+                             true, "chunk " << c << " not encrypted");
+      bool last = false;
+      for (uint16_t hop = 0; hop < routeLen; ++hop)
+        {
+          NS_TEST_ASSERT_MSG_EQ (receivers[hop].DecryptChunk (out.data (), in.data (), len, &last),
+                                 true, "hop " << hop << " can not decrypt chunk " << c);
+          NS_TEST_ASSERT_MSG_EQ (last, c == 2, "wrong final tag of chunk " << c);
+          len -= OnionStreamSender::CHUNK_OVERHEAD;
+          in.swap (out);
+        }
+      NS_TEST_ASSERT_MSG_EQ (len, chunkLens[c], "wrong length of chunk " << c);
+      NS_TEST_ASSERT_MSG_EQ (memcmp (in.data (), chunk.data (), len), 0, "chunk " << c << " changed");
+    }
+  for (uint16_t hop = 0; hop < routeLen; ++hop)
+    {
+      NS_TEST_ASSERT_MSG_EQ (receivers[hop].IsFinished (), true, "hop " << hop << " not finished");
+    }
+
+  //a chunk after the final one is rejected
+  std::vector<uint8_t> in (sender.EncryptedChunkLength (8)), out (in.size ());
+  sender.EncryptChunk (in.data (), out.data (), 8, false);
+  bool last;
+  NS_TEST_ASSERT_MSG_EQ (receivers[0].DecryptChunk (out.data (), in.data (), in.size (), &last),
+                         false, "chunk after the final one decrypted");
+
+  //corrupted, truncated and reordered chunks are rejected without breaking the stream, a stream
+  //without the final chunk is not finished
+  sender.Init (routeLen);
+  OnionStreamReceiver receiver;
+  receiver.Init (sender.GetLayerContent ()[0]);
+  std::vector<uint8_t> first (sender.EncryptedChunkLength (8)), second (first.size ());
+  sender.EncryptChunk (first.data (), in.data (), 8, false);
+  sender.EncryptChunk (second.data (), in.data (), 8, false);
+  NS_TEST_ASSERT_MSG_EQ (receiver.DecryptChunk (out.data (), second.data (), second.size (), &last),
+                         false, "reordered chunk decrypted");
+  NS_TEST_ASSERT_MSG_EQ (receiver.DecryptChunk (out.data (), first.data (), first.size () - 1, &last),
+                         false, "truncated chunk decrypted");
+  first[first.size () - 1] ^= 1;
+  NS_TEST_ASSERT_MSG_EQ (receiver.DecryptChunk (out.data (), first.data (), first.size (), &last),
+                         false, "corrupted chunk decrypted");
+  first[first.size () - 1] ^= 1;
+  NS_TEST_ASSERT_MSG_EQ (receiver.DecryptChunk (out.data (), first.data (), first.size (), &last),
+                         true, "stream broken by a rejected chunk");
+  NS_TEST_ASSERT_MSG_EQ (receiver.DecryptChunk (out.data (), second.data (), second.size (), &last),
+                         true, "second chunk not decrypted");
+  NS_TEST_ASSERT_MSG_EQ (receiver.IsFinished (), false, "truncated stream finished");
+}
+
+/**
+ * \ingroup onion_routing_wsn
+ * \brief Tests of the onion managers, of the wire formats, of circuits, of the onion pool and of
+ * onion streams
+ */
 class Onion_routing_wsnTestSuite : public TestSuite
 {
 public:
@@ -59,10 +726,15 @@ public:
 Onion_routing_wsnTestSuite::Onion_routing_wsnTestSuite ()
   : TestSuite ("onion_routing_wsn", UNIT)
 {
-  // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
-  AddTestCase (new Onion_routing_wsnTestCase1, TestCase::QUICK);
+  AddTestCase (new OnionManagerPeelTestCase, TestCase::QUICK);
+  AddTestCase (new SphinxOnionTestCase, TestCase::QUICK);
+  AddTestCase (new OnionPoolTestCase, TestCase::QUICK);
+  AddTestCase (new CircuitTestCase, TestCase::QUICK);
+  AddTestCase (new WireFormatTestCase, TestCase::QUICK);
+  AddTestCase (new VirtualPaddingTestCase, TestCase::QUICK);
+  AddTestCase (new PeekOnionIdTestCase, TestCase::QUICK);
+  AddTestCase (new OnionStreamTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
 static Onion_routing_wsnTestSuite sonion_routing_wsnTestSuite;
-
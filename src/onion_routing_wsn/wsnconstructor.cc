@@ -104,7 +104,24 @@ WsnConstructor::GetTypeId ()
                          TypeId::ATTR_CONSTRUCT | TypeId::ATTR_SET | TypeId::ATTR_GET,
                          UintegerValue ((uint16_t) 1),
                          MakeUintegerAccessor (&WsnConstructor::m_onionRepeate),
-                         MakeUintegerChecker<uint16_t> ());
+                         MakeUintegerChecker<uint16_t> ())
+          .AddAttribute ("SeededKeys",
+                         "Derive keypairs of nodes from the simulation seed, in parallel before "
+                         "the start of the simulation, instead of the OS random generator",
+                         BooleanValue (false), MakeBooleanAccessor (&WsnConstructor::m_seededKeys),
+                         MakeBooleanChecker ())
+          .AddAttribute ("KeyThreads",
+                         "Number of threads deriving seeded keypairs, 0 uses all hardware threads",
+                         UintegerValue (0), MakeUintegerAccessor (&WsnConstructor::m_keyThreads),
+                         MakeUintegerChecker<uint16_t> ())
+          .AddAttribute ("Energy",
+                         "Account the energy of the CPU and of the radio of nodes, output the "
+                         "energy of each onion and of each node",
+                         BooleanValue (false), MakeBooleanAccessor (&WsnConstructor::m_energy),
+                         MakeBooleanChecker ())
+          .AddAttribute ("InitialEnergy", "Initial energy in joules of the battery of each node",
+                         DoubleValue (20000), MakeDoubleAccessor (&WsnConstructor::m_initialEnergy),
+                         MakeDoubleChecker<double> (0));
   return tid;
 }
 
@@ -208,6 +225,11 @@ WsnConstructor::Run ()
   InstallInternetStack ();
   InstallApplications ();
 
+  if (m_energy)
+    {
+      InstallEnergyModels ();
+    }
+
   if (CommunicationStatistics::Y == m_stats)
     {
       CaptureStatistics ();
@@ -225,6 +247,11 @@ WsnConstructor::Run ()
 
   Simulator::Run ();
 
+  if (m_energy)
+    {
+      PrintEnergy ();
+    }
+
   givemetime = time (NULL);
 
   m_outputManager->SimulationEnd (std::string (ctime (&givemetime)));
@@ -635,6 +662,11 @@ WsnConstructor::InstallApplications ()
   sinkApps.Get (0)->GetObject<Sink> ()->Setup (m_onionPathsLengths, m_numOnionPaths,
                                                m_onionRepeate);
 
+  if (m_seededKeys)
+    {
+      SeedKeyPairs ();
+    }
+
   //start apps
   sinkApps.Start (Seconds (1.0 + routing_setup_time));
   sensornodeApps.Start (Seconds (2.0 + routing_setup_time));
@@ -660,6 +692,98 @@ WsnConstructor::InstallApplications ()
                             std::to_string (m_onionRepeate) + " times.\n";
 }
 
+void
+WsnConstructor::SeedKeyPairs ()
+{
+  ApplicationContainer apps;
+  apps.Add (sinkApps);
+  apps.Add (sensornodeApps);
+  std::vector<Ptr<Wsn_node>> nodes (apps.GetN ());
+  std::vector<uint8_t> seeds (apps.GetN () * OnionManager::KEY_SEED_BYTES);
+
+  //objects are created and seeds drawn on the main thread, in the order of nodes
+  Ptr<UniformRandomVariable> x = CreateObject<UniformRandomVariable> ();
+  for (uint32_t i = 0; i < apps.GetN (); ++i)
+    {
+      nodes[i] = DynamicCast<Wsn_node> (apps.Get (i));
+      nodes[i]->CreateOnionManager ();
+      for (uint16_t j = 0; j < OnionManager::KEY_SEED_BYTES; ++j)
+        {
+          seeds[i * OnionManager::KEY_SEED_BYTES + j] = x->GetInteger (0, 255);
+        }
+    }
+
+  uint16_t threads = m_keyThreads;
+  if (threads == 0)
+    {
+      threads = std::max<uint16_t> (1, std::thread::hardware_concurrency ());
+    }
+
+  //each thread derives the keypairs of a strided share of nodes
+  std::vector<std::thread> workers;
+  for (uint16_t t = 0; t < threads; ++t)
+    {
+      workers.emplace_back ([&nodes, &seeds, t, threads] () {
+        for (uint32_t i = t; i < nodes.size (); i += threads)
+          {
+            nodes[i]->SeedKeyPair (&seeds[i * OnionManager::KEY_SEED_BYTES]);
+          }
+      });
+    }
+  for (std::thread &worker : workers)
+    {
+      worker.join ();
+    }
+
+  m_simulationDescription = m_simulationDescription + "Keypairs derived from the seed by " +
+                            std::to_string (threads) + " threads.\n";
+}
+
+void
+WsnConstructor::InstallEnergyModels ()
+{
+  NS_LOG_INFO ("--------------- Install batteries and energy models of radios and CPUs");
+
+  BasicEnergySourceHelper sourceHelper;
+  sourceHelper.Set ("BasicEnergySourceInitialEnergyJ", DoubleValue (m_initialEnergy));
+  m_energySources = sourceHelper.Install (wifiNodes);
+
+  WifiRadioEnergyModelHelper radioHelper;
+  m_radioEnergyModels = radioHelper.Install (wifiDevices, m_energySources);
+
+  //applications are installed in the order of wifiNodes, the sink first
+  ApplicationContainer apps;
+  apps.Add (sinkApps);
+  apps.Add (sensornodeApps);
+  for (uint32_t i = 0; i < m_energySources.GetN (); ++i)
+    {
+      Ptr<EnergySource> source = m_energySources.Get (i);
+      Ptr<CpuEnergyModel> cpu = CreateObject<CpuEnergyModel> ();
+      cpu->SetEnergySource (source);
+      source->AppendDeviceEnergyModel (cpu);
+      apps.Get (i)->SetAttribute ("CpuEnergyModel", PointerValue (cpu));
+      m_cpuEnergyModels.push_back (cpu);
+    }
+
+  m_outputManager->EnableEnergyAccounting ();
+
+  m_simulationDescription = m_simulationDescription + "Energy accounted on batteries of " +
+                            std::to_string (m_initialEnergy) + "J.\n";
+}
+
+void
+WsnConstructor::PrintEnergy ()
+{
+  for (uint32_t i = 0; i < m_cpuEnergyModels.size (); ++i)
+    {
+      m_outputManager->NodeEnergy (wifiInterfaces.GetAddress (i),
+                                   m_cpuEnergyModels[i]->GetCounters (),
+                                   m_cpuEnergyModels[i]->GetTotalEnergyConsumption (),
+                                   m_radioEnergyModels.Get (i)->GetTotalEnergyConsumption (),
+                                   m_energySources.Get (i)->GetRemainingEnergy ());
+    }
+}
+
 int
 main (int argc, char **argv)
 {
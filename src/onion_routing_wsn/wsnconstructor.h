@@ -23,6 +23,8 @@
 #include <string>
 #include <time.h>
 #include <cmath>
+#include <thread>
+#include <vector>
 
 #include "ns3/enums.h"
 #include "ns3/outputmanager.h"
@@ -33,12 +35,14 @@
 #include "ns3/sink-helper.h"
 #include "ns3/outputmanager.h"
 #include "ns3/onionvalidator.h"
+#include "ns3/cpuenergymodel.h"
 
 #include "ns3/internet-module.h"
 #include "ns3/mobility-module.h"
 #include "ns3/network-module.h"
 #include "ns3/core-module.h"
 #include "ns3/wifi-module.h"
+#include "ns3/energy-module.h"
 #include "ns3/aodv-module.h"
 #include "ns3/olsr-module.h"
 #include "ns3/dsr-module.h"
@@ -111,6 +115,10 @@ private:
   uint16_t m_mss; //!< maximum segment size
   uint16_t m_radius; //!< Parameter for the setup of the random disc topology
   uint16_t m_cellSide; //!< Parameter for the setup of the grid topology
+  bool m_seededKeys; //!< derive keypairs of nodes from the simulation seed before the start
+  uint16_t m_keyThreads; //!< threads deriving the keypairs, 0 uses all hardware threads
+  bool m_energy; //!< account the energy of the CPU and of the radio of nodes
+  double m_initialEnergy; //!< initial energy in joules of the battery of each node
 
   //Classes to manage the simulation
   Ptr<OutputManager> m_outputManager; //!< Manages the output of the simulation
@@ -194,6 +202,31 @@ private:
   */
   void InstallApplications ();
 
+  /**
+  *
+  * \brief  Derive the keypair of each node from a seed drawn from the ns-3 random stream,
+  *         seeds are drawn in the order of nodes and the keypairs are derived in parallel
+  *         by \p m_keyThreads threads, so keys are the same across runs with the same seed
+  * 
+  */
+  void SeedKeyPairs ();
+
+  /**
+  *
+  * \brief  Install on each node a battery of \p m_initialEnergy joules, drawn by the
+  *         ns3::WifiRadioEnergyModel of the radio and by the ns3::CpuEnergyModel of the CPU,
+  *         the ns3::CpuEnergyModel is given to the application of the node
+  * 
+  */
+  void InstallEnergyModels ();
+
+  /**
+  *
+  * \brief  Print the work and the energy of each node at the end of the simulation
+  * 
+  */
+  void PrintEnergy ();
+
   /**
   *
   * \brief  Install DSR routing
@@ -227,6 +260,9 @@ private:
   Ipv4InterfaceContainer wifiInterfaces; //!< Container of netork interfaces
   ApplicationContainer sinkApps; //!< Container of sink node applications
   ApplicationContainer sensornodeApps; //!< Container of sensor node applications
+  EnergySourceContainer m_energySources; //!< batteries of nodes, indexed as \p wifiNodes
+  DeviceEnergyModelContainer m_radioEnergyModels; //!< energy models of radios, indexed as \p wifiNodes
+  std::vector<Ptr<CpuEnergyModel>> m_cpuEnergyModels; //!< energy models of CPUs, indexed as \p wifiNodes
 };
 
 #endif // WSNCONSTRUCTOR_H